@@ -348,6 +348,37 @@ void devsdk_post_readings (devsdk_service_t *svc, const char *device_name, const
 
 void devsdk_add_discovered_devices (devsdk_service_t *svc, uint32_t ndevices, devsdk_discovered_device *devices);
 
+/**
+ * @brief Callback receiving messages published by a service whose MessageBus/Type is "local".
+ * @param ctx The context pointer passed to devsdk_set_local_bus_sink.
+ * @param topic The topic to which the message was published.
+ * @param envelope The encoded message envelope. It remains valid only for the duration of the call.
+ * @param len The length of the envelope in bytes.
+ */
+
+typedef void (*devsdk_bus_sink) (void *ctx, const char *topic, const void *envelope, size_t len);
+
+/**
+ * @brief Set the callback to which a local Message Bus delivers messages. Messages are delivered in order on a single thread.
+ *        This must be called before devsdk_service_start.
+ * @param svc The device service.
+ * @param sink The callback function.
+ * @param ctx A pointer which will be passed to the callback.
+ */
+
+void devsdk_set_local_bus_sink (devsdk_service_t *svc, devsdk_bus_sink sink, void *ctx);
+
+/**
+ * @brief Send a request to the service over a local Message Bus, as if it had been received from a broker.
+ * @param svc The device service.
+ * @param topic The topic on which the request is sent, eg "edgex/device/command/request/device-name/...".
+ * @param envelope The encoded request envelope. This is copied.
+ * @param len The length of the envelope in bytes.
+ * @return false if the service is not running with a local Message Bus.
+ */
+
+bool devsdk_local_bus_send (devsdk_service_t *svc, const char *topic, const void *envelope, size_t len);
+
 /**
  * @brief Obtain a list of devices known to the system.
  * @param svc The device service.
@@ -83,6 +83,7 @@ typedef struct edgex_devicecommand
 
 struct edgex_cmdinfo;
 struct edgex_autoimpl;
+struct edgex_event_template;
 
 typedef struct edgex_deviceprofile
 {
@@ -116,6 +117,7 @@ typedef struct edgex_device_autoevents
   char *interval;
   bool onChange;
   double onChangeThreshold;
+  double onChangeThresholdPercent;
   struct edgex_autoimpl *impl;
   struct edgex_device_autoevents *next;
 } edgex_device_autoevents;
@@ -139,6 +141,10 @@ typedef struct edgex_device
   struct edgex_device *next;
   atomic_uint_fast32_t refs;
   atomic_int_fast32_t retries;
+  _Atomic (struct edgex_event_template *) templates;
+  atomic_uint_fast32_t tmplreaders;
+  atomic_uint_fast64_t lastconnected;
+  atomic_bool lcpending;
   bool ownprofile;
 } edgex_device;
 
@@ -53,6 +53,7 @@ typedef struct
   int code;
   devsdk_http_data data;
   const char *content_type;
+  iot_data_t *data_owner; /* If set, data.bytes belongs to this value, which is freed once the reply is sent */
 } devsdk_http_reply;
 
 typedef void (*devsdk_http_handler_fn)
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_SHMRING_H
+#define _EDGEX_SHMRING_H 1
+
+/**
+ * @file
+ * @brief Layout of the shared-memory ring written by the "shm" Message Bus,
+ *        with helpers for consumers which map the ring read-only.
+ *
+ * The ring file consists of a header followed by a data area. Messages are
+ * appended to the data area as records, each holding a topic and an encoded
+ * envelope. Positions are byte offsets which increase monotonically; a
+ * position's offset in the data area is the position modulo the data size.
+ *
+ * There is a single writer which never waits for readers. A reader keeps its
+ * own position, and after using a record in place must check with
+ * edgex_shmring_intact that the writer has not overwritten it meanwhile. A
+ * reader which has fallen more than a ring's length behind resumes from the
+ * current head.
+ *
+ * The writer increments the notify word after each message and, if the
+ * waiters count is nonzero, wakes any futex waiters on it. A reader which
+ * waits must therefore map the ring writable, so as to update the count.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EDGEX_SHMRING_MAGIC 0x52584445u
+#define EDGEX_SHMRING_VERSION 1
+#define EDGEX_SHMRING_ALIGN 16
+
+typedef struct edgex_shmring_hdr
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t size;                  /* Length of the data area */
+  _Atomic uint64_t head;          /* Position after the last complete record */
+  _Atomic uint64_t reserved;      /* Position up to which the writer may be writing */
+  _Atomic uint32_t notify;        /* Futex word, incremented per message */
+  _Atomic uint32_t waiters;       /* Number of readers waiting on notify */
+  uint8_t pad[24];
+} edgex_shmring_hdr;
+
+/* A record with a topic length of zero is padding to the end of the data area */
+
+typedef struct edgex_shmring_rec
+{
+  uint32_t len;                   /* Length of the record, including this header and alignment */
+  uint32_t topiclen;              /* Length of the topic, including its terminator */
+  uint32_t envlen;                /* Length of the envelope, which follows the topic */
+  uint32_t flags;
+} edgex_shmring_rec;
+
+static inline const uint8_t *edgex_shmring_data (const edgex_shmring_hdr *hdr)
+{
+  return (const uint8_t *)(hdr + 1);
+}
+
+static inline const char *edgex_shmring_topic (const edgex_shmring_rec *rec)
+{
+  return (const char *)(rec + 1);
+}
+
+static inline const void *edgex_shmring_envelope (const edgex_shmring_rec *rec)
+{
+  return (const uint8_t *)(rec + 1) + rec->topiclen;
+}
+
+/**
+ * @brief Find the next message for a reader.
+ * @param hdr The mapped ring.
+ * @param pos The reader's position. On return, the position of the record, if one is returned.
+ * @return The next record, or NULL if there are no new messages. A record is
+ *         only returned if its topic and envelope lie within the data area.
+ */
+
+static inline const edgex_shmring_rec *edgex_shmring_next (const edgex_shmring_hdr *hdr, uint64_t *pos)
+{
+  uint64_t head = atomic_load_explicit (&((edgex_shmring_hdr *)hdr)->head, memory_order_acquire);
+  if (*pos > head || head - *pos > hdr->size)
+  {
+    *pos = head;
+  }
+  while (*pos < head)
+  {
+    const edgex_shmring_rec *rec = (const edgex_shmring_rec *)(edgex_shmring_data (hdr) + (*pos % hdr->size));
+    const volatile edgex_shmring_rec *vrec = rec;
+    uint32_t len = vrec->len;
+    uint32_t topiclen = vrec->topiclen;
+    uint32_t envlen = vrec->envlen;
+    if (len == 0 || len % EDGEX_SHMRING_ALIGN || len > hdr->size - (*pos % hdr->size) ||
+        sizeof (edgex_shmring_rec) + (uint64_t)topiclen + envlen > len)
+    {
+      // Overwritten while being read: the lengths can't be trusted
+      *pos = head;
+      break;
+    }
+    if (topiclen)
+    {
+      return rec;
+    }
+    *pos += len;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Check that a record read at the given position has not been overwritten.
+ * @param hdr The mapped ring.
+ * @param pos The position of the record, as returned by edgex_shmring_next.
+ * @return true if the record's contents as read were intact.
+ */
+
+static inline bool edgex_shmring_intact (const edgex_shmring_hdr *hdr, uint64_t pos)
+{
+  atomic_thread_fence (memory_order_acquire);
+  return atomic_load_explicit (&((edgex_shmring_hdr *)hdr)->reserved, memory_order_relaxed) <= pos + hdr->size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
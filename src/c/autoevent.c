@@ -17,14 +17,61 @@
 #include "metadata.h"
 #include "data.h"
 #include "opstate.h"
+#include "eventq.h"
+#include "lastconnected.h"
 
 #include <math.h>
+#include <inttypes.h>
+#include <iot/time.h>
 #include <microhttpd.h>
 
+/* Last published value of a reading, for onChange comparison. Scalars are
+   held by value; strings, binary data and arrays as a length and hash, and
+   anything else as a reference. */
+
+typedef struct edgex_lastvalue
+{
+  iot_data_type_t type;
+  uint32_t len;
+  union
+  {
+    int64_t i;
+    uint64_t u;
+    double f;
+    bool b;
+    uint64_t hash;
+    iot_data_t *ref;
+  } v;
+} edgex_lastvalue;
+
+/* Run statistics are kept per device and resource rather than in the
+   autoimpl, so that they carry over when an autoevent is restarted, as
+   happens when its device or profile is updated. Entries are listed in the
+   service under aelock, counted by the autoimpls using them, and dropped
+   once unused for a whole metrics period. Overruns are cumulative; the
+   remaining figures cover the period since they were last collected. */
+
+typedef struct edgex_aestats
+{
+  char *device;
+  char *resource;
+  unsigned refs;
+  bool idle;
+  atomic_uint_fast64_t overruns;
+  atomic_uint_fast64_t runs;
+  atomic_uint_fast64_t exectotal;
+  atomic_uint_fast64_t execmax;
+  atomic_uint_fast64_t lagmax;
+  atomic_uint_fast64_t buckets[EDGEX_AE_EXEC_BUCKETS];
+  struct edgex_aestats *next;
+} edgex_aestats;
+
 typedef struct edgex_autoimpl
 {
   devsdk_service_t *svc;
-  devsdk_commandresult *last;
+  edgex_lastvalue *last;
+  edgex_lastvalue *next;
+  bool havelast;
   uint64_t interval;
   const edgex_cmdinfo *resource;
   char *device;
@@ -32,73 +79,336 @@ typedef struct edgex_autoimpl
   void *handle;
   bool onChange;
   double onChangeThreshold;
+  double onChangeThresholdPercent;
+  atomic_uint_fast64_t due;
+  atomic_bool late;
+  atomic_bool busy;
+  edgex_aestats *stats;
 } edgex_autoimpl;
 
-static void edgex_autoimpl_release (void *p)
+static uint64_t lastvalue_hash (const void *data, size_t len, uint64_t seed)
 {
-  edgex_autoimpl *ai = (edgex_autoimpl *)p;
-  free (ai->device);
-  devsdk_protocols_free (ai->protocols);
-  devsdk_commandresult_free (ai->last, ai->resource->nreqs);
-  free (ai);
+  const uint8_t *p = data;
+  uint64_t h = seed ^ (len * 0x9e3779b97f4a7c15ull);
+  uint64_t w;
+  while (len >= 8)
+  {
+    memcpy (&w, p, 8);
+    h = (h ^ w) * 0x100000001b3ull;
+    h ^= h >> 29;
+    p += 8;
+    len -= 8;
+  }
+  w = 0;
+  memcpy (&w, p, len);
+  h = (h ^ w) * 0x100000001b3ull;
+  h ^= h >> 32;
+  return h;
+}
+
+static void lastvalue_clear (edgex_lastvalue *lv)
+{
+  if (lv->type == IOT_DATA_MAP || lv->type == IOT_DATA_VECTOR || lv->type == IOT_DATA_LIST)
+  {
+    iot_data_free (lv->v.ref);
+  }
+  lv->type = IOT_DATA_INVALID;
 }
 
-//helper function to compare values with threshold
-static bool values_exceed_threshold (const devsdk_commandresult *newvals, const devsdk_commandresult *oldvals, int nvals, double threshold, iot_logger_t *logger)
+static void lastvalue_set (edgex_lastvalue *lv, const iot_data_t *val)
 {
-  iot_log_debug (logger, "Comparing values against threshold: %f", threshold);
-  if(!newvals || !oldvals)
+  lastvalue_clear (lv);
+  lv->v.u = 0;
+  lv->len = 0;
+  if (val == NULL)
   {
-    iot_log_debug (logger, "No threshold set or new/old values are null, publishing event.");
-    return true;
+    return;
   }
-  bool publish = false;
-  for (int i = 0; i < nvals; i++)
+  lv->type = iot_data_type (val);
+  switch (lv->type)
   {
-    if(newvals[i].value != NULL && oldvals[i].value != NULL){
-      iot_data_t *curr_val_cast = iot_data_transform(newvals[i].value, IOT_DATA_FLOAT64);
-      iot_data_t *prev_val_cast = iot_data_transform(oldvals[i].value, IOT_DATA_FLOAT64);
-      if(curr_val_cast != NULL || prev_val_cast != NULL)
-      {
-        double curr_val = iot_data_f64(curr_val_cast);
-        double prev_val = iot_data_f64(prev_val_cast);
-        iot_log_debug (logger, "Values of index %d: current=%f, previous=%f", i, curr_val, prev_val);
-        if (fabs(curr_val - prev_val) > threshold)
-        {
-          iot_log_debug (logger, "Value change %f exceeds threshold %f publishing event.", fabs(curr_val - prev_val), threshold);
-          publish = true;
-        }
-      }else{
-        if(!iot_data_equal(newvals[i].value, oldvals[i].value))
-        {
-          iot_log_debug (logger, "Non-numeric value changed, publishing event.");
-          publish = true;
-        }
-      }
-      iot_data_free (curr_val_cast);
-      iot_data_free (prev_val_cast);
-      if(publish)
-      {
-        return true;
-      }
+    case IOT_DATA_INT8: lv->v.i = iot_data_i8 (val); break;
+    case IOT_DATA_INT16: lv->v.i = iot_data_i16 (val); break;
+    case IOT_DATA_INT32: lv->v.i = iot_data_i32 (val); break;
+    case IOT_DATA_INT64: lv->v.i = iot_data_i64 (val); break;
+    case IOT_DATA_UINT8: lv->v.u = iot_data_ui8 (val); break;
+    case IOT_DATA_UINT16: lv->v.u = iot_data_ui16 (val); break;
+    case IOT_DATA_UINT32: lv->v.u = iot_data_ui32 (val); break;
+    case IOT_DATA_UINT64: lv->v.u = iot_data_ui64 (val); break;
+    case IOT_DATA_FLOAT32: lv->v.f = iot_data_f32 (val); break;
+    case IOT_DATA_FLOAT64: lv->v.f = iot_data_f64 (val); break;
+    case IOT_DATA_BOOL: lv->v.b = iot_data_bool (val); break;
+    case IOT_DATA_STRING:
+    {
+      const char *str = iot_data_string (val);
+      lv->len = strlen (str);
+      lv->v.hash = lastvalue_hash (str, lv->len, 0);
+      break;
     }
+    case IOT_DATA_BINARY:
+    case IOT_DATA_ARRAY:
+      lv->len = iot_data_array_size (val);
+      lv->v.hash = lastvalue_hash (iot_data_address (val), lv->len, iot_data_array_type (val));
+      break;
+    case IOT_DATA_MAP:
+    case IOT_DATA_VECTOR:
+    case IOT_DATA_LIST:
+      lv->v.ref = iot_data_add_ref (val);
+      break;
+    default:
+      break;
   }
-  iot_log_debug (logger, "No values exceeded threshold, not publishing event.");
-  return publish;
 }
-  
 
-static void *ae_runner (void *p)
+static bool lastvalue_number (const edgex_lastvalue *lv, double *d)
+{
+  switch (lv->type)
+  {
+    case IOT_DATA_INT8: case IOT_DATA_INT16: case IOT_DATA_INT32: case IOT_DATA_INT64:
+      *d = lv->v.i;
+      return true;
+    case IOT_DATA_UINT8: case IOT_DATA_UINT16: case IOT_DATA_UINT32: case IOT_DATA_UINT64:
+      *d = lv->v.u;
+      return true;
+    case IOT_DATA_FLOAT32: case IOT_DATA_FLOAT64:
+      *d = lv->v.f;
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool lastvalue_equal (const edgex_lastvalue *a, const edgex_lastvalue *b)
+{
+  if (a->type != b->type || a->len != b->len)
+  {
+    return false;
+  }
+  switch (a->type)
+  {
+    case IOT_DATA_MAP:
+    case IOT_DATA_VECTOR:
+    case IOT_DATA_LIST:
+      return iot_data_equal (a->v.ref, b->v.ref);
+    default:
+      return memcmp (&a->v, &b->v, sizeof (a->v)) == 0;
+  }
+}
+
+/* A reading has changed if it differs from the last published value. For
+   numeric readings with a threshold set, the change must also exceed the
+   absolute threshold and/or the percentage of the last value. */
+
+static bool lastvalue_changed (const edgex_autoimpl *ai, const edgex_lastvalue *prev, const edgex_lastvalue *curr)
+{
+  double p, c;
+  if ((ai->onChangeThreshold > 0.0 || ai->onChangeThresholdPercent > 0.0) && lastvalue_number (prev, &p) && lastvalue_number (curr, &c))
+  {
+    double diff = fabs (c - p);
+    if (ai->onChangeThreshold > 0.0 && diff <= ai->onChangeThreshold)
+    {
+      return false;
+    }
+    if (ai->onChangeThresholdPercent > 0.0 && diff <= fabs (p) * ai->onChangeThresholdPercent / 100.0)
+    {
+      return false;
+    }
+    return diff > 0.0;
+  }
+  return !lastvalue_equal (prev, curr);
+}
+
+/* Autoevents are spread across their interval so that those sharing an
+   interval do not all fire together. The offset is a hash of the device and
+   resource names, so is the same on every run, plus optional random jitter. */
+
+static uint64_t ae_phase (const edgex_autoimpl *ai, uint64_t jitter)
+{
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (const char *c = ai->device; *c; c++)
+  {
+    h = (h ^ (uint8_t)*c) * 0x100000001b3ull;
+  }
+  h = (h ^ '/') * 0x100000001b3ull;
+  for (const char *c = ai->resource->name; *c; c++)
+  {
+    h = (h ^ (uint8_t)*c) * 0x100000001b3ull;
+  }
+  uint64_t offset = h % ai->interval;
+  if (jitter)
+  {
+    offset += random () % jitter;
+  }
+  return offset;
+}
+
+/* Track how late each tick runs compared to its schedule, warning when it
+   falls more than a whole interval behind */
+
+static void ae_track_lag (edgex_autoimpl *ai)
+{
+  uint64_t now = iot_time_nsecs ();
+  uint64_t due = atomic_fetch_add (&ai->due, IOT_MS_TO_NS (ai->interval));
+  uint64_t lag = (now > due) ? now - due : 0;
+  uint64_t max = atomic_load (&ai->stats->lagmax);
+  while (lag > max && !atomic_compare_exchange_weak (&ai->stats->lagmax, &max, lag));
+  bool late = lag > IOT_MS_TO_NS (ai->interval);
+  if (atomic_exchange (&ai->late, late) != late && late)
+  {
+    iot_log_warn (ai->svc->logger, "AutoEvent: %s/%s is running %" PRIu64 "ms behind schedule", ai->device, ai->resource->name, lag / 1000000);
+  }
+}
+
+/* Execution times are counted in buckets of doubling size: bucket i holds
+   runs taking under 2^i ms, and the last holds any longer runs */
+
+static void ae_record_exec (edgex_aestats *st, uint64_t t)
+{
+  uint64_t ms = t / 1000000;
+  unsigned b = 0;
+  while (b < EDGEX_AE_EXEC_BUCKETS - 1 && ms >= (1u << b))
+  {
+    b++;
+  }
+  atomic_fetch_add (&st->buckets[b], 1);
+  atomic_fetch_add (&st->runs, 1);
+  atomic_fetch_add (&st->exectotal, t);
+  uint64_t max = atomic_load (&st->execmax);
+  while (t > max && !atomic_compare_exchange_weak (&st->execmax, &max, t));
+}
+
+static void ae_register (edgex_autoimpl *ai)
+{
+  edgex_aestats *st;
+  pthread_mutex_lock (&ai->svc->aelock);
+  for (st = ai->svc->aestats; st; st = st->next)
+  {
+    if (strcmp (st->device, ai->device) == 0 && strcmp (st->resource, ai->resource->name) == 0)
+    {
+      break;
+    }
+  }
+  if (st == NULL)
+  {
+    st = calloc (1, sizeof (edgex_aestats));
+    st->device = strdup (ai->device);
+    st->resource = strdup (ai->resource->name);
+    st->next = ai->svc->aestats;
+    ai->svc->aestats = st;
+  }
+  st->refs++;
+  st->idle = false;
+  ai->stats = st;
+  pthread_mutex_unlock (&ai->svc->aelock);
+}
+
+static void ae_unregister (edgex_autoimpl *ai)
+{
+  pthread_mutex_lock (&ai->svc->aelock);
+  ai->stats->refs--;
+  pthread_mutex_unlock (&ai->svc->aelock);
+}
+
+static void ae_stats_free (edgex_aestats *st)
+{
+  free (st->device);
+  free (st->resource);
+  free (st);
+}
+
+edgex_autoevent_stats *edgex_device_autoevent_stats (devsdk_service_t *svc, unsigned *n)
+{
+  edgex_autoevent_stats *result = NULL;
+  unsigned count = 0;
+  pthread_mutex_lock (&svc->aelock);
+  for (edgex_aestats *st = svc->aestats; st; st = st->next)
+  {
+    count++;
+  }
+  if (count)
+  {
+    result = calloc (count, sizeof (edgex_autoevent_stats));
+  }
+  count = 0;
+  for (edgex_aestats **p = &svc->aestats; *p; )
+  {
+    edgex_aestats *st = *p;
+    edgex_autoevent_stats *out = &result[count++];
+    out->device = strdup (st->device);
+    out->resource = strdup (st->resource);
+    out->overruns = atomic_load (&st->overruns);
+    out->runs = atomic_exchange (&st->runs, 0);
+    out->exectotal = atomic_exchange (&st->exectotal, 0);
+    out->execmax = atomic_exchange (&st->execmax, 0);
+    out->lagmax = atomic_exchange (&st->lagmax, 0);
+    for (unsigned b = 0; b < EDGEX_AE_EXEC_BUCKETS; b++)
+    {
+      out->buckets[b] = atomic_exchange (&st->buckets[b], 0);
+    }
+    if (st->refs == 0 && st->idle)
+    {
+      *p = st->next;
+      ae_stats_free (st);
+    }
+    else
+    {
+      st->idle = (st->refs == 0);
+      p = &st->next;
+    }
+  }
+  pthread_mutex_unlock (&svc->aelock);
+  *n = count;
+  return result;
+}
+
+void edgex_device_autoevent_stats_free (edgex_autoevent_stats *stats, unsigned n)
+{
+  for (unsigned i = 0; i < n; i++)
+  {
+    free (stats[i].device);
+    free (stats[i].resource);
+  }
+  free (stats);
+}
+
+void edgex_device_autoevent_fini (devsdk_service_t *svc)
+{
+  while (svc->aestats)
+  {
+    edgex_aestats *st = svc->aestats;
+    svc->aestats = st->next;
+    ae_stats_free (st);
+  }
+}
+
+static void edgex_autoimpl_release (void *p)
 {
   edgex_autoimpl *ai = (edgex_autoimpl *)p;
+  ae_unregister (ai);
+  free (ai->device);
+  devsdk_protocols_free (ai->protocols);
+  if (ai->last)
+  {
+    for (unsigned i = 0; i < ai->resource->nreqs; i++)
+    {
+      lastvalue_clear (&ai->last[i]);
+      lastvalue_clear (&ai->next[i]);
+    }
+  }
+  free (ai->last);
+  free (ai->next);
+  free (ai);
+}
 
+static void ae_execute (edgex_autoimpl *ai)
+{
   edgex_device *dev = edgex_devmap_device_byname (ai->svc->devices, ai->device);
   if (dev)
   {
     if (ai->svc->adminstate == LOCKED || dev->adminState == LOCKED || dev->operatingState == DOWN)
     {
       edgex_device_release (ai->svc, dev);
-      return NULL;
+      return;
     }
     edgex_device_alloc_crlid (NULL);
     iot_log_info (ai->svc->logger, "AutoEvent: %s/%s", ai->device, ai->resource->name);
@@ -113,23 +423,20 @@ static void *ae_runner (void *p)
     {
       if (ai->svc->userfns.gethandler (ai->svc->userdata, dev->devimpl, ai->resource->nreqs, ai->resource->reqs, results, &tags, NULL, &exc))
       {
-        devsdk_commandresult *resdup = NULL;
         bool should_publish = true;
-        if(ai->onChange && ai->last){
-          if(ai->onChangeThreshold > 0.00){
-            should_publish = values_exceed_threshold(results, ai->last, ai->resource->nreqs, ai->onChangeThreshold, ai->svc->logger);
-          }else{
-            //if no threshold, use existing comparison behavior
-            should_publish = !devsdk_commandresult_equal (results, ai->last, ai->resource->nreqs);
+        if (ai->onChange)
+        {
+          // Values are recorded before transforms are applied
+          should_publish = !ai->havelast;
+          for (unsigned i = 0; i < ai->resource->nreqs; i++)
+          {
+            lastvalue_set (&ai->next[i], results[i].value);
+            should_publish = should_publish || lastvalue_changed (ai, &ai->last[i], &ai->next[i]);
           }
         }
-        if(should_publish)
+        if (should_publish)
         {
           devsdk_error err = EDGEX_OK;
-          if (ai->onChange)
-          {
-            resdup = devsdk_commandresult_dup (results, ai->resource->nreqs);
-          }
           edgex_event_cooked *event =
             edgex_data_process_event (dev, ai->resource, results, tags, ai->svc->config.device.datatransform, ai->svc->reduced_events);
           if (event)
@@ -140,18 +447,19 @@ static void *ae_runner (void *p)
             }
             else
             {
-              edgex_data_client_add_event (ai->svc->msgbus, event, &ai->svc->metrics);
+              edgex_eventq_push (ai->svc->events, event);
             }
             edgex_event_cooked_free (event);
             if (ai->onChange)
             {
-              devsdk_commandresult_free (ai->last, ai->resource->nreqs);
-              ai->last = resdup;
-              resdup = NULL;
+              edgex_lastvalue *tmp = ai->last;
+              ai->last = ai->next;
+              ai->next = tmp;
+              ai->havelast = true;
             }
             if (ai->svc->config.device.updatelastconnected)
             {
-              edgex_metadata_client_update_lastconnected (ai->svc->logger, &ai->svc->config.endpoints, ai->svc->secretstore, dev->name, &err);
+              edgex_lastconnected_record (ai->svc->lastconn, dev);
             }
             devsdk_device_request_succeeded (ai->svc, dev);
           }
@@ -166,7 +474,6 @@ static void *ae_runner (void *p)
         {
           devsdk_device_request_succeeded (ai->svc, dev);
         }
-        devsdk_commandresult_free (resdup, ai->resource->nreqs);
       }
       else
       {
@@ -199,6 +506,27 @@ static void *ae_runner (void *p)
       iot_schedule_remove (ai->svc->scheduler, ai->handle);
     }
   }
+}
+
+/* Runs one autoevent tick. A tick is skipped if the previous one for the
+   same autoevent is still running, so that a slow device cannot fill the
+   thread pool. */
+
+static void *ae_runner (void *p)
+{
+  edgex_autoimpl *ai = (edgex_autoimpl *)p;
+
+  ae_track_lag (ai);
+  if (atomic_exchange (&ai->busy, true))
+  {
+    atomic_fetch_add (&ai->stats->overruns, 1);
+    iot_log_debug (ai->svc->logger, "AutoEvent: %s/%s still running, tick skipped", ai->device, ai->resource->name);
+    return NULL;
+  }
+  uint64_t started = iot_time_nsecs ();
+  ae_execute (ai);
+  ae_record_exec (ai->stats, iot_time_nsecs () - started);
+  atomic_store (&ai->busy, false);
   return NULL;
 }
 
@@ -241,9 +569,11 @@ void edgex_device_autoevent_start (devsdk_service_t *svc, edgex_device *dev)
         );
         continue;
       }
-      ae->impl = malloc (sizeof (edgex_autoimpl));
+      ae->impl = calloc (1, sizeof (edgex_autoimpl));
       ae->impl->svc = svc;
       ae->impl->last = NULL;
+      ae->impl->next = NULL;
+      ae->impl->havelast = false;
       ae->impl->interval = interval;
       ae->impl->resource = cmd;
       ae->impl->device = strdup (dev->name);
@@ -251,6 +581,18 @@ void edgex_device_autoevent_start (devsdk_service_t *svc, edgex_device *dev)
       ae->impl->handle = NULL;
       ae->impl->onChange = ae->onChange;
       ae->impl->onChangeThreshold = ae->onChangeThreshold;
+      ae->impl->onChangeThresholdPercent = ae->onChangeThresholdPercent;
+      ae_register (ae->impl);
+      if (ae->onChange)
+      {
+        ae->impl->last = calloc (cmd->nreqs, sizeof (edgex_lastvalue));
+        ae->impl->next = calloc (cmd->nreqs, sizeof (edgex_lastvalue));
+        for (unsigned i = 0; i < cmd->nreqs; i++)
+        {
+          ae->impl->last[i].type = IOT_DATA_INVALID;
+          ae->impl->next[i].type = IOT_DATA_INVALID;
+        }
+      }
     }
     if (ae->impl->svc->userfns.ae_starter)
     {
@@ -258,8 +600,15 @@ void edgex_device_autoevent_start (devsdk_service_t *svc, edgex_device *dev)
     }
     else
     {
+      uint64_t start = 0;
+      if (svc->config.device.aespread)
+      {
+        start = IOT_MS_TO_NS (ae_phase (ae->impl, edgex_parsetime (svc->config.device.aejitter)));
+      }
+      atomic_store (&ae->impl->due, iot_time_nsecs () + start);
+      atomic_store (&ae->impl->late, false);
       ae->impl->handle = iot_schedule_create
-        (svc->scheduler, ae_runner, edgex_autoimpl_release, ae->impl, IOT_MS_TO_NS(ae->impl->interval), 0, 0, svc->thpool, -1);
+        (svc->scheduler, ae_runner, edgex_autoimpl_release, ae->impl, IOT_MS_TO_NS(ae->impl->interval), start, 0, svc->thpool, -1);
       iot_schedule_add (ae->impl->svc->scheduler, ae->impl->handle);
     }
   }
@@ -15,4 +15,31 @@ void edgex_device_autoevent_start (devsdk_service_t *svc, edgex_device *dev);
 
 void edgex_device_autoevent_stop (edgex_device *dev);
 
+#define EDGEX_AE_EXEC_BUCKETS 13
+
+/* Statistics for an autoevent, identified by device and resource.
+   Overruns (ticks skipped because the previous one was still running) are
+   cumulative, the rest cover the period since the last call to
+   edgex_device_autoevent_stats. Times are in ns. */
+
+typedef struct edgex_autoevent_stats
+{
+  char *device;
+  char *resource;
+  uint64_t overruns;
+  uint64_t runs;
+  uint64_t exectotal;
+  uint64_t execmax;
+  uint64_t lagmax;
+  uint64_t buckets[EDGEX_AE_EXEC_BUCKETS];
+} edgex_autoevent_stats;
+
+/* Returns an array of statistics, one per autoevent, setting n to its length */
+edgex_autoevent_stats *edgex_device_autoevent_stats (devsdk_service_t *svc, unsigned *n);
+
+void edgex_device_autoevent_stats_free (edgex_autoevent_stats *stats, unsigned n);
+
+/* Releases the statistics kept for autoevents, once all are stopped */
+void edgex_device_autoevent_fini (devsdk_service_t *svc);
+
 #endif
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "b64.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define EDGEX_B64_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#define B64_INVALID 255
+
+static const char b64_alphabet[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const uint8_t b64_values[256] =
+{
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255, 255,  63,
+   52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+  255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+   15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255, 255,
+  255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+   41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255
+};
+
+#ifdef EDGEX_B64_SSSE3
+
+/* SSSE3 block codecs, after the approach of W. Mula and D. Lemire, "Faster
+   Base64 Encoding and Decoding Using AVX2 Instructions" (2018). Each
+   returns the number of input bytes consumed; the remainder is left for
+   the scalar code. */
+
+__attribute__ ((target ("ssse3")))
+static size_t b64_encode_ssse3 (const uint8_t *in, size_t len, char *out)
+{
+  const __m128i shuf = _mm_set_epi8 (10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const __m128i lut = _mm_setr_epi8 (65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  size_t done = 0;
+
+  // Each step reads 16 bytes but consumes 12
+  while (len - done >= 16)
+  {
+    __m128i v = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *)(in + done)), shuf);
+
+    // Split each 24-bit group into four 6-bit indices, one per byte
+    __m128i t0 = _mm_mulhi_epu16 (_mm_and_si128 (v, _mm_set1_epi32 (0x0fc0fc00)), _mm_set1_epi32 (0x04000040));
+    __m128i t1 = _mm_mullo_epi16 (_mm_and_si128 (v, _mm_set1_epi32 (0x003f03f0)), _mm_set1_epi32 (0x01000010));
+    __m128i idx = _mm_or_si128 (t0, t1);
+
+    // Map index ranges to the offset of their characters from the index
+    __m128i range = _mm_subs_epu8 (idx, _mm_set1_epi8 (51));
+    range = _mm_sub_epi8 (range, _mm_cmpgt_epi8 (idx, _mm_set1_epi8 (25)));
+    _mm_storeu_si128 ((__m128i *)out, _mm_add_epi8 (idx, _mm_shuffle_epi8 (lut, range)));
+
+    out += 16;
+    done += 12;
+  }
+  return done;
+}
+
+__attribute__ ((target ("ssse3")))
+static size_t b64_decode_ssse3 (const char *in, size_t len, uint8_t *out)
+{
+  const __m128i lut_lo = _mm_setr_epi8 (0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8 (0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8 (0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8 (0x2f);
+  const __m128i pack = _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  size_t done = 0;
+
+  // Each step writes 16 bytes of which 12 are valid, so stop while there is
+  // enough input left to guarantee that the output has room
+  while (len - done >= 24)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(in + done));
+
+    // Classify characters by nibble; any outside the alphabet end the block
+    __m128i hi_nib = _mm_and_si128 (_mm_srli_epi32 (v, 4), mask_2f);
+    __m128i lo = _mm_shuffle_epi8 (lut_lo, _mm_and_si128 (v, mask_2f));
+    __m128i hi = _mm_shuffle_epi8 (lut_hi, hi_nib);
+    if (_mm_movemask_epi8 (_mm_cmpgt_epi8 (_mm_and_si128 (lo, hi), _mm_setzero_si128 ())))
+    {
+      break;
+    }
+
+    // Convert characters to 6-bit values, then pack four into three bytes
+    __m128i roll = _mm_shuffle_epi8 (lut_roll, _mm_add_epi8 (_mm_cmpeq_epi8 (v, mask_2f), hi_nib));
+    v = _mm_add_epi8 (v, roll);
+    v = _mm_maddubs_epi16 (v, _mm_set1_epi32 (0x01400140));
+    v = _mm_madd_epi16 (v, _mm_set1_epi32 (0x00011000));
+    _mm_storeu_si128 ((__m128i *)out, _mm_shuffle_epi8 (v, pack));
+
+    out += 12;
+    done += 16;
+  }
+  return done;
+}
+
+static bool b64_have_ssse3 (void)
+{
+  static int have = -1;
+  if (have < 0)
+  {
+    __builtin_cpu_init ();
+    have = __builtin_cpu_supports ("ssse3") ? 1 : 0;
+  }
+  return have;
+}
+
+#endif
+
+void edgex_b64_encode (const void *in, size_t len, char *out)
+{
+  const uint8_t *src = (const uint8_t *)in;
+  size_t i = 0;
+
+#ifdef EDGEX_B64_SSSE3
+  if (b64_have_ssse3 ())
+  {
+    i = b64_encode_ssse3 (src, len, out);
+    out += EDGEX_B64_ENCLEN (i);
+  }
+#endif
+
+  for (; i + 3 <= len; i += 3)
+  {
+    uint32_t v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+    *out++ = b64_alphabet[v >> 18];
+    *out++ = b64_alphabet[(v >> 12) & 0x3f];
+    *out++ = b64_alphabet[(v >> 6) & 0x3f];
+    *out++ = b64_alphabet[v & 0x3f];
+  }
+  if (i < len)
+  {
+    uint32_t v = src[i] << 16;
+    if (i + 1 < len)
+    {
+      v |= src[i + 1] << 8;
+    }
+    *out++ = b64_alphabet[v >> 18];
+    *out++ = b64_alphabet[(v >> 12) & 0x3f];
+    *out++ = (i + 1 < len) ? b64_alphabet[(v >> 6) & 0x3f] : '=';
+    *out++ = '=';
+  }
+}
+
+char *edgex_b64_encode_str (const void *in, size_t len)
+{
+  char *result = malloc (EDGEX_B64_ENCLEN (len) + 1);
+  edgex_b64_encode (in, len, result);
+  result[EDGEX_B64_ENCLEN (len)] = '\0';
+  return result;
+}
+
+bool edgex_b64_decode (const char *in, size_t len, void *out, size_t *outlen)
+{
+  uint8_t *dst = (uint8_t *)out;
+  size_t i = 0;
+  uint32_t acc = 0;
+  unsigned n = 0;
+
+#ifdef EDGEX_B64_SSSE3
+  if (b64_have_ssse3 ())
+  {
+    i = b64_decode_ssse3 (in, len, dst);
+    dst += 3 * (i / 4);
+  }
+#endif
+
+  // Fast path for whole groups of valid characters
+  for (; i + 4 <= len; i += 4)
+  {
+    uint32_t a = b64_values[(uint8_t)in[i]];
+    uint32_t b = b64_values[(uint8_t)in[i + 1]];
+    uint32_t c = b64_values[(uint8_t)in[i + 2]];
+    uint32_t d = b64_values[(uint8_t)in[i + 3]];
+    if ((a | b | c | d) & 0xc0)
+    {
+      break;
+    }
+    uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+    *dst++ = v >> 16;
+    *dst++ = v >> 8;
+    *dst++ = v;
+  }
+
+  // Remainder, which may include whitespace, padding or errors
+  for (; i < len && in[i] != '='; i++)
+  {
+    uint8_t c = b64_values[(uint8_t)in[i]];
+    if (c == B64_INVALID)
+    {
+      if (in[i] == ' ' || in[i] == '\t' || in[i] == '\r' || in[i] == '\n')
+      {
+        continue;
+      }
+      return false;
+    }
+    acc = (acc << 6) | c;
+    if (++n == 4)
+    {
+      *dst++ = acc >> 16;
+      *dst++ = acc >> 8;
+      *dst++ = acc;
+      acc = 0;
+      n = 0;
+    }
+  }
+  if (n == 1)
+  {
+    return false;
+  }
+  if (n == 2)
+  {
+    *dst++ = acc >> 4;
+  }
+  else if (n == 3)
+  {
+    *dst++ = acc >> 10;
+    *dst++ = acc >> 2;
+  }
+  *outlen = dst - (uint8_t *)out;
+  return true;
+}
+
+bool edgex_b64url_decode (const char *in, size_t len, void *out, size_t *outlen)
+{
+  bool result;
+  char *std = malloc (len + 1);
+  for (size_t i = 0; i < len; i++)
+  {
+    switch (in[i])
+    {
+      case '-': std[i] = '+'; break;
+      case '_': std[i] = '/'; break;
+      case '+': case '/': free (std); return false;
+      default: std[i] = in[i];
+    }
+  }
+  result = edgex_b64_decode (std, len, out, outlen);
+  free (std);
+  return result;
+}
+
+iot_data_t *edgex_b64_to_binary (const char *in)
+{
+  size_t len = strlen (in);
+  size_t outlen;
+  void *data = malloc (EDGEX_B64_MAXDECLEN (len) + 1);
+  if (!edgex_b64_decode (in, len, data, &outlen))
+  {
+    free (data);
+    return NULL;
+  }
+  return iot_data_alloc_binary (data, outlen, IOT_DATA_TAKE);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_B64_H_
+#define _EDGEX_B64_H_ 1
+
+#include <iot/data.h>
+
+/* Base64 (RFC 4648, padded) codec for binary readings and payloads. Where
+ * the CPU supports it, blocks of input are processed with SIMD
+ * instructions, falling back to a table-driven implementation.
+ */
+
+/* Length of the encoding of len bytes, excluding any terminator */
+#define EDGEX_B64_ENCLEN(len) (4 * (((len) + 2) / 3))
+
+/* Writes EDGEX_B64_ENCLEN (len) characters to out, without a terminator */
+void edgex_b64_encode (const void *in, size_t len, char *out);
+
+/* Returns a malloc'd, nul-terminated encoding */
+char *edgex_b64_encode_str (const void *in, size_t len);
+
+/* Upper bound on the decoded size of len characters */
+#define EDGEX_B64_MAXDECLEN(len) (3 * (((len) + 3) / 4))
+
+/* Decodes len characters into out, which must have space for
+   EDGEX_B64_MAXDECLEN (len) bytes. Whitespace is skipped and decoding
+   stops at padding. Returns false if the input contains any other
+   character outside the base64 alphabet. */
+bool edgex_b64_decode (const char *in, size_t len, void *out, size_t *outlen);
+
+/* As edgex_b64_decode, for the URL-safe alphabet with optional padding
+   (RFC 4648 section 5), as used in JWTs */
+bool edgex_b64url_decode (const char *in, size_t len, void *out, size_t *outlen);
+
+/* Decodes a nul-terminated string to IOT_DATA_BINARY, NULL if invalid */
+iot_data_t *edgex_b64_to_binary (const char *in);
+
+#endif
@@ -9,20 +9,34 @@
 #ifndef _EDGEX_BUS_IMPL_H_
 #define _EDGEX_BUS_IMPL_H_ 1
 
+#include "bus.h"
+#include "cmdq.h"
 #include <iot/data.h>
 #include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct edgex_bus_trie_t edgex_bus_trie_t;
 
 typedef void (*edgex_bus_freefn) (void *ctx);
-typedef void (*edgex_bus_postfn) (void *ctx, const char *path, const iot_data_t *envelope, bool use_cbor);
+/* opts may be NULL, for the bus defaults */
+typedef void (*edgex_bus_postfn) (void *ctx, const char *path, const void *envelope, size_t len, const edgex_bus_pubopts *opts);
+/* Optional: as postfn, but takes ownership of the malloc'd envelope */
+typedef void (*edgex_bus_takefn) (void *ctx, const char *path, void *envelope, size_t len, const edgex_bus_pubopts *opts);
 typedef void (*edgex_bus_subsfn) (void *ctx, const char *path);
+/* Optional: reports publish accounting */
+typedef void (*edgex_bus_statsfn) (void *ctx, edgex_bus_stats *stats);
 
 struct edgex_bus_t
 {
   void *ctx;
   edgex_bus_postfn postfn;
+  edgex_bus_takefn takefn;
   edgex_bus_subsfn subsfn;
   edgex_bus_freefn freefn;
+  edgex_bus_statsfn statsfn;
   iot_data_t *handlers;
+  _Atomic (edgex_bus_trie_t *) trie;
+  edgex_cmdq_t *cmdq;
   char *prefix;
   char *svcname;
   pthread_mutex_t mtx;
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "bus.h"
+#include "bus-impl.h"
+#include <sched.h>
+
+/* In-process message bus. Envelopes published by the service are passed,
+ * without copying, through a bounded lock-free ring to a delivery thread
+ * which hands them to the sink callback. Requests injected by a local
+ * consumer take the same route and are dispatched to the service's handlers.
+ *
+ * The ring is a bounded multi-producer queue in which each slot carries a
+ * sequence number: a producer claims a position by advancing the tail, and
+ * publishes its entry by setting the slot's sequence.
+ */
+
+#define EDGEX_BUS_LOCAL_SPINS 64
+
+/* Set on the delivery thread. If a handler running there publishes while
+   the ring is full, its message is delivered immediately rather than
+   waiting for space which only that thread can make. */
+
+static _Thread_local bool edgex_bus_local_delivering = false;
+
+typedef struct edgex_bus_local_slot
+{
+  atomic_size_t seq;
+  char *topic;
+  void *envelope;
+  size_t len;
+  bool inbound;
+} edgex_bus_local_slot;
+
+typedef struct edgex_bus_local_t
+{
+  iot_logger_t *lc;
+  edgex_bus_t *bus;
+  devsdk_bus_sink sink;
+  void *sinkctx;
+  edgex_bus_local_slot *ring;
+  size_t mask;
+  atomic_size_t tail;
+  size_t head;
+  atomic_bool sleeping;
+  atomic_bool running;
+  iot_threadpool_t *pool;
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+} edgex_bus_local_t;
+
+static void edgex_bus_local_deliver (edgex_bus_local_t *lb, edgex_bus_local_slot *entry);
+
+static void edgex_bus_local_push (edgex_bus_local_t *lb, const char *topic, void *envelope, size_t len, bool inbound)
+{
+  edgex_bus_local_slot *slot;
+  size_t pos = atomic_load_explicit (&lb->tail, memory_order_relaxed);
+  while (true)
+  {
+    slot = &lb->ring[pos & lb->mask];
+    size_t seq = atomic_load_explicit (&slot->seq, memory_order_acquire);
+    if (seq == pos)
+    {
+      if (atomic_compare_exchange_weak_explicit (&lb->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (seq < pos)
+    {
+      if (edgex_bus_local_delivering)
+      {
+        edgex_bus_local_slot entry = { .topic = strdup (topic), .envelope = envelope, .len = len, .inbound = inbound };
+        edgex_bus_local_deliver (lb, &entry);
+        return;
+      }
+      // Full: wait for the delivery thread to free a slot
+      sched_yield ();
+      pos = atomic_load_explicit (&lb->tail, memory_order_relaxed);
+    }
+    else
+    {
+      pos = atomic_load_explicit (&lb->tail, memory_order_relaxed);
+    }
+  }
+  slot->topic = strdup (topic);
+  slot->envelope = envelope;
+  slot->len = len;
+  slot->inbound = inbound;
+  atomic_store_explicit (&slot->seq, pos + 1, memory_order_release);
+
+  atomic_thread_fence (memory_order_seq_cst);
+  if (atomic_load (&lb->sleeping))
+  {
+    pthread_mutex_lock (&lb->mtx);
+    pthread_cond_signal (&lb->cond);
+    pthread_mutex_unlock (&lb->mtx);
+  }
+}
+
+/* Takes the next entry, if one has been published */
+
+static bool edgex_bus_local_pop (edgex_bus_local_t *lb, edgex_bus_local_slot *entry)
+{
+  edgex_bus_local_slot *slot = &lb->ring[lb->head & lb->mask];
+  if (atomic_load_explicit (&slot->seq, memory_order_acquire) != lb->head + 1)
+  {
+    return false;
+  }
+  entry->topic = slot->topic;
+  entry->envelope = slot->envelope;
+  entry->len = slot->len;
+  entry->inbound = slot->inbound;
+  atomic_store_explicit (&slot->seq, lb->head + lb->mask + 1, memory_order_release);
+  lb->head++;
+  return true;
+}
+
+/* Once the bus is being freed, the service is shutting down and injected
+   requests are discarded */
+
+static void edgex_bus_local_deliver (edgex_bus_local_t *lb, edgex_bus_local_slot *entry)
+{
+  if (entry->inbound)
+  {
+    if (atomic_load (&lb->running))
+    {
+      edgex_bus_handle_request (lb->bus, entry->topic, entry->envelope, entry->len);
+    }
+  }
+  else if (lb->sink)
+  {
+    lb->sink (lb->sinkctx, entry->topic, entry->envelope, entry->len);
+  }
+  free (entry->topic);
+  free (entry->envelope);
+}
+
+static void *edgex_bus_local_run (void *p)
+{
+  edgex_bus_local_t *lb = (edgex_bus_local_t *)p;
+  edgex_bus_local_slot entry;
+  unsigned idle = 0;
+
+  edgex_bus_local_delivering = true;
+  while (true)
+  {
+    if (edgex_bus_local_pop (lb, &entry))
+    {
+      edgex_bus_local_deliver (lb, &entry);
+      idle = 0;
+      continue;
+    }
+    if (!atomic_load (&lb->running))
+    {
+      break;
+    }
+    if (++idle < EDGEX_BUS_LOCAL_SPINS)
+    {
+      sched_yield ();
+      continue;
+    }
+    pthread_mutex_lock (&lb->mtx);
+    atomic_store (&lb->sleeping, true);
+    edgex_bus_local_slot *next = &lb->ring[lb->head & lb->mask];
+    if (atomic_load (&next->seq) != lb->head + 1 && atomic_load (&lb->running))
+    {
+      pthread_cond_wait (&lb->cond, &lb->mtx);
+    }
+    atomic_store (&lb->sleeping, false);
+    pthread_mutex_unlock (&lb->mtx);
+    idle = 0;
+  }
+  return NULL;
+}
+
+static void edgex_bus_local_take (void *ctx, const char *path, void *envelope, size_t len, const edgex_bus_pubopts *opts)
+{
+  edgex_bus_local_push ((edgex_bus_local_t *)ctx, path, envelope, len, false);
+}
+
+static void edgex_bus_local_post (void *ctx, const char *path, const void *envelope, size_t len, const edgex_bus_pubopts *opts)
+{
+  void *copy = malloc (len);
+  memcpy (copy, envelope, len);
+  edgex_bus_local_push ((edgex_bus_local_t *)ctx, path, copy, len, false);
+}
+
+static void edgex_bus_local_subscribe (void *ctx, const char *topic)
+{
+  edgex_bus_local_t *lb = (edgex_bus_local_t *)ctx;
+  iot_log_debug (lb->lc, "local bus: handling requests for %s", topic);
+}
+
+static void edgex_bus_local_free (void *ctx)
+{
+  edgex_bus_local_t *lb = (edgex_bus_local_t *)ctx;
+  edgex_bus_local_slot entry;
+
+  // Deliver anything outstanding, then stop the delivery thread
+  pthread_mutex_lock (&lb->mtx);
+  atomic_store (&lb->running, false);
+  pthread_cond_signal (&lb->cond);
+  pthread_mutex_unlock (&lb->mtx);
+  iot_threadpool_wait (lb->pool);
+  iot_threadpool_free (lb->pool);
+  while (edgex_bus_local_pop (lb, &entry))
+  {
+    free (entry.topic);
+    free (entry.envelope);
+  }
+  pthread_cond_destroy (&lb->cond);
+  pthread_mutex_destroy (&lb->mtx);
+  free (lb->ring);
+  free (lb);
+}
+
+bool edgex_bus_local_inject (edgex_bus_t *bus, const char *topic, const void *envelope, size_t len)
+{
+  if (bus == NULL || bus->takefn != edgex_bus_local_take)
+  {
+    return false;
+  }
+  // Terminated, as JSON envelopes are parsed in place
+  char *copy = malloc (len + 1);
+  memcpy (copy, envelope, len);
+  copy[len] = '\0';
+  edgex_bus_local_push ((edgex_bus_local_t *)bus->ctx, topic, copy, len, true);
+  return true;
+}
+
+edgex_bus_t *edgex_bus_create_local (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg, devsdk_bus_sink sink, void *sinkctx)
+{
+  edgex_bus_t *result = calloc (1, sizeof (edgex_bus_t));
+  edgex_bus_local_t *lb = calloc (1, sizeof (edgex_bus_local_t));
+  uint32_t qlen = iot_data_ui32 (iot_data_string_map_get (cfg, EX_BUS_QUEUELENGTH));
+  size_t size = 2;
+
+  while (size < qlen)
+  {
+    size *= 2;
+  }
+  lb->lc = lc;
+  lb->bus = result;
+  lb->sink = sink;
+  lb->sinkctx = sinkctx;
+  lb->ring = calloc (size, sizeof (edgex_bus_local_slot));
+  lb->mask = size - 1;
+  for (size_t i = 0; i < size; i++)
+  {
+    atomic_init (&lb->ring[i].seq, i);
+  }
+  atomic_init (&lb->tail, 0);
+  atomic_init (&lb->sleeping, false);
+  atomic_init (&lb->running, true);
+  pthread_mutex_init (&lb->mtx, NULL);
+  pthread_cond_init (&lb->cond, NULL);
+
+  lb->pool = iot_threadpool_alloc (1, 0, IOT_THREAD_NO_PRIORITY, IOT_THREAD_NO_AFFINITY, lc);
+  iot_threadpool_start (lb->pool);
+  iot_threadpool_add_work (lb->pool, edgex_bus_local_run, lb, IOT_THREAD_NO_PRIORITY);
+
+  edgex_bus_init (result, svcname, cfg);
+  result->ctx = lb;
+  result->postfn = edgex_bus_local_post;
+  result->takefn = edgex_bus_local_take;
+  result->freefn = edgex_bus_local_free;
+  result->subsfn = edgex_bus_local_subscribe;
+  iot_log_info (lc, "local bus: ring of %zu entries", size);
+  return result;
+}
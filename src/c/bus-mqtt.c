@@ -9,39 +9,509 @@
 #include "api.h"
 #include "bus.h"
 #include "bus-impl.h"
+#include "spool.h"
 #include <iot/time.h>
 #include <iot/thread.h>
 #include <MQTTAsync.h>
+#include <limits.h>
 
 typedef struct edgex_bus_mqtt_t
 {
   iot_logger_t *lc;
+  edgex_bus_t *bus;
   char *uri;
   MQTTAsync client;
   uint16_t qos;
   bool retained;
   bool connected;
+  bool closing;
+  uint32_t maxinflight;
+  uint32_t maxbuffered;
+  uint32_t timeout;
+  uint32_t inflight;
+  uint32_t buffered;
+  atomic_uint_fast64_t failed;
+  edgex_spool_t *spool;
+  iot_threadpool_t *replaypool;
+  uint32_t replayrate;
+  uint32_t replayinflight;
+  bool replaying;
+  bool v5;
+  uint16_t aliasmax;
+  uint16_t nextalias;
+  iot_data_t *aliases;
+  uint64_t aliasgen;
+  atomic_uint_fast64_t conngen;
+  pthread_mutex_t aliasmtx;
   pthread_mutex_t mtx;
   pthread_cond_t cond;
+  pthread_cond_t room;
+  _Atomic (struct edgex_bus_mqtt_t *) *shards;
+  unsigned nshards;
+  iot_data_t *cfg;
+  iot_data_t *secrets;
+  iot_threadpool_t *retrypool;
+  pthread_cond_t retry;
+  bool retrying;
 } edgex_bus_mqtt_t;
 
-static void edgex_bus_mqtt_free (void *ctx)
+/* Interval in milliseconds between attempts to connect publisher connections
+   which could not be made at startup */
+#define EDGEX_MQTT_RETRY_INTERVAL 10000
+
+/* Set on the client library's callback threads. A publish made from one of
+   these (a reply sent by a request handler run without command workers)
+   must not wait for room in the window, since the completions which would
+   make room are delivered on that same thread. */
+
+static _Thread_local bool edgex_bus_mqtt_cbthread = false;
+
+static void edgex_bus_mqtt_close (edgex_bus_mqtt_t *cinfo)
 {
-  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)ctx;
   MQTTAsync_disconnectOptions opts = MQTTAsync_disconnectOptions_initializer;
+  pthread_mutex_lock (&cinfo->mtx);
+  cinfo->closing = true;
+  pthread_cond_broadcast (&cinfo->room);
+  pthread_mutex_unlock (&cinfo->mtx);
+  if (cinfo->replaypool)
+  {
+    iot_threadpool_wait (cinfo->replaypool);
+    iot_threadpool_free (cinfo->replaypool);
+  }
   opts.context = cinfo->client;
   MQTTAsync_disconnect (cinfo->client, &opts);
   MQTTAsync_destroy (&cinfo->client);
+  edgex_spool_close (cinfo->spool);
+  pthread_cond_destroy (&cinfo->room);
   pthread_cond_destroy (&cinfo->cond);
+  pthread_mutex_destroy (&cinfo->aliasmtx);
   pthread_mutex_destroy (&cinfo->mtx);
+  iot_data_free (cinfo->aliases);
   free (cinfo->uri);
   free (cinfo);
 }
 
+static void edgex_bus_mqtt_free (void *ctx)
+{
+  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)ctx;
+  if (cinfo->retrypool)
+  {
+    pthread_mutex_lock (&cinfo->mtx);
+    cinfo->closing = true;
+    pthread_cond_broadcast (&cinfo->retry);
+    pthread_mutex_unlock (&cinfo->mtx);
+    iot_threadpool_wait (cinfo->retrypool);
+    iot_threadpool_free (cinfo->retrypool);
+    pthread_cond_destroy (&cinfo->retry);
+  }
+  // The first publisher is the main connection itself
+  for (unsigned i = 1; i < cinfo->nshards; i++)
+  {
+    edgex_bus_mqtt_t *shard = atomic_load (&cinfo->shards[i]);
+    if (shard)
+    {
+      edgex_bus_mqtt_close (shard);
+    }
+  }
+  free (cinfo->shards);
+  iot_data_free (cinfo->cfg);
+  iot_data_free (cinfo->secrets);
+  edgex_bus_mqtt_close (cinfo);
+}
+
+/* Publishes are counted from submission to completion: as in flight while
+   connected, or as buffered by the client while disconnected. Completions
+   are taken from the in-flight count first, since buffered messages are
+   only sent once the connection is restored. */
+
+static void edgex_bus_mqtt_complete (edgex_bus_mqtt_t *cinfo)
+{
+  edgex_bus_mqtt_cbthread = true;
+  pthread_mutex_lock (&cinfo->mtx);
+  if (cinfo->inflight)
+  {
+    cinfo->inflight--;
+  }
+  else if (cinfo->buffered)
+  {
+    cinfo->buffered--;
+  }
+  pthread_cond_signal (&cinfo->room);
+  pthread_mutex_unlock (&cinfo->mtx);
+}
+
+static bool edgex_bus_mqtt_full (const edgex_bus_mqtt_t *cinfo)
+{
+  if (cinfo->connected)
+  {
+    return cinfo->maxinflight && cinfo->inflight >= cinfo->maxinflight;
+  }
+  return cinfo->maxbuffered && cinfo->buffered >= cinfo->maxbuffered;
+}
+
+static void edgex_bus_mqtt_onsend (void *context, MQTTAsync_successData *response);
+static void edgex_bus_mqtt_onsendfail (void *context, MQTTAsync_failureData *response);
+static void edgex_bus_mqtt_onsend5 (void *context, MQTTAsync_successData5 *response);
+static void edgex_bus_mqtt_onsendfail5 (void *context, MQTTAsync_failureData5 *response);
+static void edgex_bus_mqtt_onreplay (void *context, MQTTAsync_successData *response);
+static void edgex_bus_mqtt_onreplayfail (void *context, MQTTAsync_failureData *response);
+static void edgex_bus_mqtt_onreplay5 (void *context, MQTTAsync_successData5 *response);
+static void edgex_bus_mqtt_onreplayfail5 (void *context, MQTTAsync_failureData5 *response);
+
+/* Context for a message sent from the spool, which is consumed from the
+   spool only when its delivery completes */
+
+typedef struct edgex_bus_mqtt_replayctx
+{
+  edgex_bus_mqtt_t *cinfo;
+  uint64_t id;
+} edgex_bus_mqtt_replayctx;
+
+/* Returns the alias for a topic on the current connection, allocating one
+   if any remain; known is set if the broker has already seen it. Zero means
+   the topic is to be sent in full. Call with aliasmtx held, and keep it
+   until the message is submitted, so that no message using an alias can be
+   submitted ahead of the one which defines it. The table is cleared on the
+   first use after each new connection. */
+
+static uint16_t edgex_bus_mqtt_alias (edgex_bus_mqtt_t *cinfo, const char *topic, bool *known)
+{
+  uint16_t result = 0;
+  uint64_t gen = atomic_load (&cinfo->conngen);
+  if (cinfo->aliasgen != gen)
+  {
+    iot_data_free (cinfo->aliases);
+    cinfo->aliases = iot_data_alloc_map (IOT_DATA_STRING);
+    cinfo->nextalias = 1;
+    cinfo->aliasgen = gen;
+  }
+  const iot_data_t *alias = iot_data_string_map_get (cinfo->aliases, topic);
+  if (alias)
+  {
+    result = iot_data_ui16 (alias);
+    *known = true;
+  }
+  else if (cinfo->nextalias <= cinfo->aliasmax)
+  {
+    result = cinfo->nextalias++;
+    iot_data_map_add (cinfo->aliases, iot_data_alloc_string (topic, IOT_DATA_COPY), iot_data_alloc_ui16 (result));
+    *known = false;
+  }
+  return result;
+}
+
+/* Flags for a message in the spool */
+
+#define EDGEX_MQTT_FLAGS(qos, retained) ((qos) | ((retained) ? 4 : 0))
+#define EDGEX_MQTT_FLAGS_QOS(f) ((f) & 3)
+#define EDGEX_MQTT_FLAGS_RETAINED(f) (((f) & 4) != 0)
+
+/* Submits a message which has been counted into the window. Messages from
+   the spool are identified by their spool id, otherwise this is zero. Only
+   topics published repeatedly (those of events) are given aliases, so that
+   the table is not filled by one-off reply topics. */
+
+static bool edgex_bus_mqtt_send
+  (edgex_bus_mqtt_t *cinfo, const char *topic, const void *envelope, size_t len, int qos, bool retained, bool buffered, bool usealias, uint64_t spoolid)
+{
+  MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
+  MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
+  edgex_bus_mqtt_replayctx *rctx = NULL;
+  const char *dest = topic;
+  pubmsg.payload = (void *)envelope;
+  pubmsg.payloadlen = len;
+  pubmsg.qos = qos;
+  pubmsg.retained = retained;
+  opts.context = cinfo;
+  if (spoolid)
+  {
+    rctx = malloc (sizeof (edgex_bus_mqtt_replayctx));
+    rctx->cinfo = cinfo;
+    rctx->id = spoolid;
+    opts.context = rctx;
+    if (cinfo->v5)
+    {
+      opts.onSuccess5 = edgex_bus_mqtt_onreplay5;
+      opts.onFailure5 = edgex_bus_mqtt_onreplayfail5;
+    }
+    else
+    {
+      opts.onSuccess = edgex_bus_mqtt_onreplay;
+      opts.onFailure = edgex_bus_mqtt_onreplayfail;
+    }
+  }
+  else if (cinfo->v5)
+  {
+    opts.onSuccess5 = edgex_bus_mqtt_onsend5;
+    opts.onFailure5 = edgex_bus_mqtt_onsendfail5;
+  }
+  else
+  {
+    opts.onSuccess = edgex_bus_mqtt_onsend;
+    opts.onFailure = edgex_bus_mqtt_onsendfail;
+  }
+
+  // Aliases are per-connection, so are only used for messages sent now and
+  // not retried: that is, at QoS 0 while connected
+  usealias = usealias && cinfo->aliasmax && qos == 0 && !buffered;
+  if (usealias)
+  {
+    bool known = false;
+    pthread_mutex_lock (&cinfo->aliasmtx);
+    uint16_t alias = edgex_bus_mqtt_alias (cinfo, topic, &known);
+    if (alias)
+    {
+      MQTTProperty prop;
+      prop.identifier = MQTTPROPERTY_CODE_TOPIC_ALIAS;
+      prop.value.integer2 = alias;
+      MQTTProperties_add (&pubmsg.properties, &prop);
+      if (known)
+      {
+        dest = "";
+      }
+    }
+  }
+
+  iot_log_trace (cinfo->lc, "mqtt: publish to topic %s", topic);
+  int result = MQTTAsync_sendMessage (cinfo->client, dest, &pubmsg, &opts);
+  if (usealias)
+  {
+    pthread_mutex_unlock (&cinfo->aliasmtx);
+  }
+  MQTTProperties_free (&pubmsg.properties);
+  if (result != MQTTASYNC_SUCCESS)
+  {
+    iot_log_error (cinfo->lc, "mqtt: failed to post event, error %d", result);
+    atomic_fetch_add (&cinfo->failed, 1);
+    if (rctx)
+    {
+      // A message the client refuses outright would be refused again
+      edgex_spool_consume (cinfo->spool, spoolid);
+      free (rctx);
+    }
+    pthread_mutex_lock (&cinfo->mtx);
+    if (buffered && cinfo->buffered)
+    {
+      cinfo->buffered--;
+    }
+    else if (cinfo->inflight)
+    {
+      cinfo->inflight--;
+    }
+    if (rctx)
+    {
+      cinfo->replayinflight--;
+    }
+    pthread_cond_signal (&cinfo->room);
+    pthread_mutex_unlock (&cinfo->mtx);
+    return false;
+  }
+  return true;
+}
+
+/* Sends spooled messages in order while connected, paced to the replay
+   rate. New messages are spooled while this runs, so that none overtake.
+   Messages are consumed from the spool as their delivery completes, so
+   replay starts from the oldest unconfirmed message each time. */
+
+static void *edgex_bus_mqtt_replay (void *p)
+{
+  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)p;
+  uint64_t interval = cinfo->replayrate ? 1000000000 / cinfo->replayrate : 0;
+  uint64_t next = iot_time_nsecs ();
+  uint64_t sent = 0;
+
+  iot_log_info (cinfo->lc, "mqtt: replaying %" PRIu64 " spooled messages", edgex_spool_count (cinfo->spool));
+  edgex_spool_rewind (cinfo->spool);
+  pthread_mutex_lock (&cinfo->mtx);
+  while (cinfo->connected && !cinfo->closing)
+  {
+    const char *topic;
+    const void *envelope;
+    size_t len;
+    uint32_t flags;
+    uint64_t id;
+
+    if (edgex_bus_mqtt_full (cinfo))
+    {
+      pthread_cond_wait (&cinfo->room, &cinfo->mtx);
+      continue;
+    }
+    void *msg = edgex_spool_next (cinfo->spool, &topic, &envelope, &len, &flags, &id);
+    if (msg == NULL)
+    {
+      if (cinfo->replayinflight == 0)
+      {
+        break;
+      }
+      // Wait for deliveries to complete, which may free a segment to send from
+      pthread_cond_wait (&cinfo->room, &cinfo->mtx);
+      continue;
+    }
+    cinfo->inflight++;
+    cinfo->replayinflight++;
+    pthread_mutex_unlock (&cinfo->mtx);
+
+    edgex_bus_mqtt_send (cinfo, topic, envelope, len, EDGEX_MQTT_FLAGS_QOS (flags), EDGEX_MQTT_FLAGS_RETAINED (flags), false, false, id);
+    free (msg);
+    sent++;
+
+    if (interval)
+    {
+      uint64_t now = iot_time_nsecs ();
+      next = (next > now ? next : now) + interval;
+      if (next > now)
+      {
+        struct timespec ts = { .tv_sec = (next - now) / 1000000000, .tv_nsec = (next - now) % 1000000000 };
+        nanosleep (&ts, NULL);
+      }
+    }
+    pthread_mutex_lock (&cinfo->mtx);
+  }
+  cinfo->replaying = false;
+  pthread_mutex_unlock (&cinfo->mtx);
+  iot_log_info (cinfo->lc, "mqtt: replayed %" PRIu64 " spooled messages, %" PRIu64 " remain", sent, edgex_spool_count (cinfo->spool));
+  return NULL;
+}
+
+/* Call with the mutex held */
+
+static void edgex_bus_mqtt_start_replay (edgex_bus_mqtt_t *cinfo)
+{
+  if (cinfo->spool && cinfo->connected && !cinfo->replaying && !cinfo->closing && edgex_spool_count (cinfo->spool))
+  {
+    cinfo->replaying = true;
+    if (!iot_threadpool_add_work (cinfo->replaypool, edgex_bus_mqtt_replay, cinfo, IOT_THREAD_NO_PRIORITY))
+    {
+      iot_log_error (cinfo->lc, "mqtt: unable to start replay of spooled messages");
+      cinfo->replaying = false;
+    }
+  }
+}
+
+static edgex_bus_mqtt_t *edgex_bus_mqtt_connect
+  (iot_logger_t *lc, edgex_bus_t *bus, const char *uri, const iot_data_t *cfg, const iot_data_t *secrets, unsigned shard, const devsdk_timeout *tm);
+
+/* Connects publishers which could not be connected at startup, retrying
+   until all are made or the bus is closed. Runs on the main connection. */
+
+static void *edgex_bus_mqtt_retry_shards (void *p)
+{
+  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)p;
+  pthread_mutex_lock (&cinfo->mtx);
+  while (!cinfo->closing)
+  {
+    unsigned missing = 0;
+    for (unsigned i = 1; i < cinfo->nshards && !cinfo->closing; i++)
+    {
+      if (atomic_load (&cinfo->shards[i]) == NULL)
+      {
+        devsdk_timeout tm;
+        pthread_mutex_unlock (&cinfo->mtx);
+        tm.deadline = iot_time_msecs () + EDGEX_MQTT_RETRY_INTERVAL;
+        tm.interval = EDGEX_MQTT_RETRY_INTERVAL;
+        edgex_bus_mqtt_t *shard = edgex_bus_mqtt_connect (cinfo->lc, cinfo->bus, cinfo->uri, cinfo->cfg, cinfo->secrets, i, &tm);
+        pthread_mutex_lock (&cinfo->mtx);
+        if (shard)
+        {
+          iot_log_info (cinfo->lc, "mqtt: publisher connection %u established", i);
+          atomic_store (&cinfo->shards[i], shard);
+        }
+        else
+        {
+          missing++;
+        }
+      }
+    }
+    if (missing == 0)
+    {
+      break;
+    }
+    struct timespec deadline;
+    clock_gettime (CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += EDGEX_MQTT_RETRY_INTERVAL / 1000;
+    pthread_cond_timedwait (&cinfo->retry, &cinfo->mtx, &deadline);
+  }
+  cinfo->retrying = false;
+  pthread_mutex_unlock (&cinfo->mtx);
+  return NULL;
+}
+
+/* Call with the mutex held. Also cuts short the wait between attempts, so
+   that a reconnection of the main connection prompts a retry. */
+
+static void edgex_bus_mqtt_start_retry (edgex_bus_mqtt_t *cinfo)
+{
+  if (cinfo->retrypool && !cinfo->closing)
+  {
+    if (cinfo->retrying)
+    {
+      pthread_cond_signal (&cinfo->retry);
+    }
+    else
+    {
+      cinfo->retrying = iot_threadpool_add_work (cinfo->retrypool, edgex_bus_mqtt_retry_shards, cinfo, IOT_THREAD_NO_PRIORITY);
+    }
+  }
+}
+
+static void edgex_bus_mqtt_connected (void *context, char *cause)
+{
+  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)context;
+  pthread_mutex_lock (&cinfo->mtx);
+  if (!cinfo->connected)
+  {
+    iot_log_info (cinfo->lc, "mqtt: reconnected, %" PRIu32 " buffered messages to send", cinfo->buffered);
+  }
+  cinfo->connected = true;
+  cinfo->inflight += cinfo->buffered;
+  cinfo->buffered = 0;
+  atomic_fetch_add (&cinfo->conngen, 1);
+  pthread_cond_broadcast (&cinfo->room);
+  edgex_bus_mqtt_start_replay (cinfo);
+  edgex_bus_mqtt_start_retry (cinfo);
+  pthread_mutex_unlock (&cinfo->mtx);
+}
+
+static void edgex_bus_mqtt_connlost (void *context, char *cause)
+{
+  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)context;
+  iot_log_warn (cinfo->lc, "mqtt: connection lost%s%s", cause ? ": " : "", cause ? cause : "");
+  pthread_mutex_lock (&cinfo->mtx);
+  cinfo->connected = false;
+  pthread_cond_broadcast (&cinfo->room);
+  pthread_mutex_unlock (&cinfo->mtx);
+}
+
+static void edgex_bus_mqtt_addstats (edgex_bus_mqtt_t *cinfo, edgex_bus_stats *stats)
+{
+  pthread_mutex_lock (&cinfo->mtx);
+  stats->inflight += cinfo->inflight;
+  stats->buffered += cinfo->buffered;
+  pthread_mutex_unlock (&cinfo->mtx);
+  stats->failed += atomic_load (&cinfo->failed);
+  stats->spooled += cinfo->spool ? edgex_spool_count (cinfo->spool) : 0;
+}
+
+static void edgex_bus_mqtt_stats (void *ctx, edgex_bus_stats *stats)
+{
+  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)ctx;
+  edgex_bus_mqtt_addstats (cinfo, stats);
+  for (unsigned i = 1; i < cinfo->nshards; i++)
+  {
+    edgex_bus_mqtt_t *shard = atomic_load (&cinfo->shards[i]);
+    if (shard)
+    {
+      edgex_bus_mqtt_addstats (shard, stats);
+    }
+  }
+}
+
 static void edgex_bus_mqtt_onsend (void *context, MQTTAsync_successData *response)
 {
   edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)context;
   iot_log_trace (cinfo->lc, "mqtt: published");
+  edgex_bus_mqtt_complete (cinfo);
 }
 
 static void edgex_bus_mqtt_onsendfail (void *context, MQTTAsync_failureData *response)
@@ -55,6 +525,62 @@ static void edgex_bus_mqtt_onsendfail (void *context, MQTTAsync_failureData *res
   {
     iot_log_error (cinfo->lc, "mqtt: publish failed, error code %d", response->code);
   }
+  atomic_fetch_add (&cinfo->failed, 1);
+  edgex_bus_mqtt_complete (cinfo);
+}
+
+static void edgex_bus_mqtt_onsend5 (void *context, MQTTAsync_successData5 *response)
+{
+  edgex_bus_mqtt_onsend (context, NULL);
+}
+
+static void edgex_bus_mqtt_onsendfail5 (void *context, MQTTAsync_failureData5 *response)
+{
+  MQTTAsync_failureData fd = { .token = response->token, .code = response->reasonCode, .message = response->message };
+  edgex_bus_mqtt_onsendfail (context, &fd);
+}
+
+/* A spooled message is consumed when delivered, or when refused while still
+   connected. If the connection is lost it stays in the spool, to be sent
+   again by the next replay. */
+
+static void edgex_bus_mqtt_replayed (edgex_bus_mqtt_replayctx *rctx, bool consume)
+{
+  edgex_bus_mqtt_t *cinfo = rctx->cinfo;
+  pthread_mutex_lock (&cinfo->mtx);
+  cinfo->replayinflight--;
+  consume = consume || cinfo->connected;
+  pthread_mutex_unlock (&cinfo->mtx);
+  if (consume)
+  {
+    edgex_spool_consume (cinfo->spool, rctx->id);
+  }
+  edgex_bus_mqtt_complete (cinfo);
+  free (rctx);
+}
+
+static void edgex_bus_mqtt_onreplay (void *context, MQTTAsync_successData *response)
+{
+  edgex_bus_mqtt_replayed ((edgex_bus_mqtt_replayctx *)context, true);
+}
+
+static void edgex_bus_mqtt_onreplayfail (void *context, MQTTAsync_failureData *response)
+{
+  edgex_bus_mqtt_replayctx *rctx = (edgex_bus_mqtt_replayctx *)context;
+  iot_log_error (rctx->cinfo->lc, "mqtt: publish of spooled message failed, error code %d", response->code);
+  atomic_fetch_add (&rctx->cinfo->failed, 1);
+  edgex_bus_mqtt_replayed (rctx, false);
+}
+
+static void edgex_bus_mqtt_onreplay5 (void *context, MQTTAsync_successData5 *response)
+{
+  edgex_bus_mqtt_onreplay (context, NULL);
+}
+
+static void edgex_bus_mqtt_onreplayfail5 (void *context, MQTTAsync_failureData5 *response)
+{
+  MQTTAsync_failureData fd = { .token = response->token, .code = response->reasonCode, .message = response->message };
+  edgex_bus_mqtt_onreplayfail (context, &fd);
 }
 
 static void edgex_bus_mqtt_subscribe (void *ctx, const char *topic)
@@ -83,48 +609,102 @@ static void edgex_bus_mqtt_subscribe (void *ctx, const char *topic)
   }
 }
 
-static void edgex_bus_mqtt_post (void *ctx, const char *topic, const iot_data_t *envelope, bool use_cbor)
+/* FNV-1a, to assign ordering keys to publisher connections */
+
+static uint32_t edgex_bus_mqtt_hash (const char *key)
+{
+  uint32_t h = 2166136261u;
+  while (*key)
+  {
+    h = (h ^ (uint8_t)*key++) * 16777619u;
+  }
+  return h;
+}
+
+static void edgex_bus_mqtt_post (void *ctx, const char *topic, const void *envelope, size_t len, const edgex_bus_pubopts *pubopts)
 {
   edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)ctx;
-  int result;
-  MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
-  MQTTAsync_responseOptions opts = MQTTAsync_responseOptions_initializer;
-  char *data = NULL;
-  uint32_t datasz = 0;
-  iot_data_t *cbor = NULL;
-  if (use_cbor)
+
+  // Keyed messages go to a publisher connection chosen by the key, so that
+  // messages with the same key keep their order. Those for a connection not
+  // yet made use the main one meanwhile.
+  if (cinfo->nshards && pubopts && pubopts->key)
+  {
+    edgex_bus_mqtt_t *shard = atomic_load (&cinfo->shards[edgex_bus_mqtt_hash (pubopts->key) % cinfo->nshards]);
+    if (shard)
+    {
+      cinfo = shard;
+    }
+  }
+  int qos = (pubopts && pubopts->qos >= 0) ? pubopts->qos : cinfo->qos;
+  bool retained = (pubopts && pubopts->retained >= 0) ? pubopts->retained : cinfo->retained;
+
+  // With a spool, messages which cannot be sent now are stored, as are all
+  // messages while the spool is being replayed
+  if (cinfo->spool)
   {
-    cbor = iot_data_to_cbor (envelope);
-    data = iot_data_binary_take(cbor, &datasz);
+    pthread_mutex_lock (&cinfo->mtx);
+    if (cinfo->replaying || !cinfo->connected || edgex_bus_mqtt_full (cinfo))
+    {
+      if (!edgex_spool_append (cinfo->spool, topic, envelope, len, EDGEX_MQTT_FLAGS (qos, retained)))
+      {
+        iot_log_warn (cinfo->lc, "mqtt: unable to spool message for %s, discarding", topic);
+        atomic_fetch_add (&cinfo->failed, 1);
+      }
+      edgex_bus_mqtt_start_replay (cinfo);
+      pthread_mutex_unlock (&cinfo->mtx);
+      return;
+    }
+    pthread_mutex_unlock (&cinfo->mtx);
   }
-  else
+
+  // Wait for room in the window. Holding up the caller here is what pushes
+  // back on the event queue, whose overflow policy then applies. On a
+  // callback thread the window cannot drain while we wait, so don't.
+  struct timespec deadline;
+  bool buffered;
+  int waitrc = 0;
+  clock_gettime (CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += cinfo->timeout / 1000;
+  deadline.tv_nsec += (cinfo->timeout % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000)
   {
-    data = iot_data_to_json (envelope);
-    datasz = strlen (data);
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
   }
-  pubmsg.payload = data;
-  pubmsg.payloadlen = datasz;
-  pubmsg.qos = cinfo->qos;
-  pubmsg.retained = cinfo->retained;
-  opts.context = cinfo;
-  opts.onSuccess = edgex_bus_mqtt_onsend;
-  opts.onFailure = edgex_bus_mqtt_onsendfail;
-  iot_log_trace (cinfo->lc, "mqtt: publish to topic %s", topic);
-  result = MQTTAsync_sendMessage (cinfo->client, topic, &pubmsg, &opts);
-  if (result != MQTTASYNC_SUCCESS)
+  pthread_mutex_lock (&cinfo->mtx);
+  while (edgex_bus_mqtt_full (cinfo) && !cinfo->closing && !edgex_bus_mqtt_cbthread && waitrc != ETIMEDOUT)
   {
-    iot_log_error (cinfo->lc, "mqtt: failed to post event, error %d", result);
+    waitrc = pthread_cond_timedwait (&cinfo->room, &cinfo->mtx, &deadline);
+  }
+  if (edgex_bus_mqtt_full (cinfo))
+  {
+    pthread_mutex_unlock (&cinfo->mtx);
+    iot_log_warn (cinfo->lc, "mqtt: %s window full, discarding message for %s", cinfo->connected ? "in-flight" : "buffered", topic);
+    atomic_fetch_add (&cinfo->failed, 1);
+    return;
   }
-  iot_data_free (cbor);
-  free(data);
+  buffered = !cinfo->connected;
+  if (buffered)
+  {
+    cinfo->buffered++;
+  }
+  else
+  {
+    cinfo->inflight++;
+  }
+  pthread_mutex_unlock (&cinfo->mtx);
+
+  edgex_bus_mqtt_send (cinfo, topic, envelope, len, qos, retained, buffered, pubopts && pubopts->alias, 0);
 }
 
 static void edgex_bus_mqtt_onconnect(void *context, MQTTAsync_successData *response)
 {
   edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)context;
   iot_log_info (cinfo->lc, "mqtt: connected");
-  cinfo->connected = true;
   pthread_mutex_lock (&cinfo->mtx);
+  cinfo->connected = true;
+  atomic_fetch_add (&cinfo->conngen, 1);
   pthread_cond_signal (&cinfo->cond);
   pthread_mutex_unlock (&cinfo->mtx);
 }
@@ -142,10 +722,39 @@ static void edgex_bus_mqtt_onconnectfail (void *context, MQTTAsync_failureData *
   }
 }
 
+/* With MQTT 5 the broker states how many topic aliases it accepts, which
+   caps the number configured. Automatic reconnections do not report this,
+   so the value from the first connection is kept. */
+
+static void edgex_bus_mqtt_onconnect5 (void *context, MQTTAsync_successData5 *response)
+{
+  edgex_bus_mqtt_t *cinfo = (edgex_bus_mqtt_t *)context;
+  int brokermax = MQTTProperties_getNumericValue (&response->properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM);
+  pthread_mutex_lock (&cinfo->mtx);
+  if (brokermax < 0)
+  {
+    cinfo->aliasmax = 0;
+  }
+  else if (cinfo->aliasmax > brokermax)
+  {
+    cinfo->aliasmax = brokermax;
+  }
+  pthread_mutex_unlock (&cinfo->mtx);
+  iot_log_info (cinfo->lc, "mqtt: using MQTT 5, %" PRIu16 " topic aliases", cinfo->aliasmax);
+  edgex_bus_mqtt_onconnect (context, NULL);
+}
+
+static void edgex_bus_mqtt_onconnectfail5 (void *context, MQTTAsync_failureData5 *response)
+{
+  MQTTAsync_failureData fd = { .token = response->token, .code = response->reasonCode, .message = response->message };
+  edgex_bus_mqtt_onconnectfail (context, &fd);
+}
+
 static int edgex_bus_mqtt_msgarrvd (void *context, char *topicName, int topicLen, MQTTAsync_message *message)
 {
-  edgex_bus_t *bus = (edgex_bus_t *)context;
+  edgex_bus_t *bus = ((edgex_bus_mqtt_t *)context)->bus;
   char *topic = topicName;
+  edgex_bus_mqtt_cbthread = true;
 
   if (topicLen != 0) // Indicates topic string not terminated
   {
@@ -163,64 +772,60 @@ static int edgex_bus_mqtt_msgarrvd (void *context, char *topicName, int topicLen
   return 1;
 }
 
-edgex_bus_t *edgex_bus_create_mqtt (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg, edgex_secret_provider_t *secstore, iot_threadpool_t *queue, const devsdk_timeout *tm)
+/* Creates and connects one client. Publisher connections after the first
+   are numbered from 1, which distinguishes their client ids and spools. */
+
+static edgex_bus_mqtt_t *edgex_bus_mqtt_connect
+  (iot_logger_t *lc, edgex_bus_t *bus, const char *uri, const iot_data_t *cfg, const iot_data_t *secrets, unsigned shard, const devsdk_timeout *tm)
 {
   int rc;
   struct timespec max_wait;
   int timedout = 0;
-  iot_data_t *secrets = NULL;
   MQTTAsync_connectOptions conn_opts = MQTTAsync_connectOptions_initializer;
   MQTTAsync_SSLOptions ssl_opts = MQTTAsync_SSLOptions_initializer;
   MQTTAsync_createOptions create_opts = MQTTAsync_createOptions_initializer;
-  edgex_bus_t *result;
-  edgex_bus_mqtt_t *cinfo = calloc (1, sizeof (edgex_bus_mqtt_t));
-
-  cinfo->lc = lc;
-
-  const char *host = iot_data_string_map_get_string (cfg, EX_BUS_HOST);
-  const char *prot = iot_data_string_map_get_string (cfg, EX_BUS_PROTOCOL);
   const char *certfile = iot_data_string_map_get_string (cfg, EX_BUS_CERTFILE);
   const char *keyfile = iot_data_string_map_get_string (cfg, EX_BUS_KEYFILE);
-  uint16_t port = iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_PORT));
-  if (*prot == '\0' || strcmp (prot, "mqtt") == 0 || strcmp (prot, "tcp") == 0)
-  {
-    prot = "tcp";
-  }
-  else if (strcmp (prot, "ssl") == 0 || strcmp (prot, "tls") == 0 ||
-           strcmp (prot, "mqtts") == 0 || strcmp (prot, "mqtt+ssl") == 0 ||
-           strcmp (prot, "tcps") == 0)
-  {
-    prot = "ssl";
-  }
-  else
-  {
-    iot_log_error (lc, "mqtt: unsupported protocol: %s", prot);
-    free (cinfo);
-    return NULL;
-  }
+  const char *clientid = iot_data_string_map_get_string (cfg, EX_BUS_CLIENTID);
+  const char *spooldir = iot_data_string_map_get_string (cfg, EX_BUS_SPOOLDIR);
+  char *shardid = NULL;
+  edgex_bus_mqtt_t *cinfo = calloc (1, sizeof (edgex_bus_mqtt_t));
 
-  if (port == 0)
+  cinfo->lc = lc;
+  cinfo->bus = bus;
+  cinfo->uri = strdup (uri);
+  cinfo->qos = iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_QOS));
+  cinfo->retained = iot_data_bool (iot_data_string_map_get (cfg, EX_BUS_RETAINED));
+  cinfo->maxinflight = iot_data_ui32 (iot_data_string_map_get (cfg, EX_BUS_MAXINFLIGHT));
+  cinfo->maxbuffered = iot_data_ui32 (iot_data_string_map_get (cfg, EX_BUS_MAXBUFFERED));
+  cinfo->timeout = iot_data_ui32 (iot_data_string_map_get (cfg, EX_BUS_PUBTIMEOUT));
+  cinfo->replayrate = iot_data_ui32 (iot_data_string_map_get (cfg, EX_BUS_SPOOLRATE));
+  uint16_t version = iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_MQTTVERSION));
+  if (version != 3 && version != 5)
   {
-    if (strcmp (prot, "ssl") == 0)
+    if (shard == 0)
     {
-      port = 8883;
-    }
-    else
-    {
-      port = 1883;
+      iot_log_error (lc, "mqtt: unsupported MqttVersion %" PRIu16 ", using 3", version);
     }
+    version = 3;
   }
+  cinfo->v5 = (version == 5);
+  cinfo->aliasmax = cinfo->v5 ? iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_TOPICALIASES)) : 0;
 
-  cinfo->uri = malloc (strlen (host) + strlen (prot) + 10);
-  sprintf (cinfo->uri, "%s://%s:%" PRIu16, prot, host, port);
-  iot_log_info (lc, "Message Bus is set to MQTT at %s", cinfo->uri);
-
-  cinfo->qos = iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_QOS));
-  cinfo->retained = iot_data_bool (iot_data_string_map_get (cfg, EX_BUS_RETAINED));
+  // Client ids must be unique at the broker, so each publisher gets its own
+  if (shard && *clientid)
+  {
+    shardid = malloc (strlen (clientid) + 16);
+    sprintf (shardid, "%s-pub%u", clientid, shard);
+    clientid = shardid;
+  }
 
   create_opts.sendWhileDisconnected = 1;
-  rc = MQTTAsync_createWithOptions
-    (&cinfo->client, cinfo->uri, iot_data_string_map_get_string (cfg, EX_BUS_CLIENTID), MQTTCLIENT_PERSISTENCE_NONE, NULL, &create_opts);
+  // Our own window is the limit; the client's default would discard silently
+  create_opts.maxBufferedMessages = cinfo->maxbuffered ? (int)cinfo->maxbuffered : INT_MAX;
+  create_opts.MQTTVersion = cinfo->v5 ? MQTTVERSION_5 : MQTTVERSION_DEFAULT;
+  rc = MQTTAsync_createWithOptions (&cinfo->client, cinfo->uri, clientid, MQTTCLIENT_PERSISTENCE_NONE, NULL, &create_opts);
+  free (shardid);
   if (rc != MQTTASYNC_SUCCESS)
   {
     iot_log_error (lc, "mqtt: failed to create client, return code %d", rc);
@@ -228,18 +833,32 @@ edgex_bus_t *edgex_bus_create_mqtt (iot_logger_t *lc, const char *svcname, const
     free (cinfo);
     return NULL;
   }
-  result = malloc (sizeof (edgex_bus_t));
-  MQTTAsync_setCallbacks (cinfo->client, result, NULL, edgex_bus_mqtt_msgarrvd, NULL);
+  MQTTAsync_setCallbacks (cinfo->client, cinfo, edgex_bus_mqtt_connlost, edgex_bus_mqtt_msgarrvd, NULL);
+  MQTTAsync_setConnected (cinfo->client, cinfo, edgex_bus_mqtt_connected);
   conn_opts.keepAliveInterval = iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_KEEPALIVE));
-  conn_opts.cleansession = 1;
+  if (cinfo->v5)
+  {
+    conn_opts.MQTTVersion = MQTTVERSION_5;
+    conn_opts.cleansession = 0;
+    conn_opts.cleanstart = 1;
+    conn_opts.onSuccess5 = edgex_bus_mqtt_onconnect5;
+    conn_opts.onFailure5 = edgex_bus_mqtt_onconnectfail5;
+  }
+  else
+  {
+    conn_opts.cleansession = 1;
+    conn_opts.onSuccess = edgex_bus_mqtt_onconnect;
+    conn_opts.onFailure = edgex_bus_mqtt_onconnectfail;
+  }
+  if (cinfo->maxinflight)
+  {
+    conn_opts.maxInflight = cinfo->maxinflight;
+  }
   conn_opts.automaticReconnect = 1;
-  conn_opts.onSuccess = edgex_bus_mqtt_onconnect;
-  conn_opts.onFailure = edgex_bus_mqtt_onconnectfail;
   conn_opts.context = cinfo;
 
-  if (strcmp (iot_data_string_map_get_string (cfg, EX_BUS_AUTHMODE), "usernamepassword") == 0)
+  if (secrets)
   {
-    secrets = edgex_secrets_get (secstore, iot_data_string_map_get_string (cfg, EX_BUS_SECRETNAME));
     conn_opts.username = iot_data_string_map_get_string (secrets, "username");
     conn_opts.password = iot_data_string_map_get_string (secrets, "password");
   }
@@ -254,8 +873,39 @@ edgex_bus_t *edgex_bus_create_mqtt (iot_logger_t *lc, const char *svcname, const
   }
   ssl_opts.verify = iot_data_string_map_get_bool (cfg, EX_BUS_SKIPVERIFY, false) ? 0 : 1;
 
+  pthread_mutex_init (&cinfo->aliasmtx, NULL);
   pthread_mutex_init (&cinfo->mtx, NULL);
   pthread_cond_init (&cinfo->cond, NULL);
+  pthread_cond_init (&cinfo->room, NULL);
+
+  if (*spooldir)
+  {
+    char *dir = NULL;
+    if (shard)
+    {
+      dir = malloc (strlen (spooldir) + 16);
+      sprintf (dir, "%s/pub%u", spooldir, shard);
+      spooldir = dir;
+    }
+    cinfo->spool = edgex_spool_open
+    (
+      lc, spooldir,
+      iot_data_ui32 (iot_data_string_map_get (cfg, EX_BUS_SPOOLSEGSIZE)),
+      iot_data_ui64 (iot_data_string_map_get (cfg, EX_BUS_SPOOLMAXSIZE)),
+      edgex_spool_policy_fromstring (iot_data_string_map_get_string (cfg, EX_BUS_SPOOLOVERFLOW))
+    );
+    if (cinfo->spool)
+    {
+      iot_log_info (lc, "mqtt: spooling undeliverable messages in %s", spooldir);
+      cinfo->replaypool = iot_threadpool_alloc (1, 0, IOT_THREAD_NO_PRIORITY, IOT_THREAD_NO_AFFINITY, lc);
+      iot_threadpool_start (cinfo->replaypool);
+    }
+    else
+    {
+      iot_log_error (lc, "mqtt: unable to open spool in %s, messages will not be spooled", spooldir);
+    }
+    free (dir);
+  }
   while (true)
   {
     uint64_t t1, t2;
@@ -300,26 +950,118 @@ edgex_bus_t *edgex_bus_create_mqtt (iot_logger_t *lc, const char *svcname, const
       }
     }
   }
-  iot_data_free (secrets);
-  pthread_cond_destroy (&cinfo->cond);
-  pthread_mutex_destroy (&cinfo->mtx);
 
   if (cinfo->connected)
+  {
+    pthread_mutex_lock (&cinfo->mtx);
+    edgex_bus_mqtt_start_replay (cinfo);
+    pthread_mutex_unlock (&cinfo->mtx);
+  }
+  else
+  {
+    edgex_bus_mqtt_close (cinfo);
+    cinfo = NULL;
+  }
+  return cinfo;
+}
+
+edgex_bus_t *edgex_bus_create_mqtt (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg, edgex_secret_provider_t *secstore, iot_threadpool_t *queue, const devsdk_timeout *tm)
+{
+  iot_data_t *secrets = NULL;
+  edgex_bus_t *result;
+  edgex_bus_mqtt_t *cinfo;
+
+  const char *host = iot_data_string_map_get_string (cfg, EX_BUS_HOST);
+  const char *prot = iot_data_string_map_get_string (cfg, EX_BUS_PROTOCOL);
+  uint16_t port = iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_PORT));
+  uint16_t npub = iot_data_ui16 (iot_data_string_map_get (cfg, EX_BUS_PUBLISHERS));
+  if (*prot == '\0' || strcmp (prot, "mqtt") == 0 || strcmp (prot, "tcp") == 0)
+  {
+    prot = "tcp";
+  }
+  else if (strcmp (prot, "ssl") == 0 || strcmp (prot, "tls") == 0 ||
+           strcmp (prot, "mqtts") == 0 || strcmp (prot, "mqtt+ssl") == 0 ||
+           strcmp (prot, "tcps") == 0)
+  {
+    prot = "ssl";
+  }
+  else
+  {
+    iot_log_error (lc, "mqtt: unsupported protocol: %s", prot);
+    return NULL;
+  }
+
+  if (port == 0)
+  {
+    if (strcmp (prot, "ssl") == 0)
+    {
+      port = 8883;
+    }
+    else
+    {
+      port = 1883;
+    }
+  }
+
+  char *uri = malloc (strlen (host) + strlen (prot) + 10);
+  sprintf (uri, "%s://%s:%" PRIu16, prot, host, port);
+  iot_log_info (lc, "Message Bus is set to MQTT at %s", uri);
+
+  if (strcmp (iot_data_string_map_get_string (cfg, EX_BUS_AUTHMODE), "usernamepassword") == 0)
+  {
+    secrets = edgex_secrets_get (secstore, iot_data_string_map_get_string (cfg, EX_BUS_SECRETNAME));
+  }
+
+  result = malloc (sizeof (edgex_bus_t));
+  cinfo = edgex_bus_mqtt_connect (lc, result, uri, cfg, secrets, 0, tm);
+  if (cinfo)
   {
     edgex_bus_init (result, svcname, cfg);
     result->ctx = cinfo;
     result->postfn = edgex_bus_mqtt_post;
     result->freefn = edgex_bus_mqtt_free;
     result->subsfn = edgex_bus_mqtt_subscribe;
+    result->statsfn = edgex_bus_mqtt_stats;
+
+    // The main connection is the first publisher, so npub is the total
+    if (npub > 1)
+    {
+      unsigned connected = 1;
+      cinfo->shards = calloc (npub, sizeof (*cinfo->shards));
+      cinfo->nshards = npub;
+      atomic_init (&cinfo->shards[0], cinfo);
+      for (unsigned i = 1; i < npub; i++)
+      {
+        edgex_bus_mqtt_t *shard = edgex_bus_mqtt_connect (lc, result, uri, cfg, secrets, i, tm);
+        atomic_init (&cinfo->shards[i], shard);
+        connected += shard ? 1 : 0;
+      }
+      if (connected < npub)
+      {
+        iot_log_error (lc, "mqtt: connected %u of %" PRIu16 " publisher connections, will retry", connected, npub);
+        cinfo->cfg = iot_data_add_ref (cfg);
+        cinfo->secrets = secrets ? iot_data_add_ref (secrets) : NULL;
+        pthread_cond_init (&cinfo->retry, NULL);
+        iot_threadpool_t *pool = iot_threadpool_alloc (1, 0, IOT_THREAD_NO_PRIORITY, IOT_THREAD_NO_AFFINITY, lc);
+        iot_threadpool_start (pool);
+        pthread_mutex_lock (&cinfo->mtx);
+        cinfo->retrypool = pool;
+        edgex_bus_mqtt_start_retry (cinfo);
+        pthread_mutex_unlock (&cinfo->mtx);
+      }
+      else
+      {
+        iot_log_info (lc, "mqtt: publishing events over %" PRIu16 " connections", npub);
+      }
+    }
   }
   else
   {
-    MQTTAsync_destroy (&cinfo->client);
-    free (cinfo->uri);
-    free (cinfo);
     free (result);
     result = NULL;
   }
+  iot_data_free (secrets);
+  free (uri);
 
   return result;
 }
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "bus.h"
+#include "bus-impl.h"
+#include "edgex/shmring.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* Message bus which publishes into a shared-memory ring, for consumers on
+ * the same host. See edgex/shmring.h for the layout. Publishing is
+ * serialized within the service; consumers read the ring in place.
+ */
+
+typedef struct edgex_bus_shm_t
+{
+  iot_logger_t *lc;
+  edgex_shmring_hdr *hdr;
+  uint8_t *data;
+  size_t maplen;
+  pthread_mutex_t mtx;
+} edgex_bus_shm_t;
+
+#define EDGEX_SHM_ALIGNED(n) (((n) + EDGEX_SHMRING_ALIGN - 1) & ~(size_t)(EDGEX_SHMRING_ALIGN - 1))
+
+static void edgex_bus_shm_post (void *ctx, const char *path, const void *envelope, size_t len, const edgex_bus_pubopts *opts)
+{
+  edgex_bus_shm_t *sb = (edgex_bus_shm_t *)ctx;
+  edgex_shmring_hdr *hdr = sb->hdr;
+  size_t topiclen = strlen (path) + 1;
+  size_t reclen = EDGEX_SHM_ALIGNED (sizeof (edgex_shmring_rec) + topiclen + len);
+
+  if (reclen > hdr->size / 2)
+  {
+    iot_log_error (sb->lc, "shm: message of %zu bytes to %s exceeds half the ring size, discarding", len, path);
+    return;
+  }
+
+  pthread_mutex_lock (&sb->mtx);
+  uint64_t pos = atomic_load_explicit (&hdr->head, memory_order_relaxed);
+  uint64_t offset = pos % hdr->size;
+  uint64_t pad = (offset + reclen > hdr->size) ? hdr->size - offset : 0;
+
+  // Announce the extent to be written before overwriting old records
+  atomic_store_explicit (&hdr->reserved, pos + pad + reclen, memory_order_relaxed);
+  atomic_thread_fence (memory_order_release);
+
+  if (pad)
+  {
+    edgex_shmring_rec *padrec = (edgex_shmring_rec *)(sb->data + offset);
+    padrec->len = pad;
+    padrec->topiclen = 0;
+    padrec->envlen = 0;
+    padrec->flags = 0;
+    pos += pad;
+    offset = 0;
+  }
+  edgex_shmring_rec *rec = (edgex_shmring_rec *)(sb->data + offset);
+  rec->len = reclen;
+  rec->topiclen = topiclen;
+  rec->envlen = len;
+  rec->flags = 0;
+  memcpy (rec + 1, path, topiclen);
+  memcpy ((uint8_t *)(rec + 1) + topiclen, envelope, len);
+
+  atomic_store_explicit (&hdr->head, pos + reclen, memory_order_release);
+  atomic_fetch_add (&hdr->notify, 1);
+  if (atomic_load (&hdr->waiters))
+  {
+    syscall (SYS_futex, &hdr->notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+  pthread_mutex_unlock (&sb->mtx);
+}
+
+static void edgex_bus_shm_subscribe (void *ctx, const char *topic)
+{
+  edgex_bus_shm_t *sb = (edgex_bus_shm_t *)ctx;
+  iot_log_debug (sb->lc, "shm: requests are not received over the shared-memory bus, ignoring subscription to %s", topic);
+}
+
+static void edgex_bus_shm_free (void *ctx)
+{
+  edgex_bus_shm_t *sb = (edgex_bus_shm_t *)ctx;
+  munmap (sb->hdr, sb->maplen);
+  pthread_mutex_destroy (&sb->mtx);
+  free (sb);
+}
+
+edgex_bus_t *edgex_bus_create_shm (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg)
+{
+  const char *path = iot_data_string_map_get_string (cfg, EX_BUS_SHMPATH);
+  uint64_t size = EDGEX_SHM_ALIGNED (iot_data_ui32 (iot_data_string_map_get (cfg, EX_BUS_SHMSIZE)));
+  size_t maplen = sizeof (edgex_shmring_hdr) + size;
+  struct stat st;
+
+  if (size < 4096)
+  {
+    iot_log_error (lc, "shm: ring size %" PRIu64 " is too small", size);
+    return NULL;
+  }
+  int fd = open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+  if (fd < 0)
+  {
+    iot_log_error (lc, "shm: unable to open %s: %s", path, strerror (errno));
+    return NULL;
+  }
+  if (fstat (fd, &st) != 0 || ((size_t)st.st_size != maplen && ftruncate (fd, maplen) != 0))
+  {
+    iot_log_error (lc, "shm: unable to size %s: %s", path, strerror (errno));
+    close (fd);
+    return NULL;
+  }
+  void *map = mmap (NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+  {
+    iot_log_error (lc, "shm: unable to map %s: %s", path, strerror (errno));
+    return NULL;
+  }
+
+  edgex_bus_shm_t *sb = calloc (1, sizeof (edgex_bus_shm_t));
+  sb->lc = lc;
+  sb->hdr = (edgex_shmring_hdr *)map;
+  sb->data = (uint8_t *)(sb->hdr + 1);
+  sb->maplen = maplen;
+  pthread_mutex_init (&sb->mtx, NULL);
+
+  // Continue an existing ring, so that positions held by readers stay valid
+  if (sb->hdr->magic != EDGEX_SHMRING_MAGIC || sb->hdr->version != EDGEX_SHMRING_VERSION || sb->hdr->size != size)
+  {
+    sb->hdr->size = size;
+    sb->hdr->version = EDGEX_SHMRING_VERSION;
+    atomic_store (&sb->hdr->head, 0);
+    atomic_store (&sb->hdr->reserved, 0);
+    atomic_store (&sb->hdr->notify, 0);
+    atomic_store (&sb->hdr->waiters, 0);
+    atomic_thread_fence (memory_order_release);
+    sb->hdr->magic = EDGEX_SHMRING_MAGIC;
+  }
+  else
+  {
+    atomic_store (&sb->hdr->reserved, atomic_load (&sb->hdr->head));
+  }
+  iot_log_info (lc, "shm: publishing to %s, ring size %" PRIu64, path, size);
+
+  edgex_bus_t *result = calloc (1, sizeof (edgex_bus_t));
+  edgex_bus_init (result, svcname, cfg);
+  result->ctx = sb;
+  result->postfn = edgex_bus_shm_post;
+  result->freefn = edgex_bus_shm_free;
+  result->subsfn = edgex_bus_shm_subscribe;
+  return result;
+}
+
+#else
+
+edgex_bus_t *edgex_bus_create_shm (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg)
+{
+  iot_log_error (lc, "shm: the shared-memory bus is only available on Linux");
+  return NULL;
+}
+
+#endif
@@ -10,144 +10,295 @@
 #include "bus-impl.h"
 #include "correlation.h"
 #include "api.h"
-#include <iot/base64.h>
+#include "encoder.h"
+#include "b64.h"
+
+/* Handlers are dispatched through a trie of topic levels. A level is either
+   a literal, a {param} capture or a trailing '#' which matches any number of
+   further levels. The trie is immutable once built: registration builds a
+   new one under the bus mutex and publishes it with an atomic pointer swap,
+   so dispatch takes no lock. Superseded tries are retained until the bus is
+   freed, as a dispatch may still be walking one. */
+
+#define EDGEX_BUS_MAXPARAMS 8
 
 typedef struct edgex_bus_endpoint_t
 {
-  char *base;
-  iot_data_t *params;
+  iot_data_t *keys[EDGEX_BUS_MAXPARAMS];
+  unsigned nparams;
+  int devparam;
   edgex_handler_fn handler;
   void *ctx;
-  size_t base_len;
-  bool ignore_tail;
+  char *path;
 } edgex_bus_endpoint_t;
 
-static iot_data_t *edgex_bus_parse_tail (const char *tail, const edgex_bus_endpoint_t *ep)
+typedef struct edgex_bus_node_t
+{
+  char *level;
+  size_t len;
+  struct edgex_bus_node_t *children;
+  struct edgex_bus_node_t *next;
+  struct edgex_bus_node_t *param;
+  const edgex_bus_endpoint_t *ep;
+  const edgex_bus_endpoint_t *multi;
+} edgex_bus_node_t;
+
+struct edgex_bus_trie_t
+{
+  edgex_bus_node_t root;
+  struct edgex_bus_trie_t *retired;
+};
+
+typedef struct edgex_bus_match_t
 {
-  iot_data_t *result = iot_data_alloc_list();
-  if (ep->ignore_tail)
+  const char *start[EDGEX_BUS_MAXPARAMS];
+  size_t len[EDGEX_BUS_MAXPARAMS];
+} edgex_bus_match_t;
+
+static void edgex_bus_node_free (edgex_bus_node_t *node)
+{
+  while (node)
   {
-    return result;
+    edgex_bus_node_t *next = node->next;
+    edgex_bus_node_free (node->children);
+    edgex_bus_node_free (node->param);
+    free (node->level);
+    free (node);
+    node = next;
   }
-  tail += ep->base_len;
-  while (*tail)
+}
+
+static void edgex_bus_trie_free (edgex_bus_trie_t *trie)
+{
+  while (trie)
   {
-    char *element;
-    char *c = strchr (tail, '/');
-    if (c)
+    edgex_bus_trie_t *next = trie->retired;
+    edgex_bus_node_free (trie->root.children);
+    edgex_bus_node_free (trie->root.param);
+    free (trie);
+    trie = next;
+  }
+}
+
+static edgex_bus_node_t *edgex_bus_node_child (edgex_bus_node_t *node, const char *level, size_t len)
+{
+  edgex_bus_node_t *child;
+  for (child = node->children; child; child = child->next)
+  {
+    if (child->len == len && strncmp (child->level, level, len) == 0)
     {
-      element = strndup (tail, c - tail);
-      tail = c + 1;
+      return child;
+    }
+  }
+  child = calloc (1, sizeof (edgex_bus_node_t));
+  child->level = strndup (level, len);
+  child->len = len;
+  child->next = node->children;
+  node->children = child;
+  return child;
+}
+
+/* Endpoints are visited newest first; where two share a topic, the newest
+   registration takes precedence */
+
+static void edgex_bus_trie_insert (edgex_bus_trie_t *trie, const edgex_bus_endpoint_t *ep)
+{
+  edgex_bus_node_t *node = &trie->root;
+  const char *level = ep->path;
+  while (true)
+  {
+    const char *end = level + strcspn (level, "/");
+    size_t len = end - level;
+    if (len == 1 && *level == '#' && *end == '\0')
+    {
+      if (node->multi == NULL)
+      {
+        node->multi = ep;
+      }
+      return;
+    }
+    if (len >= 2 && *level == '{' && level[len - 1] == '}')
+    {
+      if (node->param == NULL)
+      {
+        node->param = calloc (1, sizeof (edgex_bus_node_t));
+      }
+      node = node->param;
     }
     else
     {
-      element = strdup (tail);
-      tail += strlen (element);
+      node = edgex_bus_node_child (node, level, len);
+    }
+    if (*end == '\0')
+    {
+      break;
     }
-    iot_data_list_tail_push (result, iot_data_alloc_string (element, IOT_DATA_TAKE));
+    level = end + 1;
+  }
+  if (node->ep == NULL)
+  {
+    node->ep = ep;
   }
-  return result;
 }
 
-static edgex_handler_fn edgex_bus_match_handler(edgex_bus_t *bus, const char *path, iot_data_t *params, void **ctx)
+/* Finds the endpoint for the remainder of a topic, trying literal levels
+   before captures before '#'. Captured levels are recorded as slices of the
+   topic. */
+
+static const edgex_bus_endpoint_t *edgex_bus_trie_match (const edgex_bus_node_t *node, const char *level, unsigned depth, edgex_bus_match_t *m)
 {
-  edgex_handler_fn h = NULL;
-  iot_data_list_iter_t iter;
-  pthread_mutex_lock (&bus->mtx);
-  iot_data_list_iter (bus->handlers, &iter);
-  while (iot_data_list_iter_next (&iter))
+  const edgex_bus_endpoint_t *result = NULL;
+  const char *end = level + strcspn (level, "/");
+  size_t len = end - level;
+
+  for (const edgex_bus_node_t *child = node->children; child; child = child->next)
   {
-    const edgex_bus_endpoint_t *ep = iot_data_address (iot_data_list_iter_value (&iter));
-    if (strncmp (path, ep->base, ep->base_len) == 0)
+    if (child->len == len && memcmp (child->level, level, len) == 0)
     {
-      iot_data_t *tail = edgex_bus_parse_tail (path, ep);
-      if (iot_data_list_length (tail) == iot_data_list_length (ep->params))
-      {
-        iot_data_list_iter_t keys;
-        iot_data_list_iter_t vals;
-        iot_data_list_iter (ep->params, &keys);
-        iot_data_list_iter (tail, &vals);
-        while (iot_data_list_iter_next (&keys))
-        {
-          iot_data_list_iter_next (&vals);
-          iot_data_map_add (params, iot_data_add_ref (iot_data_list_iter_value (&keys)), iot_data_add_ref (iot_data_list_iter_value (&vals)));
-        }
-        h = ep->handler;
-        *ctx = ep->ctx;
-        iot_data_free (tail);
-        break;
-      }
-      iot_data_free (tail);
+      result = *end ? edgex_bus_trie_match (child, end + 1, depth, m) : (child->ep ? child->ep : child->multi);
+      break;
     }
   }
-  pthread_mutex_unlock (&bus->mtx);
-  return h;
+  if (result == NULL && node->param && depth < EDGEX_BUS_MAXPARAMS)
+  {
+    m->start[depth] = level;
+    m->len[depth] = len;
+    result = *end ? edgex_bus_trie_match (node->param, end + 1, depth + 1, m) : (node->param->ep ? node->param->ep : node->param->multi);
+  }
+  if (result == NULL)
+  {
+    result = node->multi;
+  }
+  return result;
+}
+
+static const edgex_bus_endpoint_t *edgex_bus_match_handler (edgex_bus_t *bus, const char *path, edgex_bus_match_t *m)
+{
+  const edgex_bus_trie_t *trie = atomic_load_explicit (&bus->trie, memory_order_acquire);
+  return trie ? edgex_bus_trie_match (&trie->root, path, 0, m) : NULL;
 }
 
 static void edgex_bus_endpoint_free (void *p)
 {
   edgex_bus_endpoint_t *ep = (edgex_bus_endpoint_t *)p;
-  free (ep->base);
-  iot_data_free (ep->params);
+  for (unsigned i = 0; i < ep->nparams; i++)
+  {
+    iot_data_free (ep->keys[i]);
+  }
+  free (ep->path);
   free (ep);
 }
 
-static char *edgex_data_to_b64 (const iot_data_t *src, bool use_cbor)
+/* Envelopes are written directly. The payload is either nested in the
+   envelope, spliced in if it is already encoded, or base64-encoded. */
+
+static void edgex_bus_write_payload (edgex_bus_t *bus, edgex_encoder *enc, const iot_data_t *payload, bool event_is_cbor)
 {
-  char *data = NULL;
-  uint32_t sz = 0;
-  iot_data_t *cbor = NULL;
-  if (use_cbor)
+  bool encoded = (iot_data_type (payload) == IOT_DATA_BINARY);
+
+  // Like Go SDK's behavior: if envelope is CBOR, payload will not be base64-encoded, either way.
+  // If envelope is JSON and the event is a binary reading, payload will be base64-encoded CBOR, either way.
+  if ((!bus->cbor) && (bus->msgb64payload || event_is_cbor))
   {
-    cbor = iot_data_to_cbor (src);
-    if (cbor)
+    if (encoded)
+    {
+      edgex_enc_bytes (enc, iot_data_address (payload), iot_data_array_size (payload));
+    }
+    else
     {
-      data = iot_data_binary_take(cbor, &sz);
+      edgex_encoder penc;
+      edgex_enc_init (&penc, event_is_cbor, 0);
+      edgex_enc_data (&penc, payload);
+      edgex_enc_bytes (enc, penc.data, penc.len);
+      edgex_enc_fini (&penc);
     }
   }
+  else if (encoded)
+  {
+    edgex_enc_encoded (enc, iot_data_address (payload), iot_data_array_size (payload));
+  }
   else
   {
-    data = iot_data_to_json (src);
-    sz = strlen (data); // ignore the last null character, which causes an unmarshal error in core-data
+    edgex_enc_data (enc, payload);
   }
-  size_t encsz = iot_b64_encodesize (sz);
-  char *result = malloc (encsz);
-  iot_b64_encode (data, sz, result, encsz);
-  iot_data_free (cbor);
-  free (data);
-  return result;
 }
 
-void edgex_bus_post (edgex_bus_t *bus, const char *path, const iot_data_t *payload, bool event_is_cbor)
+/* Allowance for the envelope fields other than the payload */
+
+#define EDGEX_BUS_ENVELOPE_SIZE 192
+
+/* Size the envelope buffer for a pre-encoded payload, so that large
+   payloads are written in one pass without reallocation */
+
+static size_t edgex_bus_envelope_size (edgex_bus_t *bus, const char *crlid, const iot_data_t *payload, bool event_is_cbor)
 {
-  iot_data_t *envelope = iot_data_alloc_map (IOT_DATA_STRING);
-  if (edgex_device_get_crlid ())
+  size_t result = EDGEX_BUS_ENVELOPE_SIZE + (crlid ? strlen (crlid) : 0);
+  if (iot_data_type (payload) == IOT_DATA_BINARY)
   {
-    iot_data_string_map_add (envelope, "correlationID", iot_data_alloc_string (edgex_device_get_crlid (), IOT_DATA_REF));
+    size_t plen = iot_data_array_size (payload);
+    result += ((!bus->cbor) && (bus->msgb64payload || event_is_cbor)) ? 4 * ((plen + 2) / 3) : plen;
   }
-  iot_data_string_map_add (envelope, "apiVersion", iot_data_alloc_string (EDGEX_API_VERSION, IOT_DATA_REF));
-  iot_data_string_map_add (envelope, "errorCode", iot_data_alloc_ui32 (0));
-  if (event_is_cbor || bus->cbor)
+  return result;
+}
+
+static void edgex_bus_send
+  (edgex_bus_t *bus, const char *path, const char *crlid, int32_t code, const iot_data_t *payload, bool event_is_cbor, const edgex_bus_pubopts *opts)
+{
+  size_t len;
+  void *data;
+  edgex_encoder enc;
+
+  edgex_enc_init (&enc, bus->cbor, edgex_bus_envelope_size (bus, crlid, payload, event_is_cbor));
+  edgex_enc_map_start (&enc, crlid ? 5 : 4);
+  if (crlid)
   {
-    iot_data_string_map_add (envelope, "contentType", iot_data_alloc_string ("application/cbor", IOT_DATA_REF));
+    edgex_enc_key (&enc, "correlationID");
+    edgex_enc_string (&enc, crlid);
   }
-  else
+  edgex_enc_key (&enc, "apiVersion");
+  edgex_enc_string (&enc, EDGEX_API_VERSION);
+  edgex_enc_key (&enc, "errorCode");
+  edgex_enc_int (&enc, code);
+  edgex_enc_key (&enc, "contentType");
+  edgex_enc_string (&enc, (event_is_cbor || bus->cbor) ? "application/cbor" : "application/json");
+  edgex_enc_key (&enc, "payload");
+  edgex_bus_write_payload (bus, &enc, payload, event_is_cbor);
+  edgex_enc_map_end (&enc);
+
+  data = edgex_enc_take (&enc, &len);
+  if (bus->takefn)
   {
-    iot_data_string_map_add (envelope, "contentType", iot_data_alloc_string ("application/json", IOT_DATA_REF));
+    bus->takefn (bus->ctx, path, data, len, opts);
   }
-  // Like Go SDK's behavior: if envelope is CBOR, payload will not be base64-encoded, either way.
-  // If envelope is JSON and the event is a binary reading, payload will be base64-encoded CBOR, either way.
-  if ((!bus->cbor) && (bus->msgb64payload || event_is_cbor))
+  else
   {
-    iot_data_string_map_add (envelope, "payload", iot_data_alloc_string (edgex_data_to_b64 (payload, event_is_cbor), IOT_DATA_TAKE));
+    bus->postfn (bus->ctx, path, data, len, opts);
+    free (data);
   }
-  else
+}
+
+void edgex_bus_post (edgex_bus_t *bus, const char *path, const iot_data_t *payload, bool event_is_cbor)
+{
+  edgex_bus_send (bus, path, edgex_device_get_crlid (), 0, payload, event_is_cbor, NULL);
+}
+
+void edgex_bus_post_opts (edgex_bus_t *bus, const char *path, const iot_data_t *payload, bool event_is_cbor, const edgex_bus_pubopts *opts)
+{
+  edgex_bus_send (bus, path, edgex_device_get_crlid (), 0, payload, event_is_cbor, opts);
+}
+
+void edgex_bus_get_stats (edgex_bus_t *bus, edgex_bus_stats *stats)
+{
+  memset (stats, 0, sizeof (*stats));
+  if (bus && bus->statsfn)
   {
-    iot_data_string_map_add (envelope, "payload", iot_data_add_ref (payload));
+    bus->statsfn (bus->ctx, stats);
   }
+}
 
-  bus->postfn (bus->ctx, path, envelope, bus->cbor);
-  iot_data_free (envelope);
+bool edgex_bus_cbor (const edgex_bus_t *bus)
+{
+  return bus->cbor;
 }
 
 int edgex_bus_rmi (edgex_bus_t *bus, const char *path, const char *svcname, const iot_data_t *request, iot_data_t **reply)
@@ -158,138 +309,177 @@ int edgex_bus_rmi (edgex_bus_t *bus, const char *path, const char *svcname, cons
   return -1;
 }
 
-void edgex_bus_handle_request (edgex_bus_t *bus, const char *path, const char *envelope, uint32_t len)
+/* The envelope is parsed in place if it is known to be nul-terminated,
+   otherwise a terminated copy is made for the JSON parser */
+
+static void edgex_bus_dispatch
+  (edgex_bus_t *bus, const edgex_bus_endpoint_t *ep, const edgex_bus_match_t *m, const char *envelope, uint32_t len, bool terminated)
 {
-  void *ctx = NULL;
   iot_data_t *pathparams = iot_data_alloc_map (IOT_DATA_STRING);
-  edgex_handler_fn h = edgex_bus_match_handler (bus, path, pathparams, &ctx);
-
-  if (h)
-  {
-    int32_t status;
-    const iot_data_t *crl = NULL;
-    iot_data_t *req = NULL;
-    iot_data_t *reply = NULL;
-    iot_data_t *envdata = NULL;
-    bool envelope_is_json = false;
-    bool payload_is_cbor = false;
-    if (bus->cbor)
+  for (unsigned i = 0; i < ep->nparams; i++)
+  {
+    iot_data_map_add (pathparams, iot_data_add_ref (ep->keys[i]), iot_data_alloc_string (strndup (m->start[i], m->len[i]), IOT_DATA_TAKE));
+  }
+  int32_t status;
+  const iot_data_t *crl = NULL;
+  iot_data_t *req = NULL;
+  iot_data_t *reply = NULL;
+  iot_data_t *envdata = NULL;
+  bool envelope_is_json = false;
+  bool payload_is_cbor = false;
+  if (bus->cbor)
+  {
+    envdata = iot_data_from_cbor ((const uint8_t *)envelope, len);
+  }
+  else
+  {
+    envelope_is_json = true;
+    if (!terminated && envelope[len - 1] != '\0')
     {
-      envdata = iot_data_from_cbor ((const uint8_t *)envelope, len);
+      char *nullterm = strndup (envelope, len);
+      envdata = iot_data_from_json (nullterm);
+      free (nullterm);
     }
     else
     {
-      envelope_is_json = true;
-      if (envelope[len - 1] != '\0')
+      envdata = iot_data_from_json (envelope);
+    }
+  }
+  const char *contentType = iot_data_string_map_get_string (envdata, "contentType");
+  if (strcmp (contentType, "application/cbor") == 0)
+  {
+    payload_is_cbor = true;
+  }
+
+  if ((bus->msgb64payload) || (envelope_is_json && payload_is_cbor))
+  {
+    const char *payload = iot_data_string_map_get_string (envdata, "payload");
+    if (payload) 
+    {
+      size_t plen = strlen (payload);
+      size_t sz;
+      char *data = malloc (EDGEX_B64_MAXDECLEN (plen) + 1);
+      if (!edgex_b64_decode (payload, plen, data, &sz))
+      {
+        iot_log_error (iot_logger_default (), "edgex_bus_handle_request: invalid base64 payload");
+      }
+      else if (payload_is_cbor)
       {
-        char *nullterm = strndup (envelope, len);
-        envdata = iot_data_from_json (nullterm);
-        free (nullterm);
+        req = iot_data_from_cbor ((const uint8_t *)data, sz);
       }
       else
       {
-        envdata = iot_data_from_json (envelope);
+        data[sz] = '\0';
+        req = iot_data_from_json (data);
       }
+      free (data);
     }
-    const char *contentType = iot_data_string_map_get_string (envdata, "contentType");
-    if (strcmp (contentType, "application/cbor") == 0)
+  }
+  else
+  {
+    const iot_data_t *payload = iot_data_string_map_get_map (envdata, "payload");
+    if (payload)
     {
-      payload_is_cbor = true;
+      req = iot_data_add_ref (payload);
     }
+  }
 
-    if ((bus->msgb64payload) || (envelope_is_json && payload_is_cbor))
+
+  crl = iot_data_string_map_get (envdata, "correlationID");
+  if (crl)
+  {
+    edgex_device_alloc_crlid (iot_data_string (crl));
+  }
+  bool event_is_cbor = false;
+  status = ep->handler (ep->ctx, req, pathparams, iot_data_string_map_get (envdata, "queryParams"), &reply, &event_is_cbor);
+  if (reply)
+  {
+    const iot_data_t *id = iot_data_string_map_get (envdata, "requestID");
+    if (!id)
     {
-      const char *payload = iot_data_string_map_get_string (envdata, "payload");
-      if (payload) 
-      {
-        size_t sz = iot_b64_maxdecodesize(payload);
-        char *data = malloc(sz + 1);
-        iot_b64_decode(payload, data, &sz);
-        data[sz] = '\0';
-        if (payload_is_cbor)
-        {
-          req = iot_data_from_cbor ((const uint8_t *)data, sz);
-        }
-        else
-        {
-          req = iot_data_from_json (data);
-        }
-        free(data);
-      }
+      id = iot_data_string_map_get (envdata, "requestId");
+    }
+    if (id)
+    {
+      char *rpath = edgex_bus_mktopic (bus, EDGEX_DEV_TOPIC_RESPONSE, iot_data_string (id));
+      edgex_bus_send (bus, rpath, crl ? iot_data_string (crl) : NULL, status, reply, event_is_cbor, NULL);
+      free (rpath);
     }
     else
     {
-      const iot_data_t *payload = iot_data_string_map_get_map (envdata, "payload");
-      if (payload)
-      {
-        req = iot_data_add_ref (payload);
-      }
+      iot_log_error(iot_logger_default (), "edgex_bus_handle_request: no request ID in envelope, cannot send reply");
     }
+    iot_data_free (reply);
+  }
+  if (crl)
+  {
+    edgex_device_free_crlid ();
+  }
+  iot_data_free (req);
+  iot_data_free (envdata);
+  iot_data_free (pathparams);
+}
 
+/* A request copied for execution on the command queue. The path and
+   envelope follow the structure in the same allocation, the envelope
+   with a terminator added. */
 
-    crl = iot_data_string_map_get (envdata, "correlationID");
-    if (crl)
-    {
-      edgex_device_alloc_crlid (iot_data_string (crl));
-    }
-    bool event_is_cbor = false;
-    status = h (ctx, req, pathparams, iot_data_string_map_get (envdata, "queryParams"), &reply, &event_is_cbor);
-    if (reply)
+typedef struct edgex_bus_request_t
+{
+  edgex_bus_t *bus;
+  const edgex_bus_endpoint_t *ep;
+  edgex_bus_match_t match;
+  const char *envelope;
+  uint32_t len;
+} edgex_bus_request_t;
+
+static void edgex_bus_run_request (void *p)
+{
+  edgex_bus_request_t *r = (edgex_bus_request_t *)p;
+  edgex_bus_dispatch (r->bus, r->ep, &r->match, r->envelope, r->len, true);
+  free (r);
+}
+
+void edgex_bus_handle_request (edgex_bus_t *bus, const char *path, const char *envelope, uint32_t len)
+{
+  edgex_bus_match_t match;
+  const edgex_bus_endpoint_t *ep = edgex_bus_match_handler (bus, path, &match);
+  if (ep == NULL)
+  {
+    return;
+  }
+  // Only requests addressed to a device are queued, in that device's lane.
+  // Others, notably the metadata callbacks which add, update and remove
+  // devices, run here as they arrive, so that they take effect before any
+  // later request is queued.
+  if (bus->cmdq && ep->devparam >= 0)
+  {
+    size_t plen = strlen (path) + 1;
+    edgex_bus_request_t *r = malloc (sizeof (edgex_bus_request_t) + plen + len + 1);
+    char *copy = (char *)(r + 1);
+    memcpy (copy, path, plen);
+    memcpy (copy + plen, envelope, len);
+    copy[plen + len] = '\0';
+    r->bus = bus;
+    r->ep = ep;
+    r->envelope = copy + plen;
+    r->len = len;
+    for (unsigned i = 0; i < ep->nparams; i++)
     {
-      char *rpath;
-      const char *idstr;
-      const iot_data_t *id;
-      iot_data_t *renv = iot_data_alloc_map (IOT_DATA_STRING);
-      iot_data_string_map_add (renv, "errorCode", iot_data_alloc_i32 (status));
-      if (bus->cbor || event_is_cbor)
-      {
-        iot_data_string_map_add (renv, "contentType", iot_data_alloc_string ("application/cbor", IOT_DATA_REF));
-      }
-      else
-      {
-        iot_data_string_map_add (renv, "contentType", iot_data_alloc_string ("application/json", IOT_DATA_REF));
-      }
-      if ((!bus->cbor) && (bus->msgb64payload || event_is_cbor))
-      {
-        iot_data_string_map_add (renv, "payload", iot_data_alloc_string (edgex_data_to_b64 (reply, event_is_cbor), IOT_DATA_TAKE));
-      }
-      else
-      {
-        iot_data_string_map_add (renv, "payload", iot_data_add_ref (reply));
-      }
-      iot_data_free (reply);
-      iot_data_string_map_add (renv, "correlationID", iot_data_add_ref (crl));
-      iot_data_string_map_add (renv, "apiVersion", iot_data_alloc_string (EDGEX_API_VERSION, IOT_DATA_REF));
-      id = iot_data_string_map_get (envdata, "requestID");
-      if (!id)
-      {
-        id = iot_data_string_map_get (envdata, "requestId");
-      }
-      if (id)
-      {
-        idstr = iot_data_string (id);
-        // iot_data_string_map_add (renv, "requestID", iot_data_add_ref (id));
-        rpath = edgex_bus_mktopic (bus, EDGEX_DEV_TOPIC_RESPONSE, idstr);
-        bus->postfn (bus->ctx, rpath, renv, bus->cbor);
-        free (rpath);
-      }
-      else
-      {
-        iot_log_error(iot_logger_default (), "edgex_bus_handle_request: no request ID in envelope, cannot send reply");
-      }
-      iot_data_free (renv);
+      r->match.start[i] = copy + (match.start[i] - path);
+      r->match.len[i] = match.len[i];
     }
-    if (crl)
+    if (edgex_cmdq_push (bus->cmdq, r->match.start[ep->devparam], r->match.len[ep->devparam], edgex_bus_run_request, r))
     {
-      edgex_device_free_crlid ();
+      return;
     }
-    iot_data_free (req);
-    iot_data_free (envdata);
+    free (r);
   }
-  iot_data_free (pathparams);
+  edgex_bus_dispatch (bus, ep, &match, envelope, len, false);
 }
 
 
+
 char *edgex_bus_mktopic (edgex_bus_t *bus, const char *type, const char *param)
 {
   char *result;
@@ -316,6 +506,10 @@ void edgex_bus_init (edgex_bus_t *bus, const char *svcname, const iot_data_t *cf
   bus->prefix = strdup (iot_data_string_map_get_string (cfg, EX_BUS_TOPIC));
   bus->svcname = strdup (svcname);
   bus->handlers = iot_data_alloc_list ();
+  atomic_init (&bus->trie, NULL);
+  bus->takefn = NULL;
+  bus->statsfn = NULL;
+  bus->cmdq = NULL;
   pthread_mutex_init (&bus->mtx, NULL);
   bus->msgb64payload = false;
   const char *msgb64payload = getenv("EDGEX_MSG_BASE64_PAYLOAD");
@@ -338,50 +532,71 @@ void edgex_bus_free (edgex_bus_t *bus)
     bus->freefn (bus->ctx);
     free (bus->prefix);
     free (bus->svcname);
+    edgex_bus_trie_free (atomic_load (&bus->trie));
     iot_data_free (bus->handlers);
     pthread_mutex_destroy (&bus->mtx);
     free (bus);
   }
 }
 
+void edgex_bus_set_cmdq (edgex_bus_t *bus, edgex_cmdq_t *cmdq)
+{
+  bus->cmdq = cmdq;
+}
+
 void edgex_bus_register_handler (edgex_bus_t *bus, const char *path, void *ctx, edgex_handler_fn handler)
 {
   char *sub;
-  edgex_bus_endpoint_t *entry = malloc (sizeof (edgex_bus_endpoint_t));
-  entry->ignore_tail = false;
-  entry->params = iot_data_alloc_list ();
+  edgex_bus_endpoint_t *entry = calloc (1, sizeof (edgex_bus_endpoint_t));
   const char *param = strchr (path, '{');
   if (param)
   {
     size_t plen = param - path;
-    entry->base = strndup (path, plen);
-    entry->base_len = plen;
     sub = strndup (path, plen + 1);
     sub[plen] = '#';
     while (param)
     {
       char *end = strchr (param, '}');
-      iot_data_list_tail_push (entry->params, iot_data_alloc_string (strndup (param + 1, end - param - 1), IOT_DATA_TAKE));
+      if (entry->nparams == EDGEX_BUS_MAXPARAMS)
+      {
+        iot_log_error (iot_logger_default (), "edgex_bus_register_handler: too many parameters in %s", path);
+        free (entry);
+        free (sub);
+        return;
+      }
+      entry->keys[entry->nparams++] = iot_data_alloc_string (strndup (param + 1, end - param - 1), IOT_DATA_TAKE);
       param = strchr (end, '{');
     }
   }
   else
   {
-    size_t path_len = strlen (path);
-    if (path_len >= 2 && strcmp (path + path_len - 2, "/#") == 0)
+    sub = strdup (path);
+  }
+  entry->devparam = -1;
+  for (unsigned i = 0; i < entry->nparams; i++)
+  {
+    if (strcmp (iot_data_string (entry->keys[i]), "device") == 0)
     {
-      path_len -= 2;
-      entry->ignore_tail = true;
+      entry->devparam = i;
     }
-    sub = strdup (path);
-    entry->base = strdup (path);
-    entry->base_len = path_len;
   }
+  entry->path = strdup (path);
   entry->handler = handler;
   entry->ctx = ctx;
+
   pthread_mutex_lock (&bus->mtx);
   iot_data_list_head_push (bus->handlers, iot_data_alloc_pointer (entry, edgex_bus_endpoint_free));
+  edgex_bus_trie_t *trie = calloc (1, sizeof (edgex_bus_trie_t));
+  iot_data_list_iter_t iter;
+  iot_data_list_iter (bus->handlers, &iter);
+  while (iot_data_list_iter_next (&iter))
+  {
+    edgex_bus_trie_insert (trie, iot_data_address (iot_data_list_iter_value (&iter)));
+  }
+  trie->retired = atomic_load_explicit (&bus->trie, memory_order_relaxed);
+  atomic_store_explicit (&bus->trie, trie, memory_order_release);
   pthread_mutex_unlock (&bus->mtx);
+
   bus->subsfn (bus->ctx, sub);
   free (sub);
 }
@@ -403,6 +618,23 @@ void edgex_bus_config_defaults (iot_data_t *allconf, const char *svcname)
   iot_data_string_map_add (allconf, EX_BUS_CERTFILE, iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (allconf, EX_BUS_KEYFILE, iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (allconf, EX_BUS_SKIPVERIFY, iot_data_alloc_bool (false));
+  iot_data_string_map_add (allconf, EX_BUS_MAXINFLIGHT, iot_data_alloc_ui32 (1000));
+  iot_data_string_map_add (allconf, EX_BUS_MAXBUFFERED, iot_data_alloc_ui32 (10000));
+  iot_data_string_map_add (allconf, EX_BUS_PUBTIMEOUT, iot_data_alloc_ui32 (5000));
+  iot_data_string_map_add (allconf, EX_BUS_SPOOLDIR, iot_data_alloc_string ("", IOT_DATA_REF));
+  iot_data_string_map_add (allconf, EX_BUS_SPOOLSEGSIZE, iot_data_alloc_ui32 (4 * 1024 * 1024));
+  iot_data_string_map_add (allconf, EX_BUS_SPOOLMAXSIZE, iot_data_alloc_ui64 (256 * 1024 * 1024));
+  iot_data_string_map_add (allconf, EX_BUS_SPOOLOVERFLOW, iot_data_alloc_string ("DropOldest", IOT_DATA_REF));
+  iot_data_string_map_add (allconf, EX_BUS_SPOOLRATE, iot_data_alloc_ui32 (100));
+  iot_data_string_map_add (allconf, EX_BUS_MQTTVERSION, iot_data_alloc_ui16 (3));
+  iot_data_string_map_add (allconf, EX_BUS_TOPICALIASES, iot_data_alloc_ui16 (100));
+  iot_data_string_map_add (allconf, EX_BUS_PUBLISHERS, iot_data_alloc_ui16 (1));
+  iot_data_string_map_add (allconf, EX_BUS_QUEUELENGTH, iot_data_alloc_ui32 (1024));
+  char *shmpath = malloc (strlen (svcname) + sizeof ("/dev/shm/edgex-"));
+  strcpy (shmpath, "/dev/shm/edgex-");
+  strcat (shmpath, svcname);
+  iot_data_string_map_add (allconf, EX_BUS_SHMPATH, iot_data_alloc_string (shmpath, IOT_DATA_TAKE));
+  iot_data_string_map_add (allconf, EX_BUS_SHMSIZE, iot_data_alloc_ui32 (16 * 1024 * 1024));
 }
 
 JSON_Value *edgex_bus_config_json (const iot_data_t *allconf)
@@ -425,6 +657,20 @@ JSON_Value *edgex_bus_config_json (const iot_data_t *allconf)
   json_object_set_string (optobj, "CertFile", iot_data_string_map_get_string (allconf, EX_BUS_CERTFILE));
   json_object_set_string (optobj, "KeyFile", iot_data_string_map_get_string (allconf, EX_BUS_KEYFILE));
   json_object_set_boolean (optobj, "SkipCertVerify", iot_data_bool (iot_data_string_map_get (allconf, EX_BUS_SKIPVERIFY)));
+  json_object_set_uint (optobj, "MaxInFlight", iot_data_ui32 (iot_data_string_map_get (allconf, EX_BUS_MAXINFLIGHT)));
+  json_object_set_uint (optobj, "MaxBuffered", iot_data_ui32 (iot_data_string_map_get (allconf, EX_BUS_MAXBUFFERED)));
+  json_object_set_uint (optobj, "PublishTimeout", iot_data_ui32 (iot_data_string_map_get (allconf, EX_BUS_PUBTIMEOUT)));
+  json_object_set_string (optobj, "SpoolDir", iot_data_string_map_get_string (allconf, EX_BUS_SPOOLDIR));
+  json_object_set_uint (optobj, "SpoolSegmentSize", iot_data_ui32 (iot_data_string_map_get (allconf, EX_BUS_SPOOLSEGSIZE)));
+  json_object_set_uint (optobj, "SpoolMaxSize", iot_data_ui64 (iot_data_string_map_get (allconf, EX_BUS_SPOOLMAXSIZE)));
+  json_object_set_string (optobj, "SpoolOverflow", iot_data_string_map_get_string (allconf, EX_BUS_SPOOLOVERFLOW));
+  json_object_set_uint (optobj, "SpoolReplayRate", iot_data_ui32 (iot_data_string_map_get (allconf, EX_BUS_SPOOLRATE)));
+  json_object_set_uint (optobj, "MqttVersion", iot_data_ui16 (iot_data_string_map_get (allconf, EX_BUS_MQTTVERSION)));
+  json_object_set_uint (optobj, "TopicAliasMaximum", iot_data_ui16 (iot_data_string_map_get (allconf, EX_BUS_TOPICALIASES)));
+  json_object_set_uint (optobj, "PublisherConnections", iot_data_ui16 (iot_data_string_map_get (allconf, EX_BUS_PUBLISHERS)));
+  json_object_set_uint (optobj, "QueueLength", iot_data_ui32 (iot_data_string_map_get (allconf, EX_BUS_QUEUELENGTH)));
+  json_object_set_string (optobj, "ShmPath", iot_data_string_map_get_string (allconf, EX_BUS_SHMPATH));
+  json_object_set_uint (optobj, "ShmSize", iot_data_ui32 (iot_data_string_map_get (allconf, EX_BUS_SHMSIZE)));
   json_object_set_value (busobj, "Optional", optval);
 
   return busval;
@@ -14,6 +14,7 @@
 #include "parson.h"
 #include "secrets.h"
 #include "devutil.h"
+#include "cmdq.h"
 #include <iot/threadpool.h>
 
 #define EX_BUS_TYPE "MessageBus/Type"
@@ -31,9 +32,41 @@
 #define EX_BUS_KEYFILE "MessageBus/Optional/KeyFile"
 #define EX_BUS_SKIPVERIFY "MessageBus/Optional/SkipCertVerify"
 #define EX_BUS_TOPIC "MessageBus/BaseTopicPrefix"
+#define EX_BUS_QUEUELENGTH "MessageBus/Optional/QueueLength"
+#define EX_BUS_SHMPATH "MessageBus/Optional/ShmPath"
+#define EX_BUS_SHMSIZE "MessageBus/Optional/ShmSize"
+#define EX_BUS_MAXINFLIGHT "MessageBus/Optional/MaxInFlight"
+#define EX_BUS_MAXBUFFERED "MessageBus/Optional/MaxBuffered"
+#define EX_BUS_PUBTIMEOUT "MessageBus/Optional/PublishTimeout"
+#define EX_BUS_SPOOLDIR "MessageBus/Optional/SpoolDir"
+#define EX_BUS_SPOOLSEGSIZE "MessageBus/Optional/SpoolSegmentSize"
+#define EX_BUS_SPOOLMAXSIZE "MessageBus/Optional/SpoolMaxSize"
+#define EX_BUS_SPOOLOVERFLOW "MessageBus/Optional/SpoolOverflow"
+#define EX_BUS_SPOOLRATE "MessageBus/Optional/SpoolReplayRate"
+#define EX_BUS_MQTTVERSION "MessageBus/Optional/MqttVersion"
+#define EX_BUS_TOPICALIASES "MessageBus/Optional/TopicAliasMaximum"
+#define EX_BUS_PUBLISHERS "MessageBus/Optional/PublisherConnections"
 
 typedef struct edgex_bus_t edgex_bus_t;
 
+/* Payloads, both posted and returned by handlers, may be pre-encoded and
+   passed as IOT_DATA_BINARY. They must then be CBOR-encoded if either
+   event_is_cbor or edgex_bus_cbor is set, otherwise JSON-encoded. */
+
+/* Per-message publish options, where the bus supports them. Negative values
+   select the bus-wide setting. Messages with the same key are published in
+   order; messages with different keys may be published concurrently. The
+   alias flag marks a topic which is published repeatedly, and so is worth
+   a topic alias. */
+
+typedef struct edgex_bus_pubopts
+{
+  int8_t qos;
+  int8_t retained;
+  const char *key;
+  bool alias;
+} edgex_bus_pubopts;
+
 typedef int32_t (*edgex_handler_fn) (void *ctx, const iot_data_t *request, const iot_data_t *pathparams, const iot_data_t *params, iot_data_t **reply, bool *event_is_cbor);
 
 void edgex_bus_config_defaults (iot_data_t *allconf, const char *svcname);
@@ -42,11 +75,36 @@ JSON_Value *edgex_bus_config_json (const iot_data_t *allconf);
 edgex_bus_t *edgex_bus_create_mqtt
   (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg, edgex_secret_provider_t *secstore, iot_threadpool_t *queue, const devsdk_timeout *tm);
 
+/* Run handlers on the command queue's workers, keyed by the {device} topic
+   parameter where there is one. Requests without one share a single lane. */
+edgex_bus_t *edgex_bus_create_local (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg, devsdk_bus_sink sink, void *sinkctx);
+
+edgex_bus_t *edgex_bus_create_shm (iot_logger_t *lc, const char *svcname, const iot_data_t *cfg);
+
+/* Queue a request for the service's handlers. Returns false if the bus is
+   not a local bus. */
+bool edgex_bus_local_inject (edgex_bus_t *bus, const char *topic, const void *envelope, size_t len);
+
+void edgex_bus_set_cmdq (edgex_bus_t *bus, edgex_cmdq_t *cmdq);
+
 void edgex_bus_register_handler (edgex_bus_t *bus, const char *path, void *ctx, edgex_handler_fn handler);
 char *edgex_bus_mktopic (edgex_bus_t *bus, const char *type, const char *param);
 void edgex_bus_post (edgex_bus_t *bus, const char *path, const iot_data_t *payload, bool event_is_cbor);
+void edgex_bus_post_opts (edgex_bus_t *bus, const char *path, const iot_data_t *payload, bool event_is_cbor, const edgex_bus_pubopts *opts);
+bool edgex_bus_cbor (const edgex_bus_t *bus);
 int edgex_bus_rmi (edgex_bus_t *bus, const char *path, const char *svcname, const iot_data_t *request, iot_data_t **reply);
 
+/* Publish accounting, for buses which bound their outstanding messages */
+typedef struct edgex_bus_stats
+{
+  uint64_t inflight;
+  uint64_t buffered;
+  uint64_t failed;
+  uint64_t spooled;
+} edgex_bus_stats;
+
+void edgex_bus_get_stats (edgex_bus_t *bus, edgex_bus_stats *stats);
+
 void edgex_bus_free (edgex_bus_t *bus);
 
 #endif
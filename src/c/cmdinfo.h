@@ -11,6 +11,7 @@
 
 #include "edgex/edgex.h"
 #include "devsdk/devsdk.h"
+#include "transform.h"
 
 typedef struct edgex_cmdinfo
 {
@@ -20,9 +21,12 @@ typedef struct edgex_cmdinfo
   unsigned nreqs;
   devsdk_commandrequest *reqs;
   edgex_propertyvalue **pvals;
+  edgex_transform *xforms;
   iot_data_t **maps;
   iot_data_t *tags;
   char **dfls;
+  int8_t qos;
+  int8_t retained;
   struct edgex_cmdinfo *next;
 } edgex_cmdinfo;
 
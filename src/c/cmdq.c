@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "cmdq.h"
+#include <iot/time.h>
+
+#define EDGEX_CMDQ_BUCKETS 64
+
+/* Number of requests a worker runs from one lane before requeueing it, so
+   that a busy lane does not monopolize a worker */
+
+#define EDGEX_CMDQ_BATCH 16
+
+typedef struct edgex_cmdq_job
+{
+  edgex_cmdq_fn fn;
+  void *arg;
+  uint64_t queued;
+  struct edgex_cmdq_job *next;
+} edgex_cmdq_job;
+
+typedef struct edgex_cmdq_lane
+{
+  edgex_cmdq_t *q;
+  char *key;
+  uint32_t hash;
+  edgex_cmdq_job *head;
+  edgex_cmdq_job *tail;
+  struct edgex_cmdq_lane *next;
+} edgex_cmdq_lane;
+
+struct edgex_cmdq_t
+{
+  iot_logger_t *lc;
+  devsdk_metrics_t *metrics;
+  iot_threadpool_t *pool;
+  edgex_cmdq_lane *lanes[EDGEX_CMDQ_BUCKETS];
+  uint32_t count;
+  uint32_t maxlen;
+  uint32_t active;
+  bool running;
+  pthread_mutex_t mtx;
+  pthread_cond_t notfull;
+  pthread_cond_t idle;
+};
+
+static uint32_t edgex_cmdq_hash (const char *key, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+  {
+    h = (h ^ (uint8_t)key[i]) * 16777619u;
+  }
+  return h;
+}
+
+edgex_cmdq_t *edgex_cmdq_alloc (iot_logger_t *lc, devsdk_metrics_t *metrics, uint32_t maxlen)
+{
+  edgex_cmdq_t *q = calloc (1, sizeof (edgex_cmdq_t));
+  q->lc = lc;
+  q->metrics = metrics;
+  q->maxlen = maxlen;
+  pthread_mutex_init (&q->mtx, NULL);
+  pthread_cond_init (&q->notfull, NULL);
+  pthread_cond_init (&q->idle, NULL);
+  return q;
+}
+
+void edgex_cmdq_start (edgex_cmdq_t *q, iot_threadpool_t *pool)
+{
+  pthread_mutex_lock (&q->mtx);
+  q->pool = pool;
+  q->running = true;
+  pthread_mutex_unlock (&q->mtx);
+}
+
+static void edgex_cmdq_record_wait (edgex_cmdq_t *q, uint64_t wait)
+{
+  uint64_t max = atomic_load (&q->metrics->cmdqwaitmax);
+  while (wait > max && !atomic_compare_exchange_weak (&q->metrics->cmdqwaitmax, &max, wait));
+  atomic_fetch_add (&q->metrics->cmdqwaitsum, wait);
+  atomic_fetch_add (&q->metrics->cmdqwaitcount, 1);
+}
+
+/* Called with the mutex held, when a lane has been emptied */
+
+static void edgex_cmdq_lane_remove (edgex_cmdq_t *q, edgex_cmdq_lane *lane)
+{
+  edgex_cmdq_lane **prev = &q->lanes[lane->hash % EDGEX_CMDQ_BUCKETS];
+  while (*prev != lane)
+  {
+    prev = &(*prev)->next;
+  }
+  *prev = lane->next;
+  free (lane->key);
+  free (lane);
+  if (--q->active == 0)
+  {
+    pthread_cond_broadcast (&q->idle);
+  }
+}
+
+static void *edgex_cmdq_run_lane (void *p)
+{
+  edgex_cmdq_lane *lane = (edgex_cmdq_lane *)p;
+  edgex_cmdq_t *q = lane->q;
+
+  for (unsigned n = 0; n < EDGEX_CMDQ_BATCH; n++)
+  {
+    pthread_mutex_lock (&q->mtx);
+    edgex_cmdq_job *job = lane->head;
+    if (job == NULL)
+    {
+      edgex_cmdq_lane_remove (q, lane);
+      pthread_mutex_unlock (&q->mtx);
+      return NULL;
+    }
+    lane->head = job->next;
+    q->count--;
+    pthread_cond_signal (&q->notfull);
+    pthread_mutex_unlock (&q->mtx);
+
+    edgex_cmdq_record_wait (q, iot_time_nsecs () - job->queued);
+    job->fn (job->arg);
+    free (job);
+  }
+
+  // Batch complete: go to the back of the pool's queue if there is more to do
+
+  pthread_mutex_lock (&q->mtx);
+  if (lane->head == NULL)
+  {
+    edgex_cmdq_lane_remove (q, lane);
+    lane = NULL;
+  }
+  pthread_mutex_unlock (&q->mtx);
+  if (lane)
+  {
+    iot_threadpool_add_work (q->pool, edgex_cmdq_run_lane, lane, IOT_THREAD_NO_PRIORITY);
+  }
+  return NULL;
+}
+
+bool edgex_cmdq_push (edgex_cmdq_t *q, const char *key, size_t keylen, edgex_cmdq_fn fn, void *arg)
+{
+  uint32_t hash = edgex_cmdq_hash (key, keylen);
+  edgex_cmdq_job *job = malloc (sizeof (edgex_cmdq_job));
+  job->fn = fn;
+  job->arg = arg;
+  job->next = NULL;
+  job->queued = iot_time_nsecs ();
+
+  pthread_mutex_lock (&q->mtx);
+  while (q->running && q->maxlen && q->count >= q->maxlen)
+  {
+    pthread_cond_wait (&q->notfull, &q->mtx);
+  }
+  if (!q->running)
+  {
+    pthread_mutex_unlock (&q->mtx);
+    free (job);
+    return false;
+  }
+
+  edgex_cmdq_lane *lane;
+  for (lane = q->lanes[hash % EDGEX_CMDQ_BUCKETS]; lane; lane = lane->next)
+  {
+    if (lane->hash == hash && strncmp (lane->key, key, keylen) == 0 && lane->key[keylen] == '\0')
+    {
+      break;
+    }
+  }
+  q->count++;
+  if (lane)
+  {
+    // The lane is being run by a worker, which will pick this job up
+    if (lane->head)
+    {
+      lane->tail->next = job;
+    }
+    else
+    {
+      lane->head = job;
+    }
+    lane->tail = job;
+    pthread_mutex_unlock (&q->mtx);
+    return true;
+  }
+
+  lane = malloc (sizeof (edgex_cmdq_lane));
+  lane->q = q;
+  lane->key = strndup (key, keylen);
+  lane->hash = hash;
+  lane->head = lane->tail = job;
+  lane->next = q->lanes[hash % EDGEX_CMDQ_BUCKETS];
+  q->lanes[hash % EDGEX_CMDQ_BUCKETS] = lane;
+  q->active++;
+  pthread_mutex_unlock (&q->mtx);
+
+  iot_threadpool_add_work (q->pool, edgex_cmdq_run_lane, lane, IOT_THREAD_NO_PRIORITY);
+  return true;
+}
+
+uint32_t edgex_cmdq_depth (edgex_cmdq_t *q)
+{
+  pthread_mutex_lock (&q->mtx);
+  uint32_t result = q->count;
+  pthread_mutex_unlock (&q->mtx);
+  return result;
+}
+
+void edgex_cmdq_stop (edgex_cmdq_t *q)
+{
+  pthread_mutex_lock (&q->mtx);
+  q->running = false;
+  pthread_cond_broadcast (&q->notfull);
+  while (q->active)
+  {
+    pthread_cond_wait (&q->idle, &q->mtx);
+  }
+  pthread_mutex_unlock (&q->mtx);
+}
+
+void edgex_cmdq_free (edgex_cmdq_t *q)
+{
+  if (q)
+  {
+    edgex_cmdq_stop (q);
+    pthread_cond_destroy (&q->idle);
+    pthread_cond_destroy (&q->notfull);
+    pthread_mutex_destroy (&q->mtx);
+    free (q);
+  }
+}
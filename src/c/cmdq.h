@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_CMDQ_H_
+#define _EDGEX_CMDQ_H_ 1
+
+#include "metrics.h"
+#include <iot/logger.h>
+#include <iot/threadpool.h>
+
+/* Queue of inbound requests awaiting execution on a worker pool. Requests
+ * are placed in lanes according to a key (normally a device name): each
+ * lane is run by at most one worker at a time, so requests with the same
+ * key execute in the order received, while different keys run in parallel.
+ */
+
+typedef struct edgex_cmdq_t edgex_cmdq_t;
+
+typedef void (*edgex_cmdq_fn) (void *arg);
+
+/* maxlen of zero means unbounded, otherwise callers wait for space */
+edgex_cmdq_t *edgex_cmdq_alloc (iot_logger_t *lc, devsdk_metrics_t *metrics, uint32_t maxlen);
+
+void edgex_cmdq_start (edgex_cmdq_t *q, iot_threadpool_t *pool);
+
+/* Queues fn (arg) in the lane for the given key. Returns false if the queue
+   is not running, in which case the caller should run the request itself. */
+bool edgex_cmdq_push (edgex_cmdq_t *q, const char *key, size_t keylen, edgex_cmdq_fn fn, void *arg);
+
+uint32_t edgex_cmdq_depth (edgex_cmdq_t *q);
+
+/* Runs any queued requests, then stops accepting new ones */
+void edgex_cmdq_stop (edgex_cmdq_t *q);
+
+void edgex_cmdq_free (edgex_cmdq_t *q);
+
+#endif
@@ -75,6 +75,10 @@ iot_data_t *edgex_common_config_defaults (const char *svcname)
   iot_data_string_map_add (result, "Service/HealthCheckInterval", iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (result, "Service/ServerBindAddr", iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (result, "Service/MaxRequestSize", iot_data_alloc_ui64 (0));
+  iot_data_string_map_add (result, "Service/HttpThreads", iot_data_alloc_ui16 (0));
+  iot_data_string_map_add (result, "Service/HttpWorkers", iot_data_alloc_ui16 (8));
+  iot_data_string_map_add (result, "Service/MaxConnections", iot_data_alloc_ui32 (0));
+  iot_data_string_map_add (result, "Service/ConnectionTimeout", iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (result, "Service/CORSConfiguration/EnableCORS", iot_data_alloc_bool (false));
   iot_data_string_map_add (result, "Service/CORSConfiguration/CORSAllowCredentials", iot_data_alloc_bool (false));
   iot_data_string_map_add (result, "Service/CORSConfiguration/CORSAllowedOrigin", iot_data_alloc_string ("https://localhost", IOT_DATA_REF));
@@ -87,7 +91,13 @@ iot_data_t *edgex_common_config_defaults (const char *svcname)
   iot_data_string_map_add (result, "Device/ProfilesDir", iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (result, "Device/DevicesDir", iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (result, "Device/ProvisionWatchersDir", iot_data_alloc_string ("", IOT_DATA_REF));
-  iot_data_string_map_add (result, "Device/EventQLength", iot_data_alloc_ui32 (0));
+  iot_data_string_map_add (result, "Device/LastConnectedInterval", iot_data_alloc_string ("5s", IOT_DATA_REF));
+  iot_data_string_map_add (result, "Device/AutoEventSpread", iot_data_alloc_bool (true));
+  iot_data_string_map_add (result, "Device/AutoEventJitter", iot_data_alloc_string ("", IOT_DATA_REF));
+  iot_data_string_map_add (result, "Device/EventQLength", iot_data_alloc_ui32 (1024));
+  iot_data_string_map_add (result, "Device/EventQOverflow", iot_data_alloc_string ("Block", IOT_DATA_REF));
+  iot_data_string_map_add (result, "Device/CommandWorkers", iot_data_alloc_ui16 (4));
+  iot_data_string_map_add (result, "Device/CommandQLength", iot_data_alloc_ui32 (0));
   iot_data_string_map_add (result, "Device/AllowedFails", iot_data_alloc_i32 (0));
   iot_data_string_map_add (result, "Device/DeviceDownTimeout", iot_data_alloc_ui64 (0));
 
@@ -105,6 +115,13 @@ iot_data_t *edgex_common_config_defaults (const char *svcname)
   iot_data_string_map_add (result, "SecretStore/Authentication/AuthType", iot_data_alloc_string ("X-Vault-Token", IOT_DATA_REF));
   iot_data_string_map_add (result, "SecretStore/SecretsFile", iot_data_alloc_string ("", IOT_DATA_REF));
   iot_data_string_map_add (result, "SecretStore/DisableScrubSecretsFile", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, "SecretStore/JWTCacheSize", iot_data_alloc_ui32 (1024));
+  iot_data_string_map_add (result, "SecretStore/JWTCacheTTL", iot_data_alloc_string ("60s", IOT_DATA_REF));
+  iot_data_string_map_add (result, "SecretStore/JWTNegativeCacheTTL", iot_data_alloc_string ("5s", IOT_DATA_REF));
+  iot_data_string_map_add (result, "SecretStore/JWTVerifyLocally", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, "SecretStore/JWKSUrl", iot_data_alloc_string ("", IOT_DATA_REF));
+  iot_data_string_map_add (result, "SecretStore/JWKSRefreshInterval", iot_data_alloc_string ("1h", IOT_DATA_REF));
+  iot_data_string_map_add (result, "SecretStore/JWTAudience", iot_data_alloc_string ("", IOT_DATA_REF));
 
   return result;
 }
@@ -122,6 +139,17 @@ iot_data_t *edgex_private_config_defaults (const iot_data_t *driverconf)
 
   iot_data_string_map_add (result, DYN_PREFIX "Telemetry/PublishTopicPrefix", iot_data_alloc_string (DEFAULTMETRICSTOPIC, IOT_DATA_REF));
   iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/ReadCommandsExecuted", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/EventQueueDepth", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/EventQueueDropped", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/EventQueueLatency", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/AutoEventOverruns", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/AutoEventExecutionTime", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/CommandQueueDepth", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/CommandQueueWait", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/MessageBusInFlight", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/MessageBusBuffered", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/MessageBusFailed", iot_data_alloc_bool (false));
+  iot_data_string_map_add (result, DYN_PREFIX "Telemetry/Metrics/MessageBusSpooled", iot_data_alloc_bool (false));
 
   iot_data_string_map_add (result, "Service/Host", iot_data_alloc_string (utsbuffer.nodename, IOT_DATA_COPY));
   iot_data_string_map_add (result, "Service/Port", iot_data_alloc_ui16 (59999));
@@ -477,6 +505,10 @@ static void edgex_device_populateCommonConfigFromMap (edgex_device_config *confi
   config->service.checkinterval = iot_data_string_map_get_string (map, "Service/HealthCheckInterval");
   config->service.bindaddr = iot_data_string_map_get_string (map, "Service/ServerBindAddr");
   config->service.maxreqsz = iot_data_ui64 (iot_data_string_map_get (map, "Service/MaxRequestSize"));
+  config->service.httpthreads = iot_data_ui16 (iot_data_string_map_get (map, "Service/HttpThreads"));
+  config->service.httpworkers = iot_data_ui16 (iot_data_string_map_get (map, "Service/HttpWorkers"));
+  config->service.maxconns = iot_data_ui32 (iot_data_string_map_get (map, "Service/MaxConnections"));
+  config->service.conntimeout = edgex_parsetime (iot_data_string_map_get_string (map, "Service/ConnectionTimeout"));
 
   if (config->service.labels)
   {
@@ -529,10 +561,27 @@ static void edgex_device_populateConfigFromMap (edgex_device_config *config, con
   config->service.startupmsg = iot_data_string_map_get_string (map, "Service/StartupMsg");
 
   config->device.updatelastconnected = iot_data_bool (iot_data_string_map_get (map, "Device/UpdateLastConnected"));
+  config->device.lcinterval = iot_data_string_map_get_string (map, "Device/LastConnectedInterval");
+  config->device.aespread = iot_data_bool (iot_data_string_map_get (map, "Device/AutoEventSpread"));
+  config->device.aejitter = iot_data_string_map_get_string (map, "Device/AutoEventJitter");
   config->device.eventqlen = iot_data_ui32 (iot_data_string_map_get (map, "Device/EventQLength"));
+  config->device.eventqpolicy = iot_data_string_map_get_string (map, "Device/EventQOverflow");
+  config->device.cmdworkers = iot_data_ui16 (iot_data_string_map_get (map, "Device/CommandWorkers"));
+  config->device.cmdqlen = iot_data_ui32 (iot_data_string_map_get (map, "Device/CommandQLength"));
 
   config->metrics.topic = iot_data_string_map_get_string (map, DYN_PREFIX "Telemetry/PublishTopicPrefix");
   if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/ReadCommandsExecuted"))) config->metrics.flags |= EX_METRIC_RDCMDS;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/EventQueueDepth"))) config->metrics.flags |= EX_METRIC_EVQDEPTH;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/EventQueueDropped"))) config->metrics.flags |= EX_METRIC_EVQDROP;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/EventQueueLatency"))) config->metrics.flags |= EX_METRIC_EVQLAT;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/AutoEventOverruns"))) config->metrics.flags |= EX_METRIC_AEOVERRUN;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/AutoEventExecutionTime"))) config->metrics.flags |= EX_METRIC_AEEXEC;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/CommandQueueDepth"))) config->metrics.flags |= EX_METRIC_CMDQDEPTH;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/CommandQueueWait"))) config->metrics.flags |= EX_METRIC_CMDQWAIT;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/MessageBusInFlight"))) config->metrics.flags |= EX_METRIC_BUSINFLIGHT;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/MessageBusBuffered"))) config->metrics.flags |= EX_METRIC_BUSBUFFERED;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/MessageBusFailed"))) config->metrics.flags |= EX_METRIC_BUSFAILED;
+  if (iot_data_bool (iot_data_string_map_get (map, DYN_PREFIX "Telemetry/Metrics/MessageBusSpooled"))) config->metrics.flags |= EX_METRIC_BUSSPOOLED;
 }
 
 void edgex_device_populateConfig (devsdk_service_t *svc, iot_data_t *config)
@@ -741,7 +790,13 @@ static JSON_Value *edgex_device_config_toJson (devsdk_service_t *svc)
   json_object_set_string (dobj, "ProvisionWatchersDir", svc->config.device.provisionwatchersdir);
   json_object_set_boolean
     (dobj, "UpdateLastConnected", svc->config.device.updatelastconnected);
+  json_object_set_string (dobj, "LastConnectedInterval", svc->config.device.lcinterval);
+  json_object_set_boolean (dobj, "AutoEventSpread", svc->config.device.aespread);
+  json_object_set_string (dobj, "AutoEventJitter", svc->config.device.aejitter);
   json_object_set_uint (dobj, "EventQLength", svc->config.device.eventqlen);
+  json_object_set_string (dobj, "EventQOverflow", svc->config.device.eventqpolicy);
+  json_object_set_uint (dobj, "CommandWorkers", svc->config.device.cmdworkers);
+  json_object_set_uint (dobj, "CommandQLength", svc->config.device.cmdqlen);
   json_object_set_uint (dobj, "AllowedFails", svc->config.device.allowed_fails);
   json_object_set_uint (dobj, "DeviceDownTimeout", svc->config.device.dev_downtime);
 
@@ -781,6 +836,17 @@ static JSON_Value *edgex_device_config_toJson (devsdk_service_t *svc)
   json_object_set_boolean (mobj, "ReadCommandsExecuted", svc->config.metrics.flags & EX_METRIC_RDCMDS);
   json_object_set_boolean (mobj, "SecuritySecretsRequested", svc->config.metrics.flags & EX_METRIC_SECREQ);
   json_object_set_boolean (mobj, "SecuritySecretsStored", svc->config.metrics.flags & EX_METRIC_SECSTO);
+  json_object_set_boolean (mobj, "EventQueueDepth", svc->config.metrics.flags & EX_METRIC_EVQDEPTH);
+  json_object_set_boolean (mobj, "EventQueueDropped", svc->config.metrics.flags & EX_METRIC_EVQDROP);
+  json_object_set_boolean (mobj, "EventQueueLatency", svc->config.metrics.flags & EX_METRIC_EVQLAT);
+  json_object_set_boolean (mobj, "AutoEventOverruns", svc->config.metrics.flags & EX_METRIC_AEOVERRUN);
+  json_object_set_boolean (mobj, "AutoEventExecutionTime", svc->config.metrics.flags & EX_METRIC_AEEXEC);
+  json_object_set_boolean (mobj, "CommandQueueDepth", svc->config.metrics.flags & EX_METRIC_CMDQDEPTH);
+  json_object_set_boolean (mobj, "CommandQueueWait", svc->config.metrics.flags & EX_METRIC_CMDQWAIT);
+  json_object_set_boolean (mobj, "MessageBusInFlight", svc->config.metrics.flags & EX_METRIC_BUSINFLIGHT);
+  json_object_set_boolean (mobj, "MessageBusBuffered", svc->config.metrics.flags & EX_METRIC_BUSBUFFERED);
+  json_object_set_boolean (mobj, "MessageBusFailed", svc->config.metrics.flags & EX_METRIC_BUSFAILED);
+  json_object_set_boolean (mobj, "MessageBusSpooled", svc->config.metrics.flags & EX_METRIC_BUSSPOOLED);
   json_object_set_value (obj, "Telemetry", mval);
 
   JSON_Value *sval = json_value_init_object ();
@@ -794,6 +860,10 @@ static JSON_Value *edgex_device_config_toJson (devsdk_service_t *svc)
     (sobj, "HealthCheckInterval", svc->config.service.checkinterval);
   json_object_set_string (sobj, "ServerBindAddr", svc->config.service.bindaddr);
   json_object_set_uint (sobj, "MaxRequestSize", svc->config.service.maxreqsz);
+  json_object_set_uint (sobj, "HttpThreads", svc->config.service.httpthreads);
+  json_object_set_uint (sobj, "HttpWorkers", svc->config.service.httpworkers);
+  json_object_set_uint (sobj, "MaxConnections", svc->config.service.maxconns);
+  json_object_set_string (sobj, "ConnectionTimeout", iot_data_string_map_get_string (svc->config.sdkconf, "Service/ConnectionTimeout"));
 
   JSON_Value *scval = json_value_init_object ();
   JSON_Object *scobj = json_value_get_object (scval);
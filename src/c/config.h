@@ -19,6 +19,17 @@
 #define EX_METRIC_RDCMDS 0x4
 #define EX_METRIC_SECREQ 0x8
 #define EX_METRIC_SECSTO 0x10
+#define EX_METRIC_EVQDEPTH 0x20
+#define EX_METRIC_EVQDROP 0x40
+#define EX_METRIC_EVQLAT 0x80
+#define EX_METRIC_AEOVERRUN 0x100
+#define EX_METRIC_AEEXEC 0x200
+#define EX_METRIC_CMDQDEPTH 0x400
+#define EX_METRIC_CMDQWAIT 0x800
+#define EX_METRIC_BUSINFLIGHT 0x1000
+#define EX_METRIC_BUSBUFFERED 0x2000
+#define EX_METRIC_BUSFAILED 0x4000
+#define EX_METRIC_BUSSPOOLED 0x8000
 
 typedef struct edgex_device_serviceinfo
 {
@@ -30,6 +41,10 @@ typedef struct edgex_device_serviceinfo
   const char *checkinterval;
   const char *bindaddr;
   uint64_t maxreqsz;
+  uint16_t httpthreads;
+  uint16_t httpworkers;
+  uint32_t maxconns;
+  uint64_t conntimeout;
 } edgex_device_serviceinfo;
 
 typedef struct edgex_device_service_endpoint
@@ -61,7 +76,13 @@ typedef struct edgex_device_deviceinfo
   const char *devicesdir;
   const char *provisionwatchersdir;
   atomic_bool updatelastconnected;
+  const char *lcinterval;
+  bool aespread;
+  const char *aejitter;
   uint32_t eventqlen;
+  const char *eventqpolicy;
+  uint16_t cmdworkers;
+  uint32_t cmdqlen;
   uint32_t allowed_fails;
   uint64_t dev_downtime;
 } edgex_device_deviceinfo;
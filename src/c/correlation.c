@@ -9,17 +9,80 @@
 #include "correlation.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/random.h>
 #include <uuid/uuid.h>
 
+/* Random bytes are drawn from the kernel CSPRNG in batches, enough for this
+   many UUIDs, and kept per-thread so that no locking is needed. */
+
+#define EDGEX_UUID_BATCH 64
+#define EDGEX_UUID_BYTES 16
+
+typedef struct edgex_uuid_pool
+{
+  uint8_t bytes[EDGEX_UUID_BATCH * EDGEX_UUID_BYTES];
+  unsigned next;
+} edgex_uuid_pool;
+
 static _Thread_local char *localid = NULL;
+static _Thread_local edgex_uuid_pool uuidpool = { .next = EDGEX_UUID_BATCH };
+
+static const char hexdigits[] = "0123456789abcdef";
+
+static void edgex_uuid_refill (edgex_uuid_pool *pool)
+{
+  size_t done = 0;
+  while (done < sizeof (pool->bytes))
+  {
+    ssize_t n = getrandom (pool->bytes + done, sizeof (pool->bytes) - done, 0);
+    if (n > 0)
+    {
+      done += n;
+    }
+    else if (n < 0 && errno != EINTR)
+    {
+      break;
+    }
+  }
+  // Should getrandom be unavailable, fall back to libuuid for the remainder
+  for (; done + EDGEX_UUID_BYTES <= sizeof (pool->bytes); done += EDGEX_UUID_BYTES)
+  {
+    uuid_generate_random (pool->bytes + done);
+  }
+  pool->next = 0;
+}
+
+void edgex_device_genuuid_r (char *buf)
+{
+  if (uuidpool.next == EDGEX_UUID_BATCH)
+  {
+    edgex_uuid_refill (&uuidpool);
+  }
+  uint8_t *u = uuidpool.bytes + EDGEX_UUID_BYTES * uuidpool.next++;
+
+  // RFC 4122 version 4 (random) UUID
+  u[6] = (u[6] & 0x0f) | 0x40;
+  u[8] = (u[8] & 0x3f) | 0x80;
+
+  for (unsigned i = 0; i < EDGEX_UUID_BYTES; i++)
+  {
+    if (i == 4 || i == 6 || i == 8 || i == 10)
+    {
+      *buf++ = '-';
+    }
+    *buf++ = hexdigits[u[i] >> 4];
+    *buf++ = hexdigits[u[i] & 0x0f];
+  }
+  *buf = '\0';
+}
 
 char *edgex_device_genuuid ()
 {
-  char *result = malloc (37);
-  uuid_t uid;
-  uuid_generate (uid);
-  uuid_unparse (uid, result);
+  char *result = malloc (EDGEX_UUID_STRLEN);
+  edgex_device_genuuid_r (result);
   return result;
 }
 
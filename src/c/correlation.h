@@ -11,8 +11,14 @@
 
 #define EDGEX_CRLID_HDR "correlation-id"
 
+/* Length of a UUID in string form, including the terminator */
+#define EDGEX_UUID_STRLEN 37
+
 char *edgex_device_genuuid (void);
 
+/* Writes a new UUID into buf, which must hold EDGEX_UUID_STRLEN chars */
+void edgex_device_genuuid_r (char *buf);
+
 const char *edgex_device_get_crlid (void);
 void edgex_device_alloc_crlid (const char *id);
 void edgex_device_free_crlid (void);
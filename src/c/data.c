@@ -15,10 +15,12 @@
 #include "service.h"
 #include "transform.h"
 #include "correlation.h"
-#include "iot/base64.h"
+#include "b64.h"
+#include "encoder.h"
 
 #include <cbor.h>
 #include <microhttpd.h>
+#include <sched.h>
 
 static void edc_update_metrics (devsdk_metrics_t *metrics, const edgex_event_cooked *event)
 {
@@ -31,11 +33,7 @@ static char *edgex_value_tostring (const iot_data_t *value)
   char *res;
   if (iot_data_type (value) == IOT_DATA_BINARY)
   {
-    uint32_t sz, rsz;
-    rsz = iot_data_array_size (value);
-    sz = iot_b64_encodesize (rsz);
-    res = malloc (sz);
-    iot_b64_encode (iot_data_address (value), rsz, res, sz);
+    res = edgex_b64_encode_str (iot_data_address (value), iot_data_array_size (value));
   }
   else
   {
@@ -76,9 +74,222 @@ Event:
   readings: Array of Readings
 */
 
+/* Event templates. The parts of an event which depend only on the device and
+ * command (names, path, tags and per-reading constants) are compiled once per
+ * (device, command) pair. Templates are held on the device, so they are
+ * discarded when the device is replaced or released, and when its profile is
+ * updated. Events hold a reference to their template, so may outlive it.
+ *
+ * The list is read without locking. Readers are counted in the device while
+ * they walk it, and hold no locks meanwhile, so on a profile update the list
+ * is detached and then freed as soon as the count falls to zero. Compiling a
+ * template, which may take longer, is done outside of the count.
+ */
+
+typedef struct edgex_event_template_reading
+{
+  char *resourceName;
+  const char *valueType;
+  char *mediaType;
+  iot_data_t *tags;
+  iot_typecode_t type;
+  bool reducedResName;
+} edgex_event_template_reading;
+
+typedef struct edgex_event_template
+{
+  const edgex_cmdinfo *cmdinfo;  // Only for matching; may be freed while events are queued
+  atomic_uint_fast32_t refs;
+  uint32_t nreqs;
+  iot_data_t *path;
+  char *deviceName;
+  char *profileName;
+  char *sourceName;
+  iot_data_t *tags;
+  edgex_event_template_reading *readings;
+  size_t sizehint;
+  bool useCBOR;
+  int8_t qos;
+  int8_t retained;
+  struct edgex_event_template *next;
+} edgex_event_template;
+
+typedef struct edgex_event_reading
+{
+  char id[EDGEX_UUID_STRLEN];
+  const char *valueType;
+  iot_data_t *value;
+  uint64_t origin;
+} edgex_event_reading;
+
+static edgex_event_template *edgex_event_template_compile (const edgex_device *device, const edgex_cmdinfo *cmd)
+{
+  edgex_event_template *result = calloc (1, sizeof (edgex_event_template));
+  char *path = malloc (strlen (cmd->profile->name) + strlen (device->name) + strlen (cmd->name) + 3);
+  sprintf (path, "%s/%s/%s", cmd->profile->name, device->name, cmd->name);
+
+  result->cmdinfo = cmd;
+  atomic_init (&result->refs, 1);
+  result->nreqs = cmd->nreqs;
+  result->path = iot_data_alloc_string (path, IOT_DATA_TAKE);
+  result->deviceName = strdup (device->name);
+  result->profileName = strdup (cmd->profile->name);
+  result->sourceName = strdup (cmd->name);
+  result->qos = cmd->qos;
+  result->retained = cmd->retained;
+  result->sizehint = 128 + strlen (path);
+
+  iot_data_t *tags = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_map_merge (tags, cmd->tags);
+  iot_data_map_merge (tags, device->tags);
+  if (iot_data_map_size (tags))
+  {
+    result->tags = tags;
+  }
+  else
+  {
+    iot_data_free (tags);
+  }
+
+  result->readings = calloc (cmd->nreqs, sizeof (edgex_event_template_reading));
+  for (uint32_t i = 0; i < cmd->nreqs; i++)
+  {
+    edgex_event_template_reading *rdg = &result->readings[i];
+    rdg->resourceName = strdup (cmd->reqs[i].resource->name);
+    rdg->type = cmd->pvals[i]->type;
+    rdg->valueType = edgex_typecode_tostring (rdg->type);
+    if (cmd->pvals[i]->mediaType)
+    {
+      rdg->mediaType = strdup (cmd->pvals[i]->mediaType);
+    }
+    if (cmd->reqs[i].resource->tags)
+    {
+      rdg->tags = iot_data_add_ref (cmd->reqs[i].resource->tags);
+    }
+    rdg->reducedResName = (cmd->nreqs > 1) || (strcmp (cmd->reqs[i].resource->name, cmd->name) != 0);
+    if (rdg->type.type == IOT_DATA_BINARY)
+    {
+      result->useCBOR = true;
+    }
+    result->sizehint += 192 + strlen (rdg->resourceName) + strlen (device->name) + strlen (cmd->profile->name);
+  }
+  return result;
+}
+
+static void edgex_event_template_release (edgex_event_template *t)
+{
+  if (t && atomic_fetch_sub (&t->refs, 1) == 1)
+  {
+    for (uint32_t i = 0; i < t->nreqs; i++)
+    {
+      free (t->readings[i].resourceName);
+      free (t->readings[i].mediaType);
+      iot_data_free (t->readings[i].tags);
+    }
+    free (t->readings);
+    iot_data_free (t->path);
+    free (t->deviceName);
+    free (t->profileName);
+    free (t->sourceName);
+    iot_data_free (t->tags);
+    free (t);
+  }
+}
+
+static void edgex_event_template_list_free (edgex_event_template *t)
+{
+  while (t)
+  {
+    edgex_event_template *next = t->next;
+    edgex_event_template_release (t);
+    t = next;
+  }
+}
+
+/* Looks up the template for a command in the device's list, or adds the
+   compiled template if given. Returns it with a reference added, or NULL
+   if it must be compiled. */
+
+static edgex_event_template *edgex_event_template_find
+  (edgex_device *device, const edgex_cmdinfo *cmd, edgex_event_template **compiled)
+{
+  edgex_event_template *t = NULL;
+  atomic_fetch_add (&device->tmplreaders, 1);
+  edgex_event_template *head = atomic_load (&device->templates);
+  while (true)
+  {
+    for (t = head; t; t = t->next)
+    {
+      if (t->cmdinfo == cmd)
+      {
+        // Another thread may have compiled the same template concurrently
+        edgex_event_template_release (*compiled);
+        *compiled = NULL;
+        break;
+      }
+    }
+    if (t || *compiled == NULL)
+    {
+      break;
+    }
+    if (cmd->profile != device->profile)
+    {
+      // The profile was replaced after the command was looked up. Templates
+      // are matched by cmdinfo address, so this one must not be listed.
+      t = *compiled;
+      atomic_fetch_sub (&device->tmplreaders, 1);
+      return t;
+    }
+    (*compiled)->next = head;
+    if (atomic_compare_exchange_weak (&device->templates, &head, *compiled))
+    {
+      t = *compiled;
+      break;
+    }
+  }
+  if (t)
+  {
+    atomic_fetch_add (&t->refs, 1);
+  }
+  atomic_fetch_sub (&device->tmplreaders, 1);
+  return t;
+}
+
+static edgex_event_template *edgex_event_template_get (edgex_device *device, const edgex_cmdinfo *cmd)
+{
+  edgex_event_template *compiled = NULL;
+  edgex_event_template *t = edgex_event_template_find (device, cmd, &compiled);
+  if (t == NULL)
+  {
+    compiled = edgex_event_template_compile (device, cmd);
+    t = edgex_event_template_find (device, cmd, &compiled);
+  }
+  return t;
+}
+
+void edgex_event_templates_free (edgex_device *device)
+{
+  edgex_event_template_list_free (atomic_exchange (&device->templates, NULL));
+}
+
+void edgex_event_templates_clear (edgex_device *device)
+{
+  edgex_event_template *list = atomic_exchange (&device->templates, NULL);
+  while (atomic_load (&device->tmplreaders))
+  {
+    sched_yield ();
+  }
+  edgex_event_template_list_free (list);
+}
+
+static bool edgex_typecode_equal (const iot_typecode_t *t1, const iot_typecode_t *t2)
+{
+  return (t1->type == t2->type) && (t1->type != IOT_DATA_ARRAY || t1->element_type == t2->element_type);
+}
+
 edgex_event_cooked *edgex_data_process_event
 (
-  const edgex_device *device,
+  edgex_device *device,
   const edgex_cmdinfo *commandinfo,
   devsdk_commandresult *values,
   iot_data_t *tags,
@@ -86,20 +297,14 @@ edgex_event_cooked *edgex_data_process_event
   bool reducedEvents
 )
 {
-  char *eventId;
   edgex_event_cooked *result = NULL;
-  bool useCBOR = false;
   uint64_t timenow = iot_time_nsecs ();
 
   for (uint32_t i = 0; i < commandinfo->nreqs; i++)
   {
-    if (commandinfo->pvals[i]->type.type == IOT_DATA_BINARY)
-    {
-      useCBOR = true;
-    }
     if (doTransforms)
     {
-      edgex_transform_outgoing (&values[i], commandinfo->pvals[i], commandinfo->maps[i]);
+      edgex_transform_outgoing (&values[i], &commandinfo->xforms[i], commandinfo->maps[i]);
     }
     const char *assertion = commandinfo->pvals[i]->assertion;
     if (assertion && *assertion)
@@ -117,196 +322,251 @@ edgex_event_cooked *edgex_data_process_event
     }
   }
 
-  eventId = edgex_device_genuuid ();
-  result = malloc (sizeof (edgex_event_cooked));
-  result->nrdgs = commandinfo->nreqs;
+  edgex_event_template *tmpl = edgex_event_template_get (device, commandinfo);
 
-  result->path = malloc (strlen (commandinfo->profile->name) + strlen (device->name) + strlen (commandinfo->name) + 3);
-  strcpy (result->path, commandinfo->profile->name);
-  strcat (result->path, "/");
-  strcat (result->path, device->name);
-  strcat (result->path, "/");
-  strcat (result->path, commandinfo->name);
+  result = calloc (1, sizeof (edgex_event_cooked));
+  result->nrdgs = commandinfo->nreqs;
+  atomic_init (&result->refs, 1);
+  result->path = iot_data_add_ref (tmpl->path);
+  result->encoding = tmpl->useCBOR ? CBOR : JSON;
+  result->tmpl = tmpl;
+  edgex_device_genuuid_r (result->id);
+  result->origin = timenow;
+  result->reduced = reducedEvents;
+  atomic_init (&result->encoded[JSON], NULL);
+  atomic_init (&result->encoded[CBOR], NULL);
+
+  if (tags && iot_data_map_size (tags))
+  {
+    result->tags = iot_data_alloc_map (IOT_DATA_STRING);
+    iot_data_map_merge (result->tags, tags);
+    iot_data_map_merge (result->tags, tmpl->tags);
+  }
+  else if (tmpl->tags)
+  {
+    result->tags = iot_data_add_ref (tmpl->tags);
+  }
 
-  iot_data_t *rvec = iot_data_alloc_vector (commandinfo->nreqs);
+  result->readings = calloc (commandinfo->nreqs, sizeof (edgex_event_reading));
   for (uint32_t i = 0; i < commandinfo->nreqs; i++)
   {
-    iot_data_t *rmap = iot_data_alloc_map (IOT_DATA_STRING);
+    edgex_event_reading *rdg = &result->readings[i];
     iot_typecode_t tc;
     iot_data_typecode (values[i].value, &tc);
 
+    rdg->value = iot_data_add_ref (values[i].value);
+    rdg->valueType = edgex_typecode_equal (&tc, &tmpl->readings[i].type) ? tmpl->readings[i].valueType : edgex_typecode_tostring (tc);
     if (!reducedEvents)
     {
-      char *id = edgex_device_genuuid ();
-      iot_data_string_map_add (rmap, "id", iot_data_alloc_string (id, IOT_DATA_TAKE));
-      iot_data_string_map_add (rmap, "profileName", iot_data_alloc_string (commandinfo->profile->name, IOT_DATA_REF));
-      iot_data_string_map_add (rmap, "deviceName", iot_data_alloc_string (device->name, IOT_DATA_REF));
+      edgex_device_genuuid_r (rdg->id);
     }
-    if ((!reducedEvents) || (commandinfo->nreqs > 1) || 
-        (strcmp (commandinfo->reqs[i].resource->name, commandinfo->name) != 0))
-    {
-      iot_data_string_map_add (rmap, "resourceName", iot_data_alloc_string (commandinfo->reqs[i].resource->name, IOT_DATA_REF));
-    }
-    iot_data_string_map_add (rmap, "valueType", iot_data_alloc_string (edgex_typecode_tostring (tc), IOT_DATA_REF));
     // Would check that reading and event origins are different.
-    // But event origin will be set to "timenow" below, so we check for that instead.
+    // But event origin will be set to "timenow", so we check for that instead.
     if ((!reducedEvents) || ((values[i].origin != 0) && (values[i].origin != timenow)))
     {
-      iot_data_string_map_add (rmap, "origin", iot_data_alloc_ui64 (values[i].origin ? values[i].origin : timenow));
-    }
-    switch (tc.type)
-    {
-      case IOT_DATA_BINARY:
-        iot_data_string_map_add (rmap, "binaryValue", iot_data_copy (values[i].value));
-        iot_data_string_map_add (rmap, "mediaType", iot_data_alloc_string (commandinfo->pvals[i]->mediaType, IOT_DATA_REF));
-        break;
-      case IOT_DATA_ARRAY:
-        iot_data_string_map_add (rmap, "value", iot_data_alloc_string (edgex_value_tostring (values[i].value), IOT_DATA_TAKE));
-        break;
-      case IOT_DATA_MAP:
-        iot_data_string_map_add (rmap, "objectValue", iot_data_copy (values[i].value));
-        break;
-      case IOT_DATA_STRING:
-        iot_data_string_map_add (rmap, "value", iot_data_alloc_string (iot_data_string (values[i].value), IOT_DATA_COPY));
-        break;
-      default:
-        iot_data_string_map_add (rmap, "value", iot_data_alloc_string (iot_data_to_json (values[i].value), IOT_DATA_TAKE));
-    }
-
-    if (commandinfo->reqs[i].resource->tags)
-    {
-      iot_data_string_map_add (rmap, "tags", iot_data_copy(commandinfo->reqs[i].resource->tags));
+      rdg->origin = values[i].origin ? values[i].origin : timenow;
     }
-
-    iot_data_vector_add (rvec, i, rmap);
-  }
-
-  iot_data_t *event_tags = iot_data_alloc_map (IOT_DATA_STRING);
-  iot_data_map_merge(event_tags, tags);
-  iot_data_map_merge(event_tags,commandinfo->tags);
-  iot_data_map_merge(event_tags,device->tags);
-
-  iot_data_t *evmap = iot_data_alloc_map (IOT_DATA_STRING);
-  iot_data_string_map_add (evmap, "apiVersion", iot_data_alloc_string (EDGEX_API_VERSION, IOT_DATA_REF));
-  iot_data_string_map_add (evmap, "id", iot_data_alloc_string (eventId, IOT_DATA_TAKE));
-  iot_data_string_map_add (evmap, "deviceName", iot_data_alloc_string (device->name, IOT_DATA_REF));
-  iot_data_string_map_add (evmap, "profileName", iot_data_alloc_string (commandinfo->profile->name, IOT_DATA_REF));
-  iot_data_string_map_add (evmap, "sourceName", iot_data_alloc_string (commandinfo->name, IOT_DATA_REF));
-  iot_data_string_map_add (evmap, "origin", iot_data_alloc_ui64 (timenow));
-  iot_data_string_map_add (evmap, "readings", rvec);
-
-  if (iot_data_map_size(event_tags)) {
-    iot_data_string_map_add (evmap, "tags", event_tags);
-  } else {
-    iot_data_free(event_tags);
   }
 
-  iot_data_t *reqmap = iot_data_alloc_map (IOT_DATA_STRING);
-  iot_data_string_map_add (reqmap, "apiVersion", iot_data_alloc_string (EDGEX_API_VERSION, IOT_DATA_REF));
-  iot_data_string_map_add (reqmap, "event", evmap);
-  iot_data_string_map_add (reqmap, "statusCode", iot_data_alloc_ui32 (MHD_HTTP_OK));
-
-  result->encoding = useCBOR ? CBOR : JSON;
-  // XXX tag the value with this
-  result->value = reqmap;
   return result;
 }
 
-void edgex_data_client_add_event (edgex_bus_t *client, edgex_event_cooked *ev, devsdk_metrics_t *metrics)
+static void edgex_event_reading_encode (const edgex_event_cooked *e, uint32_t i, edgex_encoder *enc)
 {
-  char *topic = edgex_bus_mktopic (client, EDGEX_DEV_TOPIC_EVENT, ev->path);
-  edc_update_metrics (metrics, ev);
-  edgex_bus_post (client, topic, ev->value, (ev->encoding == CBOR));
-  free (topic);
+  const edgex_event_reading *rdg = &e->readings[i];
+  const edgex_event_template_reading *trdg = &e->tmpl->readings[i];
+  bool withResName = (!e->reduced) || trdg->reducedResName;
+  iot_data_type_t type = iot_data_type (rdg->value);
+
+  uint32_t nfields = 2;
+  nfields += e->reduced ? 0 : 3;
+  nfields += withResName ? 1 : 0;
+  nfields += rdg->origin ? 1 : 0;
+  nfields += (type == IOT_DATA_BINARY) ? 1 : 0;
+  nfields += trdg->tags ? 1 : 0;
+
+  edgex_enc_map_start (enc, nfields);
+  if (!e->reduced)
+  {
+    edgex_enc_key (enc, "id");
+    edgex_enc_string (enc, rdg->id);
+    edgex_enc_key (enc, "profileName");
+    edgex_enc_string (enc, e->tmpl->profileName);
+    edgex_enc_key (enc, "deviceName");
+    edgex_enc_string (enc, e->tmpl->deviceName);
+  }
+  if (withResName)
+  {
+    edgex_enc_key (enc, "resourceName");
+    edgex_enc_string (enc, trdg->resourceName);
+  }
+  edgex_enc_key (enc, "valueType");
+  edgex_enc_string (enc, rdg->valueType);
+  if (rdg->origin)
+  {
+    edgex_enc_key (enc, "origin");
+    edgex_enc_uint (enc, rdg->origin);
+  }
+  switch (type)
+  {
+    case IOT_DATA_BINARY:
+      edgex_enc_key (enc, "binaryValue");
+      edgex_enc_bytes (enc, iot_data_address (rdg->value), iot_data_array_size (rdg->value));
+      edgex_enc_key (enc, "mediaType");
+      edgex_enc_string (enc, trdg->mediaType ? trdg->mediaType : "");
+      break;
+    case IOT_DATA_MAP:
+      edgex_enc_key (enc, "objectValue");
+      edgex_enc_data (enc, rdg->value);
+      break;
+    default:
+      edgex_enc_key (enc, "value");
+      edgex_enc_data_as_string (enc, rdg->value);
+  }
+  if (trdg->tags)
+  {
+    edgex_enc_key (enc, "tags");
+    edgex_enc_data (enc, trdg->tags);
+  }
+  edgex_enc_map_end (enc);
 }
 
-size_t edgex_event_cooked_size (edgex_event_cooked *e)
+void edgex_event_cooked_encode (const edgex_event_cooked *e, edgex_encoder *enc)
 {
-  size_t result;
-  if (e->encoding == JSON)
+  const edgex_event_template *tmpl = e->tmpl;
+
+  edgex_enc_map_start (enc, 3);
+  edgex_enc_key (enc, "apiVersion");
+  edgex_enc_string (enc, EDGEX_API_VERSION);
+  edgex_enc_key (enc, "event");
+  edgex_enc_map_start (enc, e->tags ? 8 : 7);
+  edgex_enc_key (enc, "apiVersion");
+  edgex_enc_string (enc, EDGEX_API_VERSION);
+  edgex_enc_key (enc, "id");
+  edgex_enc_string (enc, e->id);
+  edgex_enc_key (enc, "deviceName");
+  edgex_enc_string (enc, tmpl->deviceName);
+  edgex_enc_key (enc, "profileName");
+  edgex_enc_string (enc, tmpl->profileName);
+  edgex_enc_key (enc, "sourceName");
+  edgex_enc_string (enc, tmpl->sourceName);
+  edgex_enc_key (enc, "origin");
+  edgex_enc_uint (enc, e->origin);
+  if (e->tags)
   {
-      char *json = iot_data_to_json (e->value);
-      result = strlen (json);
-      free (json);
+    edgex_enc_key (enc, "tags");
+    edgex_enc_data (enc, e->tags);
   }
-  else
+  edgex_enc_key (enc, "readings");
+  edgex_enc_array_start (enc, e->nrdgs);
+  for (uint32_t i = 0; i < e->nrdgs; i++)
   {
-    iot_data_t *cbor = iot_data_to_cbor (e->value);
-    result = iot_data_array_size (cbor);
-    iot_data_free (cbor);
+    edgex_event_reading_encode (e, i, enc);
   }
-  return result;
+  edgex_enc_array_end (enc);
+  edgex_enc_map_end (enc);
+  edgex_enc_key (enc, "statusCode");
+  edgex_enc_uint (enc, MHD_HTTP_OK);
+  edgex_enc_map_end (enc);
 }
 
-void edgex_event_cooked_write (edgex_event_cooked *e, devsdk_http_reply *reply)
+static size_t edgex_event_cooked_sizehint (const edgex_event_cooked *e)
 {
-  switch (e->encoding)
+  size_t result = e->tmpl->sizehint;
+  for (uint32_t i = 0; i < e->nrdgs; i++)
   {
-    case JSON:
+    iot_data_type_t type = iot_data_type (e->readings[i].value);
+    if (type == IOT_DATA_BINARY)
     {
-      char *json = iot_data_to_json (e->value);
-      reply->data.bytes = json;
-      reply->data.size = strlen (json);
-      reply->content_type = CONTENT_JSON;
-      break;
+      // Allow for base64 expansion
+      result += 4 * ((iot_data_array_size (e->readings[i].value) + 2) / 3);
     }
-    case CBOR:
+    else if (type == IOT_DATA_ARRAY)
     {
-      iot_data_t *cbor = iot_data_to_cbor (e->value);
-      reply->data.size = iot_data_array_size (cbor);
-      reply->data.bytes = malloc (reply->data.size);
-      memcpy (reply->data.bytes, iot_data_address (cbor), reply->data.size);
-      reply->content_type = CONTENT_CBOR;
-      iot_data_free (cbor);
-      break;
+      // Allow for textual expansion
+      result += 2 * iot_data_array_size (e->readings[i].value);
     }
   }
-  reply->code = MHD_HTTP_OK;
+  return result;
 }
 
-void edgex_event_cooked_free (edgex_event_cooked *e)
+const iot_data_t *edgex_event_cooked_data (edgex_event_cooked *e, bool cbor)
 {
-  if (e)
+  iot_data_t *result = atomic_load (&e->encoded[cbor ? CBOR : JSON]);
+  if (result == NULL)
   {
-    iot_data_free (e->value);
-    free (e->path);
-    free (e);
+    iot_data_t *expected = NULL;
+    edgex_encoder enc;
+    edgex_enc_init (&enc, cbor, edgex_event_cooked_sizehint (e));
+    edgex_event_cooked_encode (e, &enc);
+    result = edgex_enc_take_data (&enc);
+    if (!atomic_compare_exchange_strong (&e->encoded[cbor ? CBOR : JSON], &expected, result))
+    {
+      // Encoded concurrently by another thread
+      iot_data_free (result);
+      result = expected;
+    }
   }
+  return result;
 }
 
-void devsdk_commandresult_free (devsdk_commandresult *res, int n)
+void edgex_data_client_publish (edgex_bus_t *client, edgex_event_cooked *ev, devsdk_metrics_t *metrics)
 {
-  if (res)
-  {
-    for (int i = 0; i < n; i++)
-    {
-      iot_data_free (res[i].value);
-    }
-    free (res);
-  }
+  char *topic = edgex_bus_mktopic (client, EDGEX_DEV_TOPIC_EVENT, iot_data_string (ev->path));
+  const iot_data_t *payload = edgex_event_cooked_data (ev, ev->encoding == CBOR || edgex_bus_cbor (client));
+  edgex_bus_pubopts opts = { .qos = ev->tmpl->qos, .retained = ev->tmpl->retained, .key = ev->tmpl->deviceName, .alias = true };
+  edc_update_metrics (metrics, ev);
+  edgex_bus_post_opts (client, topic, payload, (ev->encoding == CBOR), &opts);
+  free (topic);
 }
 
-devsdk_commandresult *devsdk_commandresult_dup (const devsdk_commandresult *res, int n)
+size_t edgex_event_cooked_size (edgex_event_cooked *e)
+{
+  return iot_data_array_size (edgex_event_cooked_data (e, e->encoding == CBOR));
+}
+
+void edgex_event_cooked_write (edgex_event_cooked *e, devsdk_http_reply *reply)
 {
-  devsdk_commandresult *result = calloc (n, sizeof (devsdk_commandresult));
-  for (int i = 0; i < n; i++)
+  const iot_data_t *data = edgex_event_cooked_data (e, e->encoding == CBOR);
+  reply->data.bytes = (void *)iot_data_address (data);
+  reply->data.size = iot_data_array_size (data);
+  reply->data_owner = iot_data_add_ref (data);
+  reply->content_type = (e->encoding == CBOR) ? CONTENT_CBOR : CONTENT_JSON;
+  reply->code = MHD_HTTP_OK;
+}
+
+edgex_event_cooked *edgex_event_cooked_add_ref (edgex_event_cooked *e)
+{
+  atomic_fetch_add (&e->refs, 1);
+  return e;
+}
+
+void edgex_event_cooked_free (edgex_event_cooked *e)
+{
+  if (e && atomic_fetch_sub (&e->refs, 1) == 1)
   {
-    result[i].value = iot_data_copy (res[i].value);
+    for (uint32_t i = 0; i < e->nrdgs; i++)
+    {
+      iot_data_free (e->readings[i].value);
+    }
+    free (e->readings);
+    iot_data_free (atomic_load (&e->encoded[JSON]));
+    iot_data_free (atomic_load (&e->encoded[CBOR]));
+    iot_data_free (e->tags);
+    iot_data_free (e->path);
+    edgex_event_template_release (e->tmpl);
+    free (e);
   }
-  return result;
 }
 
-bool devsdk_commandresult_equal
-  (const devsdk_commandresult *lhs, const devsdk_commandresult *rhs, int n)
+void devsdk_commandresult_free (devsdk_commandresult *res, int n)
 {
-  bool result = true;
-  for (int i = 0; i < n; i++)
+  if (res)
   {
-    if (!iot_data_equal (lhs[i].value, rhs[i].value))
+    for (int i = 0; i < n; i++)
     {
-      result = false;
-      break;
+      iot_data_free (res[i].value);
     }
+    free (res);
   }
-  return result;
 }
@@ -17,24 +17,44 @@
 #include "cmdinfo.h"
 #include "rest-server.h"
 #include "iot/threadpool.h"
+#include "encoder.h"
+#include "correlation.h"
 
 typedef enum { JSON, CBOR} edgex_event_encoding;
 
+/* An event is held as its readings plus a reference to the template for its
+   device and command. It is serialized on demand, directly from these, and
+   the result cached for reuse. */
+
 typedef struct edgex_event_cooked
 {
   unsigned nrdgs;
-  char *path;
+  atomic_uint_fast32_t refs;
+  iot_data_t *path;
   edgex_event_encoding encoding;
-  iot_data_t *value;
+  struct edgex_event_template *tmpl;
+  struct edgex_event_reading *readings;
+  char id[EDGEX_UUID_STRLEN];
+  uint64_t origin;
+  iot_data_t *tags;
+  _Atomic (iot_data_t *) encoded[2];
+  bool reduced;
 } edgex_event_cooked;
 
+void edgex_event_cooked_encode (const edgex_event_cooked *e, edgex_encoder *enc);
+
+/* Returns the serialized event in JSON or CBOR. Each encoding is computed
+   once, on first use, and retained until the event is freed. */
+
+const iot_data_t *edgex_event_cooked_data (edgex_event_cooked *e, bool cbor);
 size_t edgex_event_cooked_size (edgex_event_cooked *e);
+edgex_event_cooked *edgex_event_cooked_add_ref (edgex_event_cooked *e);
 void edgex_event_cooked_write (edgex_event_cooked *e, devsdk_http_reply *rep);
 void edgex_event_cooked_free (edgex_event_cooked *e);
 
 edgex_event_cooked *edgex_data_process_event
 (
-  const edgex_device *device,
+  edgex_device *device,
   const edgex_cmdinfo *commandinfo,
   devsdk_commandresult *values,
   iot_data_t *tags,
@@ -42,12 +62,14 @@ edgex_event_cooked *edgex_data_process_event
   bool reducedEvents
 );
 
-void edgex_data_client_add_event (edgex_bus_t *bus, edgex_event_cooked *eventval, devsdk_metrics_t *metrics);
+void edgex_event_templates_free (edgex_device *device);
 
-void devsdk_commandresult_free (devsdk_commandresult *res, int n);
+/* Discards a device's templates while other threads may be using the
+   device, waiting for any which are reading the list to finish */
+void edgex_event_templates_clear (edgex_device *device);
 
-devsdk_commandresult *devsdk_commandresult_dup (const devsdk_commandresult *res, int n);
+void edgex_data_client_publish (edgex_bus_t *bus, edgex_event_cooked *eventval, devsdk_metrics_t *metrics);
 
-bool devsdk_commandresult_equal (const devsdk_commandresult *lhs, const devsdk_commandresult *rhs, int n);
+void devsdk_commandresult_free (devsdk_commandresult *res, int n);
 
 #endif
@@ -15,12 +15,14 @@
 #include "metadata.h"
 #include "edgex-rest.h"
 #include "cmdinfo.h"
-#include "iot/base64.h"
+#include "b64.h"
 #include "iot/config.h"
 #include "transform.h"
 #include "reqdata.h"
 #include "request_auth.h"
 #include "opstate.h"
+#include "eventq.h"
+#include "lastconnected.h"
 
 #include <inttypes.h>
 #include <string.h>
@@ -76,12 +78,7 @@ static iot_data_t *populateValue (iot_typecode_t rtype, const char *val)
   }
   else if (rtype.type == IOT_DATA_BINARY)
   {
-    iot_data_t *res = iot_data_alloc_array_from_base64 (val);
-    if (res)
-    {
-      iot_data_array_to_binary (res);
-    }
-    return res;
+    return edgex_b64_to_binary (val);
   }
   else if (rtype.type == IOT_DATA_MAP)
   {
@@ -103,6 +100,45 @@ static edgex_deviceresource *findDevResource
   return list;
 }
 
+/* Publish options for events may be set by the mqttQos and mqttRetained
+   attributes of a resource, as numbers / booleans or as strings. -1 leaves
+   the MessageBus setting in effect. */
+
+static void pubOptsForRes (const edgex_deviceresource *devres, int8_t *qos, int8_t *retained)
+{
+  const iot_data_t *v;
+  *qos = -1;
+  *retained = -1;
+  if (devres->attributes == NULL || iot_data_type (devres->attributes) != IOT_DATA_MAP)
+  {
+    return;
+  }
+  if ((v = iot_data_string_map_get (devres->attributes, "mqttQos")))
+  {
+    uint8_t q = 0xff;
+    if (iot_data_type (v) == IOT_DATA_STRING)
+    {
+      q = devsdk_strtoul_dfl (iot_data_string (v), 0xff);
+    }
+    else
+    {
+      iot_data_cast (v, IOT_DATA_UINT8, &q);
+    }
+    *qos = (q <= 2) ? (int8_t)q : -1;
+  }
+  if ((v = iot_data_string_map_get (devres->attributes, "mqttRetained")))
+  {
+    if (iot_data_type (v) == IOT_DATA_STRING)
+    {
+      *retained = (strcmp (iot_data_string (v), "true") == 0) ? 1 : (strcmp (iot_data_string (v), "false") == 0) ? 0 : -1;
+    }
+    else if (iot_data_type (v) == IOT_DATA_BOOL)
+    {
+      *retained = iot_data_bool (v) ? 1 : 0;
+    }
+  }
+}
+
 static edgex_cmdinfo *infoForRes (devsdk_service_t *svc, edgex_deviceprofile *prof, edgex_devicecommand *cmd, bool forGet)
 {
   iot_data_t *exception = NULL;
@@ -142,13 +178,28 @@ static edgex_cmdinfo *infoForRes (devsdk_service_t *svc, edgex_deviceprofile *pr
   }
   result->reqs = calloc (n, sizeof (devsdk_commandrequest));
   result->pvals = calloc (n, sizeof (edgex_propertyvalue *));
+  result->xforms = calloc (n, sizeof (edgex_transform));
   result->maps = calloc (n, sizeof (iot_data_t *));
   result->dfls = calloc (n, sizeof (char *));
+  result->qos = -1;
+  result->retained = -1;
   for (n = 0, ro = cmd->resourceOperations; ro; n++, ro = ro->next)
   {
     result->reqs[n].resource = malloc (sizeof (devsdk_resource_t));
     edgex_deviceresource *devres =
       findDevResource (prof->device_resources, ro->deviceResource);
+    // A command's events take the highest QoS of its resources, and are
+    // retained if any resource asks for it
+    int8_t qos, retained;
+    pubOptsForRes (devres, &qos, &retained);
+    if (qos > result->qos)
+    {
+      result->qos = qos;
+    }
+    if (retained > result->retained)
+    {
+      result->retained = retained;
+    }
     result->reqs[n].resource->name = devres->name;
     result->reqs[n].resource->attrs = devres->parsed_attrs;
     result->reqs[n].resource->tags = devres->tags;
@@ -158,6 +209,7 @@ static edgex_cmdinfo *infoForRes (devsdk_service_t *svc, edgex_deviceprofile *pr
       result->reqs[n].mask = ~devres->properties->mask.value.ival;
     }
     result->pvals[n] = devres->properties;
+    edgex_transform_compile (&result->xforms[n], devres->properties);
     result->maps[n] = iot_data_add_ref (ro->mappings);
     if (ro->defaultValue && *ro->defaultValue)
     {
@@ -196,8 +248,10 @@ static edgex_cmdinfo *infoForDevRes (devsdk_service_t *svc, edgex_deviceprofile
   result->nreqs = 1;
   result->reqs = malloc (sizeof (devsdk_commandrequest));
   result->pvals = malloc (sizeof (edgex_propertyvalue *));
+  result->xforms = malloc (sizeof (edgex_transform));
   result->maps = malloc (sizeof (devsdk_nvpairs *));
   result->dfls = malloc (sizeof (char *));
+  pubOptsForRes (devres, &result->qos, &result->retained);
   result->reqs[0].resource = malloc (sizeof (devsdk_resource_t));
   result->reqs[0].resource->name = devres->name;
   result->reqs[0].resource->attrs = devres->parsed_attrs;
@@ -212,6 +266,7 @@ static edgex_cmdinfo *infoForDevRes (devsdk_service_t *svc, edgex_deviceprofile
     result->reqs[0].mask = ~devres->properties->mask.value.ival;
   }
   result->pvals[0] = devres->properties;
+  edgex_transform_compile (&result->xforms[0], devres->properties);
   result->maps[0] = NULL;
   if (devres->properties->defaultvalue && *devres->properties->defaultvalue)
   {
@@ -329,7 +384,7 @@ static void edgex_device_runput2
           edgex_error_response (svc->logger, reply, MHD_HTTP_BAD_REQUEST, "Value \"%s\" for %s out of range specified in profile", value, resname);
           break;
         }
-        edgex_transform_incoming (&results[i], cmdinfo->pvals[i], cmdinfo->maps[i]);
+        edgex_transform_incoming (&results[i], &cmdinfo->xforms[i], cmdinfo->maps[i]);
         if (!results[i])
         {
           edgex_error_response (svc->logger, reply, MHD_HTTP_BAD_REQUEST, "Value \"%s\" for %s overflows after transformations", value, resname);
@@ -363,8 +418,7 @@ static void edgex_device_runput2
         edgex_baseresponse_write (&br, reply);
         if (svc->config.device.updatelastconnected)
         {
-          devsdk_error err;
-          edgex_metadata_client_update_lastconnected (svc->logger, &svc->config.endpoints, svc->secretstore, dev->name, &err);
+          edgex_lastconnected_record (svc->lastconn, dev);
         }
       }
       else
@@ -424,7 +478,7 @@ static edgex_event_cooked *edgex_device_runget2
       {
         if (svc->config.device.updatelastconnected)
         {
-          edgex_metadata_client_update_lastconnected (svc->logger, &svc->config.endpoints, svc->secretstore, dev->name, &err);
+          edgex_lastconnected_record (svc->lastconn, dev);
         }
         if (svc->config.device.maxeventsize && edgex_event_cooked_size (result) > svc->config.device.maxeventsize * 1024)
         {
@@ -519,12 +573,12 @@ static void edgex_device_v2impl (devsdk_service_t *svc, edgex_device *dev, const
         {
           if (retv)
           {
-            edgex_data_client_add_event (svc->msgbus, event, &svc->metrics);
+            edgex_eventq_push (svc->events, event);
             edgex_event_cooked_write (event, reply);
           }
           else
           {
-            edgex_data_client_add_event (svc->msgbus, event, &svc->metrics);
+            edgex_eventq_push (svc->events, event);
             edgex_baseresponse_populate (&br, EDGEX_API_VERSION, MHD_HTTP_OK, "Event generated successfully");
             edgex_baseresponse_write (&br, reply);
           }
@@ -637,7 +691,7 @@ static int32_t edgex_device_runput3
         result = MHD_HTTP_BAD_REQUEST;
         break;
       }
-      edgex_transform_incoming (&results[i], cmdinfo->pvals[i], cmdinfo->maps[i]);
+      edgex_transform_incoming (&results[i], &cmdinfo->xforms[i], cmdinfo->maps[i]);
       if (!results[i])
       {
         *reply = edgex_v3_error_response (svc->logger, "Value \"%s\" for %s overflows after transformations", value, resname);
@@ -663,8 +717,7 @@ static int32_t edgex_device_runput3
       *reply = edgex_v3_base_response ("Data written successfully");
       if (svc->config.device.updatelastconnected)
       {
-        devsdk_error err;
-        edgex_metadata_client_update_lastconnected (svc->logger, &svc->config.endpoints, svc->secretstore, dev->name, &err);
+        edgex_lastconnected_record (svc->lastconn, dev);
       }
       devsdk_device_request_succeeded (svc, dev);
     }
@@ -724,7 +777,7 @@ static edgex_event_cooked *edgex_device_runget3 (devsdk_service_t *svc, edgex_de
       {
         if (svc->config.device.updatelastconnected)
         {
-          edgex_metadata_client_update_lastconnected (svc->logger, &svc->config.endpoints, svc->secretstore, dev->name, &err);
+          edgex_lastconnected_record (svc->lastconn, dev);
         }
         if (svc->config.device.maxeventsize && edgex_event_cooked_size (result) > svc->config.device.maxeventsize * 1024)
         {
@@ -814,11 +867,11 @@ static int32_t edgex_device_v3impl (devsdk_service_t *svc, edgex_device *dev, co
       bool retv = params ? iot_data_string_map_get_bool (params, DS_RETURN, true) : true;
       if (pushv)
       {
-        edgex_data_client_add_event (svc->msgbus, event, &svc->metrics);
+        edgex_eventq_push (svc->events, event);
       }
       if (retv)
       {
-        *reply = iot_data_add_ref (event->value);
+        *reply = iot_data_add_ref (edgex_event_cooked_data (event, event->encoding == CBOR || edgex_bus_cbor (svc->msgbus)));
       }
       else
       {
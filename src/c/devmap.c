@@ -16,6 +16,7 @@
 #include "edgex-rest.h"
 #include "device.h"
 #include "autoevent.h"
+#include "data.h"
 
 typedef edgex_map(edgex_device *) edgex_map_device;
 typedef edgex_map(edgex_deviceprofile *) edgex_map_profile;
@@ -83,11 +84,15 @@ void edgex_devmap_free (edgex_devmap_t *map)
   free (map);
 }
 
-static void add_locked (edgex_devmap_t *map, const edgex_device *newdev, int32_t retries)
+static edgex_device *add_locked (edgex_devmap_t *map, const edgex_device *newdev, int32_t retries)
 {
   edgex_device *dup = edgex_device_dup (newdev);
   atomic_store (&dup->refs, 1);
   atomic_store (&dup->retries, retries);
+  atomic_init (&dup->templates, NULL);
+  atomic_init (&dup->tmplreaders, 0);
+  atomic_init (&dup->lastconnected, 0);
+  atomic_init (&dup->lcpending, false);
   dup->ownprofile = false;
   edgex_deviceprofile **pp = edgex_map_get (&map->profiles, dup->profile->name);
   if (pp)
@@ -101,6 +106,7 @@ static void add_locked (edgex_devmap_t *map, const edgex_device *newdev, int32_t
   }
   edgex_map_set (&map->devices, dup->name, dup);
   edgex_device_autoevent_start (map->svc, dup);
+  return dup;
 }
 
 void edgex_devmap_populate_devices
@@ -264,7 +270,10 @@ edgex_devmap_outcome_t edgex_devmap_replace_device (edgex_devmap_t *map, const e
     if (!update_in_place (olddev, dev, &result))
     {
       remove_locked (map, olddev);
-      add_locked (map, dev, olddev->retries);
+      edgex_device *newdev = add_locked (map, dev, olddev->retries);
+      // Keep any LastConnected update not yet sent for the old instance
+      atomic_store (&newdev->lastconnected, atomic_load (&olddev->lastconnected));
+      atomic_store (&newdev->lcpending, atomic_load (&olddev->lcpending));
       release = true;
       if (strcmp (olddev->profile->name, dev->profile->name))
       {
@@ -353,6 +362,7 @@ void edgex_devmap_update_profile (devsdk_service_t *svc, edgex_deviceprofile *dp
       {
         edgex_device_autoevent_stop (*dev);
         (*dev)->profile = dp;
+        edgex_event_templates_clear (*dev);
         edgex_device_autoevent_start (svc, *dev);
       }
     }
@@ -369,6 +379,7 @@ void edgex_device_release (devsdk_service_t *svc, edgex_device *dev)
   if (atomic_fetch_add (&dev->refs, -1) == 1)
   {
     edgex_device_autoevent_stop (dev);
+    edgex_event_templates_free (dev);
     if (!dev->ownprofile)
     {
       dev->profile = NULL;
@@ -57,6 +57,7 @@ static edgex_device_autoevents *edgex_autoevent_read (const iot_data_t *obj)
   result->resource = get_string (obj, "sourceName");
   result->onChange = iot_data_string_map_get_bool (obj, "onChange", false);
   iot_data_string_map_get_number (obj, "onChangeThreshold", IOT_DATA_FLOAT64, &result->onChangeThreshold);
+  iot_data_string_map_get_number (obj, "onChangeThresholdPercent", IOT_DATA_FLOAT64, &result->onChangeThresholdPercent);
   result->interval = get_string  (obj, "interval");
   return result;
 }
@@ -150,6 +151,11 @@ static void edgex_get_readwrite (const iot_data_t *object, bool *read, bool *wri
 static void edgex_get_transformArg (const iot_data_t *obj, const char *name, iot_typecode_t type, edgex_transformArg *res)
 {
   res->enabled = false;
+  if (type.type == IOT_DATA_ARRAY)
+  {
+    // Transforms on an array apply to each element
+    type.type = type.element_type;
+  }
   if (type.type >= IOT_DATA_INT8 && type.type <= IOT_DATA_UINT64)
   {
     int64_t i = 0;
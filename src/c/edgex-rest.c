@@ -392,6 +392,7 @@ static void cmdinfo_free (edgex_cmdinfo *inf)
     }
     free (inf->reqs);
     free (inf->pvals);
+    free (inf->xforms);
     free (inf->maps);
     free (inf->dfls);
     iot_data_free (inf->tags);
@@ -406,6 +407,7 @@ static edgex_device_autoevents *autoevent_read (const JSON_Object *obj)
   result->resource = get_string (obj, "sourceName");
   result->onChange = get_boolean (obj, "onChange", false);
   result->onChangeThreshold = json_object_get_number (obj, "onChangeThreshold");
+  result->onChangeThresholdPercent = json_object_get_number (obj, "onChangeThresholdPercent");
   result->interval = get_string  (obj, "interval");
   result->impl = NULL;
   result->next = NULL;
@@ -425,6 +427,10 @@ static JSON_Value *autoevents_write (const edgex_device_autoevents *e)
     json_object_set_string (pobj, "interval", ae->interval);
     json_object_set_boolean (pobj, "onChange", ae->onChange);
     json_object_set_number (pobj, "onChangeThreshold", ae->onChangeThreshold);
+    if (ae->onChangeThresholdPercent > 0.0)
+    {
+      json_object_set_number (pobj, "onChangeThresholdPercent", ae->onChangeThresholdPercent);
+    }
     json_array_append_value (arr, pval);
   }
   return result;
@@ -442,6 +448,7 @@ static edgex_device_autoevents *autoevents_dup
     elem->interval = strdup (e->interval);
     elem->onChange = e->onChange;
     elem->onChangeThreshold = e->onChangeThreshold;
+    elem->onChangeThresholdPercent = e->onChangeThresholdPercent;
     elem->impl = NULL;
     elem->next = NULL;
     *current = elem;
@@ -896,16 +903,20 @@ char *edgex_updateDevOpreq_write (const char *name, edgex_device_operatingstate
   return json;
 }
 
-char *edgex_updateDevLCreq_write (const char *name, uint64_t lastconnected)
+char *edgex_updateDevLCreq_write (const char **names, const uint64_t *lastconnected, unsigned n)
 {
   char *json;
-  JSON_Value *val;
-  JSON_Value *jval = json_value_init_object ();
-  JSON_Object *obj = json_value_get_object (jval);
+  JSON_Value *val = json_value_init_array ();
+  JSON_Array *array = json_value_get_array (val);
 
-  json_object_set_string (obj, "name", name);
-  json_object_set_uint (obj, "lastConnected", lastconnected);
-  val = edgex_wrap_request ("Device", jval);
+  for (unsigned i = 0; i < n; i++)
+  {
+    JSON_Value *jval = json_value_init_object ();
+    JSON_Object *obj = json_value_get_object (jval);
+    json_object_set_string (obj, "name", names[i]);
+    json_object_set_uint (obj, "lastConnected", lastconnected[i]);
+    json_array_append_value (array, edgex_wrap_request_single ("Device", jval));
+  }
   json = json_serialize_to_string (val);
   json_value_free (val);
 
@@ -62,7 +62,7 @@ edgex_deviceservice *edgex_getDSresponse_read (const char *json);
 
 char *edgex_createdevicereq_write (const edgex_device *dev);
 char *edgex_updateDevOpreq_write (const char *name, edgex_device_operatingstate opstate);
-char *edgex_updateDevLCreq_write (const char *name, uint64_t lastconnected);
+char *edgex_updateDevLCreq_write (const char **names, const uint64_t *lastconnected, unsigned n);
 
 
 #endif
@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "encoder.h"
+#include "b64.h"
+#include <inttypes.h>
+#include <stdarg.h>
+
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+#define CBOR_FALSE 0xf4
+#define CBOR_TRUE 0xf5
+#define CBOR_NULL 0xf6
+#define CBOR_FLOAT32 0xfa
+#define CBOR_FLOAT64 0xfb
+
+#define EDGEX_ENC_MINSIZE 256
+
+void edgex_enc_init (edgex_encoder *enc, bool cbor, size_t hint)
+{
+  enc->size = hint > EDGEX_ENC_MINSIZE ? hint : EDGEX_ENC_MINSIZE;
+  enc->data = malloc (enc->size);
+  enc->len = 0;
+  enc->cbor = cbor;
+  enc->sep = false;
+}
+
+void edgex_enc_fini (edgex_encoder *enc)
+{
+  free (enc->data);
+  enc->data = NULL;
+  enc->len = enc->size = 0;
+}
+
+void edgex_enc_reserve (edgex_encoder *enc, size_t n)
+{
+  // One extra byte is always kept spare for the JSON terminator
+  if (enc->len + n >= enc->size)
+  {
+    size_t newsize = enc->size ? enc->size : EDGEX_ENC_MINSIZE;
+    while (enc->len + n >= newsize)
+    {
+      newsize *= 2;
+    }
+    enc->data = realloc (enc->data, newsize);
+    enc->size = newsize;
+  }
+}
+
+void *edgex_enc_take (edgex_encoder *enc, size_t *len)
+{
+  void *result = enc->data;
+  if (!enc->cbor)
+  {
+    enc->data[enc->len] = '\0';
+  }
+  *len = enc->len;
+  enc->data = NULL;
+  enc->len = enc->size = 0;
+  return result;
+}
+
+iot_data_t *edgex_enc_take_data (edgex_encoder *enc)
+{
+  size_t len;
+  void *data = edgex_enc_take (enc, &len);
+  return iot_data_alloc_binary (data, len, IOT_DATA_TAKE);
+}
+
+static inline void edgex_enc_byte (edgex_encoder *enc, uint8_t b)
+{
+  edgex_enc_reserve (enc, 1);
+  enc->data[enc->len++] = b;
+}
+
+void edgex_enc_raw (edgex_encoder *enc, const void *data, size_t len)
+{
+  edgex_enc_reserve (enc, len);
+  memcpy (enc->data + enc->len, data, len);
+  enc->len += len;
+}
+
+static void edgex_enc_cbor_head (edgex_encoder *enc, uint8_t major, uint64_t val)
+{
+  uint8_t *p;
+  edgex_enc_reserve (enc, 9);
+  p = enc->data + enc->len;
+  major <<= 5;
+  if (val < 24)
+  {
+    p[0] = major | (uint8_t)val;
+    enc->len += 1;
+  }
+  else if (val <= UINT8_MAX)
+  {
+    p[0] = major | 24;
+    p[1] = (uint8_t)val;
+    enc->len += 2;
+  }
+  else if (val <= UINT16_MAX)
+  {
+    p[0] = major | 25;
+    p[1] = (uint8_t)(val >> 8);
+    p[2] = (uint8_t)val;
+    enc->len += 3;
+  }
+  else if (val <= UINT32_MAX)
+  {
+    p[0] = major | 26;
+    for (int i = 0; i < 4; i++)
+    {
+      p[4 - i] = (uint8_t)(val >> (8 * i));
+    }
+    enc->len += 5;
+  }
+  else
+  {
+    p[0] = major | 27;
+    for (int i = 0; i < 8; i++)
+    {
+      p[8 - i] = (uint8_t)(val >> (8 * i));
+    }
+    enc->len += 9;
+  }
+}
+
+/* JSON separators: a comma is due before the next key or array element once
+   a value has been written at the current level. */
+
+static inline void edgex_enc_value_start (edgex_encoder *enc)
+{
+  if (!enc->cbor && enc->sep)
+  {
+    edgex_enc_byte (enc, ',');
+  }
+}
+
+static void edgex_enc_json_escaped (edgex_encoder *enc, const char *str, size_t len)
+{
+  static const char hex[] = "0123456789abcdef";
+  edgex_enc_reserve (enc, len + 2);
+  enc->data[enc->len++] = '"';
+  for (size_t i = 0; i < len; i++)
+  {
+    uint8_t c = (uint8_t)str[i];
+    if (c >= 0x20 && c != '"' && c != '\\')
+    {
+      edgex_enc_byte (enc, c);
+      continue;
+    }
+    edgex_enc_reserve (enc, 6);
+    uint8_t *p = enc->data + enc->len;
+    p[0] = '\\';
+    enc->len += 2;
+    switch (c)
+    {
+      case '"': p[1] = '"'; break;
+      case '\\': p[1] = '\\'; break;
+      case '\b': p[1] = 'b'; break;
+      case '\f': p[1] = 'f'; break;
+      case '\n': p[1] = 'n'; break;
+      case '\r': p[1] = 'r'; break;
+      case '\t': p[1] = 't'; break;
+      default:
+        p[1] = 'u';
+        p[2] = '0';
+        p[3] = '0';
+        p[4] = hex[c >> 4];
+        p[5] = hex[c & 0xf];
+        enc->len += 4;
+    }
+  }
+  edgex_enc_byte (enc, '"');
+}
+
+void edgex_enc_map_start (edgex_encoder *enc, uint32_t n)
+{
+  edgex_enc_value_start (enc);
+  if (enc->cbor)
+  {
+    edgex_enc_cbor_head (enc, CBOR_MAP, n);
+  }
+  else
+  {
+    edgex_enc_byte (enc, '{');
+    enc->sep = false;
+  }
+}
+
+void edgex_enc_map_end (edgex_encoder *enc)
+{
+  if (!enc->cbor)
+  {
+    edgex_enc_byte (enc, '}');
+    enc->sep = true;
+  }
+}
+
+void edgex_enc_array_start (edgex_encoder *enc, uint32_t n)
+{
+  edgex_enc_value_start (enc);
+  if (enc->cbor)
+  {
+    edgex_enc_cbor_head (enc, CBOR_ARRAY, n);
+  }
+  else
+  {
+    edgex_enc_byte (enc, '[');
+    enc->sep = false;
+  }
+}
+
+void edgex_enc_array_end (edgex_encoder *enc)
+{
+  if (!enc->cbor)
+  {
+    edgex_enc_byte (enc, ']');
+    enc->sep = true;
+  }
+}
+
+void edgex_enc_key (edgex_encoder *enc, const char *key)
+{
+  size_t len = strlen (key);
+  if (enc->cbor)
+  {
+    edgex_enc_cbor_head (enc, CBOR_TEXT, len);
+    edgex_enc_raw (enc, key, len);
+  }
+  else
+  {
+    edgex_enc_value_start (enc);
+    edgex_enc_json_escaped (enc, key, len);
+    edgex_enc_byte (enc, ':');
+    enc->sep = false;
+  }
+}
+
+void edgex_enc_string_len (edgex_encoder *enc, const char *str, size_t len)
+{
+  if (enc->cbor)
+  {
+    edgex_enc_cbor_head (enc, CBOR_TEXT, len);
+    edgex_enc_raw (enc, str, len);
+  }
+  else
+  {
+    edgex_enc_value_start (enc);
+    edgex_enc_json_escaped (enc, str, len);
+    enc->sep = true;
+  }
+}
+
+void edgex_enc_string (edgex_encoder *enc, const char *str)
+{
+  edgex_enc_string_len (enc, str, strlen (str));
+}
+
+/* Scalars are formatted as iot_data_to_json does */
+
+static inline void edgex_enc_json_number (edgex_encoder *enc, const char *fmt, ...)
+{
+  va_list args;
+  edgex_enc_value_start (enc);
+  edgex_enc_reserve (enc, 40);
+  va_start (args, fmt);
+  enc->len += vsnprintf ((char *)enc->data + enc->len, enc->size - enc->len, fmt, args);
+  va_end (args);
+  enc->sep = true;
+}
+
+void edgex_enc_uint (edgex_encoder *enc, uint64_t val)
+{
+  if (enc->cbor)
+  {
+    edgex_enc_cbor_head (enc, CBOR_UINT, val);
+  }
+  else
+  {
+    edgex_enc_json_number (enc, "%" PRIu64, val);
+  }
+}
+
+void edgex_enc_int (edgex_encoder *enc, int64_t val)
+{
+  if (enc->cbor)
+  {
+    if (val < 0)
+    {
+      edgex_enc_cbor_head (enc, CBOR_NEGINT, (uint64_t)(-(val + 1)));
+    }
+    else
+    {
+      edgex_enc_cbor_head (enc, CBOR_UINT, (uint64_t)val);
+    }
+  }
+  else
+  {
+    edgex_enc_json_number (enc, "%" PRId64, val);
+  }
+}
+
+void edgex_enc_f32 (edgex_encoder *enc, float val)
+{
+  if (enc->cbor)
+  {
+    uint32_t bits;
+    memcpy (&bits, &val, sizeof (bits));
+    edgex_enc_reserve (enc, 5);
+    enc->data[enc->len++] = CBOR_FLOAT32;
+    for (int i = 3; i >= 0; i--)
+    {
+      enc->data[enc->len++] = (uint8_t)(bits >> (8 * i));
+    }
+  }
+  else
+  {
+    edgex_enc_json_number (enc, "%.8e", val);
+  }
+}
+
+void edgex_enc_f64 (edgex_encoder *enc, double val)
+{
+  if (enc->cbor)
+  {
+    uint64_t bits;
+    memcpy (&bits, &val, sizeof (bits));
+    edgex_enc_reserve (enc, 9);
+    enc->data[enc->len++] = CBOR_FLOAT64;
+    for (int i = 7; i >= 0; i--)
+    {
+      enc->data[enc->len++] = (uint8_t)(bits >> (8 * i));
+    }
+  }
+  else
+  {
+    edgex_enc_json_number (enc, "%.16e", val);
+  }
+}
+
+void edgex_enc_bool (edgex_encoder *enc, bool val)
+{
+  if (enc->cbor)
+  {
+    edgex_enc_byte (enc, val ? CBOR_TRUE : CBOR_FALSE);
+  }
+  else
+  {
+    edgex_enc_value_start (enc);
+    edgex_enc_raw (enc, val ? "true" : "false", val ? 4 : 5);
+    enc->sep = true;
+  }
+}
+
+void edgex_enc_null (edgex_encoder *enc)
+{
+  if (enc->cbor)
+  {
+    edgex_enc_byte (enc, CBOR_NULL);
+  }
+  else
+  {
+    edgex_enc_value_start (enc);
+    edgex_enc_raw (enc, "null", 4);
+    enc->sep = true;
+  }
+}
+
+static void edgex_enc_base64 (edgex_encoder *enc, const void *data, size_t len)
+{
+  size_t enclen = EDGEX_B64_ENCLEN (len);
+  if (enc->cbor)
+  {
+    edgex_enc_cbor_head (enc, CBOR_TEXT, enclen);
+  }
+  else
+  {
+    edgex_enc_value_start (enc);
+    edgex_enc_byte (enc, '"');
+  }
+  edgex_enc_reserve (enc, enclen);
+  edgex_b64_encode (data, len, (char *)enc->data + enc->len);
+  enc->len += enclen;
+  if (!enc->cbor)
+  {
+    edgex_enc_byte (enc, '"');
+    enc->sep = true;
+  }
+}
+
+void edgex_enc_bytes (edgex_encoder *enc, const void *data, size_t len)
+{
+  if (enc->cbor)
+  {
+    edgex_enc_cbor_head (enc, CBOR_BYTES, len);
+    edgex_enc_raw (enc, data, len);
+  }
+  else
+  {
+    edgex_enc_base64 (enc, data, len);
+  }
+}
+
+void edgex_enc_encoded (edgex_encoder *enc, const void *data, size_t len)
+{
+  edgex_enc_value_start (enc);
+  edgex_enc_raw (enc, data, len);
+  enc->sep = true;
+}
+
+/* Type-specialised writers for array elements, read from their packed
+   representation. */
+
+static void edgex_enc_element (edgex_encoder *enc, iot_data_type_t type, const uint8_t *p)
+{
+  switch (type)
+  {
+    case IOT_DATA_INT8: { int8_t v; memcpy (&v, p, sizeof (v)); edgex_enc_int (enc, v); break; }
+    case IOT_DATA_UINT8: { uint8_t v; memcpy (&v, p, sizeof (v)); edgex_enc_uint (enc, v); break; }
+    case IOT_DATA_INT16: { int16_t v; memcpy (&v, p, sizeof (v)); edgex_enc_int (enc, v); break; }
+    case IOT_DATA_UINT16: { uint16_t v; memcpy (&v, p, sizeof (v)); edgex_enc_uint (enc, v); break; }
+    case IOT_DATA_INT32: { int32_t v; memcpy (&v, p, sizeof (v)); edgex_enc_int (enc, v); break; }
+    case IOT_DATA_UINT32: { uint32_t v; memcpy (&v, p, sizeof (v)); edgex_enc_uint (enc, v); break; }
+    case IOT_DATA_INT64: { int64_t v; memcpy (&v, p, sizeof (v)); edgex_enc_int (enc, v); break; }
+    case IOT_DATA_UINT64: { uint64_t v; memcpy (&v, p, sizeof (v)); edgex_enc_uint (enc, v); break; }
+    case IOT_DATA_FLOAT32: { float v; memcpy (&v, p, sizeof (v)); edgex_enc_f32 (enc, v); break; }
+    case IOT_DATA_FLOAT64: { double v; memcpy (&v, p, sizeof (v)); edgex_enc_f64 (enc, v); break; }
+    case IOT_DATA_BOOL: { bool v; memcpy (&v, p, sizeof (v)); edgex_enc_bool (enc, v); break; }
+    default: edgex_enc_null (enc);
+  }
+}
+
+static void edgex_enc_array (edgex_encoder *enc, const iot_data_t *array)
+{
+  iot_data_type_t etype = iot_data_array_type (array);
+  uint32_t n = iot_data_array_length (array);
+  size_t esize = iot_data_type_size (etype);
+  const uint8_t *p = iot_data_address (array);
+
+  edgex_enc_array_start (enc, n);
+  for (uint32_t i = 0; i < n; i++, p += esize)
+  {
+    edgex_enc_element (enc, etype, p);
+  }
+  edgex_enc_array_end (enc);
+}
+
+void edgex_enc_data (edgex_encoder *enc, const iot_data_t *data)
+{
+  if (data == NULL)
+  {
+    edgex_enc_null (enc);
+    return;
+  }
+  switch (iot_data_type (data))
+  {
+    case IOT_DATA_INT8: edgex_enc_int (enc, iot_data_i8 (data)); break;
+    case IOT_DATA_UINT8: edgex_enc_uint (enc, iot_data_ui8 (data)); break;
+    case IOT_DATA_INT16: edgex_enc_int (enc, iot_data_i16 (data)); break;
+    case IOT_DATA_UINT16: edgex_enc_uint (enc, iot_data_ui16 (data)); break;
+    case IOT_DATA_INT32: edgex_enc_int (enc, iot_data_i32 (data)); break;
+    case IOT_DATA_UINT32: edgex_enc_uint (enc, iot_data_ui32 (data)); break;
+    case IOT_DATA_INT64: edgex_enc_int (enc, iot_data_i64 (data)); break;
+    case IOT_DATA_UINT64: edgex_enc_uint (enc, iot_data_ui64 (data)); break;
+    case IOT_DATA_FLOAT32: edgex_enc_f32 (enc, iot_data_f32 (data)); break;
+    case IOT_DATA_FLOAT64: edgex_enc_f64 (enc, iot_data_f64 (data)); break;
+    case IOT_DATA_BOOL: edgex_enc_bool (enc, iot_data_bool (data)); break;
+    case IOT_DATA_STRING: edgex_enc_string (enc, iot_data_string (data)); break;
+    case IOT_DATA_BINARY: edgex_enc_bytes (enc, iot_data_address (data), iot_data_array_size (data)); break;
+    case IOT_DATA_ARRAY: edgex_enc_array (enc, data); break;
+    case IOT_DATA_MAP:
+    {
+      iot_data_map_iter_t iter;
+      edgex_enc_map_start (enc, iot_data_map_size (data));
+      iot_data_map_iter (data, &iter);
+      while (iot_data_map_iter_next (&iter))
+      {
+        const iot_data_t *key = iot_data_map_iter_key (&iter);
+        if (iot_data_type (key) == IOT_DATA_STRING)
+        {
+          edgex_enc_key (enc, iot_data_string (key));
+        }
+        else
+        {
+          // Non-string keys are written as their JSON representation
+          edgex_encoder kenc;
+          edgex_enc_init (&kenc, false, 0);
+          edgex_enc_data (&kenc, key);
+          kenc.data[kenc.len] = '\0';
+          edgex_enc_key (enc, (const char *)kenc.data);
+          edgex_enc_fini (&kenc);
+        }
+        edgex_enc_data (enc, iot_data_map_iter_value (&iter));
+      }
+      edgex_enc_map_end (enc);
+      break;
+    }
+    case IOT_DATA_VECTOR:
+    {
+      iot_data_vector_iter_t iter;
+      edgex_enc_array_start (enc, iot_data_vector_size (data));
+      iot_data_vector_iter (data, &iter);
+      while (iot_data_vector_iter_next (&iter))
+      {
+        edgex_enc_data (enc, iot_data_vector_iter_value (&iter));
+      }
+      edgex_enc_array_end (enc);
+      break;
+    }
+    case IOT_DATA_LIST:
+    {
+      iot_data_list_iter_t iter;
+      edgex_enc_array_start (enc, iot_data_list_length (data));
+      iot_data_list_iter (data, &iter);
+      while (iot_data_list_iter_next (&iter))
+      {
+        edgex_enc_data (enc, iot_data_list_iter_value (&iter));
+      }
+      edgex_enc_array_end (enc);
+      break;
+    }
+    default:
+      edgex_enc_null (enc);
+  }
+}
+
+void edgex_enc_data_as_string (edgex_encoder *enc, const iot_data_t *data)
+{
+  char buff[48];
+  int len;
+
+  switch (iot_data_type (data))
+  {
+    case IOT_DATA_STRING:
+      edgex_enc_string (enc, iot_data_string (data));
+      return;
+    case IOT_DATA_BINARY:
+      edgex_enc_base64 (enc, iot_data_address (data), iot_data_array_size (data));
+      return;
+    case IOT_DATA_INT8: len = sprintf (buff, "%" PRId8, iot_data_i8 (data)); break;
+    case IOT_DATA_UINT8: len = sprintf (buff, "%" PRIu8, iot_data_ui8 (data)); break;
+    case IOT_DATA_INT16: len = sprintf (buff, "%" PRId16, iot_data_i16 (data)); break;
+    case IOT_DATA_UINT16: len = sprintf (buff, "%" PRIu16, iot_data_ui16 (data)); break;
+    case IOT_DATA_INT32: len = sprintf (buff, "%" PRId32, iot_data_i32 (data)); break;
+    case IOT_DATA_UINT32: len = sprintf (buff, "%" PRIu32, iot_data_ui32 (data)); break;
+    case IOT_DATA_INT64: len = sprintf (buff, "%" PRId64, iot_data_i64 (data)); break;
+    case IOT_DATA_UINT64: len = sprintf (buff, "%" PRIu64, iot_data_ui64 (data)); break;
+    case IOT_DATA_FLOAT32: len = sprintf (buff, "%.8e", iot_data_f32 (data)); break;
+    case IOT_DATA_FLOAT64: len = sprintf (buff, "%.16e", iot_data_f64 (data)); break;
+    case IOT_DATA_BOOL: len = sprintf (buff, "%s", iot_data_bool (data) ? "true" : "false"); break;
+    case IOT_DATA_ARRAY:
+      if (!enc->cbor)
+      {
+        // Numeric array text needs no escaping, so can be written in place
+        edgex_enc_value_start (enc);
+        edgex_enc_byte (enc, '"');
+        enc->sep = false;
+        edgex_enc_array (enc, data);
+        edgex_enc_byte (enc, '"');
+        enc->sep = true;
+        return;
+      }
+      /* fall through */
+    default:
+    {
+      edgex_encoder tmp;
+      edgex_enc_init (&tmp, false, 0);
+      edgex_enc_data (&tmp, data);
+      edgex_enc_string_len (enc, (const char *)tmp.data, tmp.len);
+      edgex_enc_fini (&tmp);
+      return;
+    }
+  }
+  edgex_enc_string_len (enc, buff, len);
+}
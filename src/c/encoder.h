@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_ENCODER_H_
+#define _EDGEX_ENCODER_H_ 1
+
+#include <iot/data.h>
+
+/* Streaming JSON / CBOR writer. Values are written straight into a growable
+ * byte buffer, so messages whose structure is known in advance can be
+ * produced without first building an iot_data tree.
+ *
+ * Maps and arrays are bracketed by start / end calls. CBOR requires the
+ * number of members to be given up front; JSON ignores it. Within a map,
+ * each value is preceded by a call to edgex_enc_key.
+ */
+
+typedef struct edgex_encoder
+{
+  uint8_t *data;
+  size_t len;
+  size_t size;
+  bool cbor;
+  bool sep;
+} edgex_encoder;
+
+void edgex_enc_init (edgex_encoder *enc, bool cbor, size_t hint);
+void edgex_enc_fini (edgex_encoder *enc);
+
+/* Returns the encoded data as an IOT_DATA_BINARY, leaving the encoder empty */
+iot_data_t *edgex_enc_take_data (edgex_encoder *enc);
+
+/* Returns the encoded data as a malloc'd buffer. JSON output is
+   nul-terminated, the terminator is not counted in *len. */
+void *edgex_enc_take (edgex_encoder *enc, size_t *len);
+
+void edgex_enc_reserve (edgex_encoder *enc, size_t n);
+void edgex_enc_raw (edgex_encoder *enc, const void *data, size_t len);
+
+void edgex_enc_map_start (edgex_encoder *enc, uint32_t n);
+void edgex_enc_map_end (edgex_encoder *enc);
+void edgex_enc_array_start (edgex_encoder *enc, uint32_t n);
+void edgex_enc_array_end (edgex_encoder *enc);
+void edgex_enc_key (edgex_encoder *enc, const char *key);
+
+void edgex_enc_string (edgex_encoder *enc, const char *str);
+void edgex_enc_string_len (edgex_encoder *enc, const char *str, size_t len);
+void edgex_enc_uint (edgex_encoder *enc, uint64_t val);
+void edgex_enc_int (edgex_encoder *enc, int64_t val);
+void edgex_enc_f32 (edgex_encoder *enc, float val);
+void edgex_enc_f64 (edgex_encoder *enc, double val);
+void edgex_enc_bool (edgex_encoder *enc, bool val);
+void edgex_enc_null (edgex_encoder *enc);
+void edgex_enc_bytes (edgex_encoder *enc, const void *data, size_t len);
+
+/* Splice an already-encoded value, which must be in the encoder's format */
+void edgex_enc_encoded (edgex_encoder *enc, const void *data, size_t len);
+
+/* Write any iot_data value, as iot_data_to_json / iot_data_to_cbor would */
+void edgex_enc_data (edgex_encoder *enc, const iot_data_t *data);
+
+/* Write the JSON text for a value (as iot_data_to_json would produce) as a
+   string. Strings are written as-is, binary data as base64. */
+void edgex_enc_data_as_string (edgex_encoder *enc, const iot_data_t *data);
+
+#endif
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "eventq.h"
+#include "correlation.h"
+#include <iot/time.h>
+
+#define EDGEX_EVQ_INITSIZE 64
+
+typedef struct edgex_eventq_entry
+{
+  edgex_event_cooked *event;
+  char *crlid;
+  uint64_t queued;
+} edgex_eventq_entry;
+
+struct edgex_eventq_t
+{
+  iot_logger_t *lc;
+  edgex_bus_t *bus;
+  devsdk_metrics_t *metrics;
+  edgex_eventq_entry *ring;
+  uint32_t size;
+  uint32_t head;
+  uint32_t count;
+  uint32_t maxlen;
+  edgex_eventq_policy policy;
+  bool running;
+  bool stopped;
+  pthread_mutex_t mtx;
+  pthread_cond_t notempty;
+  pthread_cond_t notfull;
+  pthread_cond_t done;
+};
+
+edgex_eventq_policy edgex_eventq_policy_fromstring (const char *str)
+{
+  if (str && strcasecmp (str, "DropOldest") == 0)
+  {
+    return EDGEX_EVQ_DROP_OLDEST;
+  }
+  if (str && strcasecmp (str, "DropNewest") == 0)
+  {
+    return EDGEX_EVQ_DROP_NEWEST;
+  }
+  return EDGEX_EVQ_BLOCK;
+}
+
+edgex_eventq_t *edgex_eventq_alloc
+  (iot_logger_t *lc, edgex_bus_t *bus, devsdk_metrics_t *metrics, uint32_t maxlen, edgex_eventq_policy policy)
+{
+  edgex_eventq_t *q = calloc (1, sizeof (edgex_eventq_t));
+  q->lc = lc;
+  q->bus = bus;
+  q->metrics = metrics;
+  q->maxlen = maxlen;
+  q->policy = policy;
+  q->size = (maxlen && maxlen < EDGEX_EVQ_INITSIZE) ? maxlen : EDGEX_EVQ_INITSIZE;
+  q->ring = malloc (q->size * sizeof (edgex_eventq_entry));
+  pthread_mutex_init (&q->mtx, NULL);
+  pthread_cond_init (&q->notempty, NULL);
+  pthread_cond_init (&q->notfull, NULL);
+  pthread_cond_init (&q->done, NULL);
+  return q;
+}
+
+static void edgex_eventq_entry_publish (edgex_eventq_t *q, edgex_eventq_entry *entry)
+{
+  if (entry->crlid)
+  {
+    edgex_device_alloc_crlid (entry->crlid);
+  }
+  edgex_data_client_publish (q->bus, entry->event, q->metrics);
+  if (entry->crlid)
+  {
+    edgex_device_free_crlid ();
+  }
+
+  uint64_t latency = iot_time_nsecs () - entry->queued;
+  uint64_t max = atomic_load (&q->metrics->evqlatmax);
+  while (latency > max && !atomic_compare_exchange_weak (&q->metrics->evqlatmax, &max, latency));
+  atomic_fetch_add (&q->metrics->evqlatsum, latency);
+  atomic_fetch_add (&q->metrics->evqlatcount, 1);
+}
+
+static void edgex_eventq_entry_free (edgex_eventq_entry *entry)
+{
+  edgex_event_cooked_free (entry->event);
+  free (entry->crlid);
+}
+
+static void *edgex_eventq_run (void *p)
+{
+  edgex_eventq_t *q = (edgex_eventq_t *)p;
+  edgex_eventq_entry entry;
+
+  pthread_mutex_lock (&q->mtx);
+  while (true)
+  {
+    while (q->count == 0 && q->running)
+    {
+      pthread_cond_wait (&q->notempty, &q->mtx);
+    }
+    if (q->count == 0)
+    {
+      break;
+    }
+    entry = q->ring[q->head];
+    q->head = (q->head + 1) % q->size;
+    q->count--;
+    pthread_cond_signal (&q->notfull);
+    pthread_mutex_unlock (&q->mtx);
+
+    edgex_eventq_entry_publish (q, &entry);
+    edgex_eventq_entry_free (&entry);
+
+    pthread_mutex_lock (&q->mtx);
+  }
+  q->stopped = true;
+  pthread_cond_broadcast (&q->done);
+  pthread_mutex_unlock (&q->mtx);
+  return NULL;
+}
+
+void edgex_eventq_start (edgex_eventq_t *q, iot_threadpool_t *pool)
+{
+  pthread_mutex_lock (&q->mtx);
+  q->running = true;
+  q->stopped = false;
+  pthread_mutex_unlock (&q->mtx);
+  if (!iot_threadpool_add_work (pool, edgex_eventq_run, q, IOT_THREAD_NO_PRIORITY))
+  {
+    iot_log_error (q->lc, "Unable to start event queue, events will be published synchronously");
+    pthread_mutex_lock (&q->mtx);
+    q->running = false;
+    q->stopped = true;
+    pthread_mutex_unlock (&q->mtx);
+  }
+}
+
+static void edgex_eventq_grow (edgex_eventq_t *q)
+{
+  uint32_t oldsize = q->size;
+  q->size *= 2;
+  q->ring = realloc (q->ring, q->size * sizeof (edgex_eventq_entry));
+  if (q->head + q->count > oldsize)
+  {
+    // Move entries which had wrapped around to follow on from the old end
+    memcpy (&q->ring[oldsize], q->ring, (q->head + q->count - oldsize) * sizeof (edgex_eventq_entry));
+  }
+}
+
+void edgex_eventq_push (edgex_eventq_t *q, edgex_event_cooked *ev)
+{
+  edgex_eventq_entry entry;
+  const char *crlid = edgex_device_get_crlid ();
+
+  entry.event = edgex_event_cooked_add_ref (ev);
+  entry.crlid = crlid ? strdup (crlid) : NULL;
+  entry.queued = iot_time_nsecs ();
+
+  pthread_mutex_lock (&q->mtx);
+  if (q->running && q->maxlen && q->count >= q->maxlen)
+  {
+    switch (q->policy)
+    {
+      case EDGEX_EVQ_BLOCK:
+        while (q->running && q->count >= q->maxlen)
+        {
+          pthread_cond_wait (&q->notfull, &q->mtx);
+        }
+        break;
+      case EDGEX_EVQ_DROP_OLDEST:
+      {
+        edgex_eventq_entry *oldest = &q->ring[q->head];
+        iot_log_debug (q->lc, "Event queue full, discarding oldest event %s", iot_data_string (oldest->event->path));
+        edgex_eventq_entry_free (oldest);
+        q->head = (q->head + 1) % q->size;
+        q->count--;
+        atomic_fetch_add (&q->metrics->evqdrop, 1);
+        break;
+      }
+      case EDGEX_EVQ_DROP_NEWEST:
+        pthread_mutex_unlock (&q->mtx);
+        iot_log_debug (q->lc, "Event queue full, discarding event %s", iot_data_string (ev->path));
+        edgex_eventq_entry_free (&entry);
+        atomic_fetch_add (&q->metrics->evqdrop, 1);
+        return;
+    }
+  }
+  if (!q->running)
+  {
+    pthread_mutex_unlock (&q->mtx);
+    // Publishing on the caller's thread, where the correlation id is already set
+    free (entry.crlid);
+    entry.crlid = NULL;
+    edgex_eventq_entry_publish (q, &entry);
+    edgex_eventq_entry_free (&entry);
+    return;
+  }
+  if (q->count == q->size)
+  {
+    edgex_eventq_grow (q);
+  }
+  q->ring[(q->head + q->count) % q->size] = entry;
+  q->count++;
+  pthread_cond_signal (&q->notempty);
+  pthread_mutex_unlock (&q->mtx);
+}
+
+uint32_t edgex_eventq_depth (edgex_eventq_t *q)
+{
+  pthread_mutex_lock (&q->mtx);
+  uint32_t result = q->count;
+  pthread_mutex_unlock (&q->mtx);
+  return result;
+}
+
+void edgex_eventq_stop (edgex_eventq_t *q)
+{
+  pthread_mutex_lock (&q->mtx);
+  if (q->running)
+  {
+    q->running = false;
+    pthread_cond_broadcast (&q->notempty);
+    pthread_cond_broadcast (&q->notfull);
+    while (!q->stopped)
+    {
+      pthread_cond_wait (&q->done, &q->mtx);
+    }
+  }
+  pthread_mutex_unlock (&q->mtx);
+}
+
+void edgex_eventq_free (edgex_eventq_t *q)
+{
+  if (q)
+  {
+    edgex_eventq_stop (q);
+    free (q->ring);
+    pthread_cond_destroy (&q->done);
+    pthread_cond_destroy (&q->notfull);
+    pthread_cond_destroy (&q->notempty);
+    pthread_mutex_destroy (&q->mtx);
+    free (q);
+  }
+}
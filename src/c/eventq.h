@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_EVENTQ_H_
+#define _EDGEX_EVENTQ_H_ 1
+
+#include "data.h"
+
+/* Bounded queue of events awaiting publication. Events are encoded and
+ * published on a single thread taken from the given pool, so that callers
+ * are not held up by the message bus. When the queue is full, the overflow
+ * policy determines whether callers wait, or an event is discarded.
+ */
+
+typedef enum
+{
+  EDGEX_EVQ_BLOCK,
+  EDGEX_EVQ_DROP_OLDEST,
+  EDGEX_EVQ_DROP_NEWEST
+} edgex_eventq_policy;
+
+typedef struct edgex_eventq_t edgex_eventq_t;
+
+edgex_eventq_policy edgex_eventq_policy_fromstring (const char *str);
+
+/* maxlen of zero means unbounded */
+edgex_eventq_t *edgex_eventq_alloc
+  (iot_logger_t *lc, edgex_bus_t *bus, devsdk_metrics_t *metrics, uint32_t maxlen, edgex_eventq_policy policy);
+
+void edgex_eventq_start (edgex_eventq_t *q, iot_threadpool_t *pool);
+
+/* Takes a reference to the event. If the queue is not running, the event is
+   published immediately. */
+void edgex_eventq_push (edgex_eventq_t *q, edgex_event_cooked *ev);
+
+uint32_t edgex_eventq_depth (edgex_eventq_t *q);
+
+/* Publishes any queued events, then stops the publishing thread */
+void edgex_eventq_stop (edgex_eventq_t *q);
+
+void edgex_eventq_free (edgex_eventq_t *q);
+
+#endif
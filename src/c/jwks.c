@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "jwks.h"
+
+#ifdef CSDK_HAVE_OPENSSL
+
+#include "b64.h"
+#include "parson.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+typedef enum { JWKS_RSA, JWKS_EC, JWKS_ED25519 } jwks_kind;
+
+typedef struct jwks_key_t
+{
+  char *kid;
+  jwks_kind kind;
+  size_t clen;
+  EVP_PKEY *pkey;
+} jwks_key_t;
+
+struct edgex_jwks_t
+{
+  iot_logger_t *lc;
+  jwks_key_t *keys;
+  unsigned nkeys;
+  pthread_rwlock_t lock;
+};
+
+typedef struct jwks_alg_t
+{
+  const char *name;
+  jwks_kind kind;
+  size_t clen;
+  const EVP_MD *(*md) (void);
+} jwks_alg_t;
+
+static const jwks_alg_t jwks_algs[] =
+{
+  { "RS256", JWKS_RSA, 0, EVP_sha256 },
+  { "RS384", JWKS_RSA, 0, EVP_sha384 },
+  { "RS512", JWKS_RSA, 0, EVP_sha512 },
+  { "ES256", JWKS_EC, 32, EVP_sha256 },
+  { "ES384", JWKS_EC, 48, EVP_sha384 },
+  { "ES512", JWKS_EC, 66, EVP_sha512 },
+  { "EdDSA", JWKS_ED25519, 0, NULL },
+  { NULL, 0, 0, NULL }
+};
+
+/* Minimal DER encoding, sufficient to express public keys as
+   SubjectPublicKeyInfo and ECDSA signatures as Ecdsa-Sig-Value */
+
+typedef struct jwks_buf
+{
+  uint8_t *data;
+  size_t len;
+} jwks_buf;
+
+static const uint8_t oid_rsa[] = { 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00 };
+static const uint8_t oid_ec[] = { 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01 };
+static const uint8_t oid_p256[] = { 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07 };
+static const uint8_t oid_p384[] = { 0x06, 0x05, 0x2b, 0x81, 0x04, 0x00, 0x22 };
+static const uint8_t oid_p521[] = { 0x06, 0x05, 0x2b, 0x81, 0x04, 0x00, 0x23 };
+static const uint8_t oid_ed25519[] = { 0x06, 0x03, 0x2b, 0x65, 0x70 };
+
+static void der_append (jwks_buf *b, const void *data, size_t len)
+{
+  b->data = realloc (b->data, b->len + len);
+  memcpy (b->data + b->len, data, len);
+  b->len += len;
+}
+
+static void der_tlv (jwks_buf *b, uint8_t tag, const void *content, size_t len)
+{
+  uint8_t hdr[5];
+  size_t n = 0;
+  hdr[n++] = tag;
+  if (len < 0x80)
+  {
+    hdr[n++] = len;
+  }
+  else if (len < 0x100)
+  {
+    hdr[n++] = 0x81;
+    hdr[n++] = len;
+  }
+  else if (len < 0x10000)
+  {
+    hdr[n++] = 0x82;
+    hdr[n++] = len >> 8;
+    hdr[n++] = len;
+  }
+  else
+  {
+    hdr[n++] = 0x83;
+    hdr[n++] = len >> 16;
+    hdr[n++] = len >> 8;
+    hdr[n++] = len;
+  }
+  der_append (b, hdr, n);
+  der_append (b, content, len);
+}
+
+/* Replaces the contents of b with a TLV of the given tag enclosing them */
+
+static void der_wrap (jwks_buf *b, uint8_t tag)
+{
+  jwks_buf inner = *b;
+  b->data = NULL;
+  b->len = 0;
+  der_tlv (b, tag, inner.data, inner.len);
+  free (inner.data);
+}
+
+/* Unsigned big-endian integer, as a minimal positive INTEGER */
+
+static void der_uint (jwks_buf *b, const uint8_t *v, size_t len)
+{
+  while (len > 1 && *v == 0)
+  {
+    v++;
+    len--;
+  }
+  uint8_t *tmp = malloc (len + 1);
+  tmp[0] = 0;
+  memcpy (tmp + 1, v, len);
+  if (*v & 0x80)
+  {
+    der_tlv (b, 0x02, tmp, len + 1);
+  }
+  else
+  {
+    der_tlv (b, 0x02, tmp + 1, len);
+  }
+  free (tmp);
+}
+
+static void der_bitstring (jwks_buf *b, const jwks_buf *content)
+{
+  uint8_t *tmp = malloc (content->len + 1);
+  tmp[0] = 0;
+  memcpy (tmp + 1, content->data, content->len);
+  der_tlv (b, 0x03, tmp, content->len + 1);
+  free (tmp);
+}
+
+static uint8_t *jwks_decode (const char *in, size_t len, size_t *outlen)
+{
+  uint8_t *result = malloc (EDGEX_B64_MAXDECLEN (len) + 1);
+  if (!edgex_b64url_decode (in, len, result, outlen))
+  {
+    free (result);
+    result = NULL;
+  }
+  return result;
+}
+
+static JSON_Value *jwks_decode_json (const char *in, size_t len)
+{
+  JSON_Value *result = NULL;
+  size_t outlen;
+  char *json = (char *)jwks_decode (in, len, &outlen);
+  if (json)
+  {
+    json[outlen] = '\0';
+    result = json_parse_string (json);
+    free (json);
+  }
+  return result;
+}
+
+static bool jwks_append_member (jwks_buf *b, const JSON_Object *jwk, const char *name, bool integer)
+{
+  const char *str = json_object_get_string (jwk, name);
+  size_t len;
+  uint8_t *v = str ? jwks_decode (str, strlen (str), &len) : NULL;
+  if (v == NULL || len == 0)
+  {
+    free (v);
+    return false;
+  }
+  if (integer)
+  {
+    der_uint (b, v, len);
+  }
+  else
+  {
+    der_append (b, v, len);
+  }
+  free (v);
+  return true;
+}
+
+/* Builds a SubjectPublicKeyInfo for the key and loads it */
+
+static bool jwks_load_key (const JSON_Object *jwk, jwks_key_t *key)
+{
+  jwks_buf alg = { NULL, 0 };
+  jwks_buf pub = { NULL, 0 };
+  jwks_buf spki = { NULL, 0 };
+  const char *kty = json_object_get_string (jwk, "kty");
+  const char *crv = json_object_get_string (jwk, "crv");
+  bool ok = false;
+
+  if (kty && strcmp (kty, "RSA") == 0)
+  {
+    key->kind = JWKS_RSA;
+    der_append (&alg, oid_rsa, sizeof (oid_rsa));
+    ok = jwks_append_member (&pub, jwk, "n", true) && jwks_append_member (&pub, jwk, "e", true);
+    der_wrap (&pub, 0x30);
+  }
+  else if (kty && crv && strcmp (kty, "EC") == 0)
+  {
+    const uint8_t point = 0x04;
+    key->kind = JWKS_EC;
+    der_append (&alg, oid_ec, sizeof (oid_ec));
+    if (strcmp (crv, "P-256") == 0)
+    {
+      key->clen = 32;
+      der_append (&alg, oid_p256, sizeof (oid_p256));
+    }
+    else if (strcmp (crv, "P-384") == 0)
+    {
+      key->clen = 48;
+      der_append (&alg, oid_p384, sizeof (oid_p384));
+    }
+    else if (strcmp (crv, "P-521") == 0)
+    {
+      key->clen = 66;
+      der_append (&alg, oid_p521, sizeof (oid_p521));
+    }
+    der_append (&pub, &point, 1);
+    ok = key->clen && jwks_append_member (&pub, jwk, "x", false) && jwks_append_member (&pub, jwk, "y", false) && pub.len == 2 * key->clen + 1;
+  }
+  else if (kty && crv && strcmp (kty, "OKP") == 0 && strcmp (crv, "Ed25519") == 0)
+  {
+    key->kind = JWKS_ED25519;
+    der_append (&alg, oid_ed25519, sizeof (oid_ed25519));
+    ok = jwks_append_member (&pub, jwk, "x", false);
+  }
+
+  if (ok)
+  {
+    der_wrap (&alg, 0x30);
+    der_append (&spki, alg.data, alg.len);
+    der_bitstring (&spki, &pub);
+    der_wrap (&spki, 0x30);
+    const unsigned char *p = spki.data;
+    key->pkey = d2i_PUBKEY (NULL, &p, spki.len);
+    ok = (key->pkey != NULL);
+  }
+  free (alg.data);
+  free (pub.data);
+  free (spki.data);
+  return ok;
+}
+
+static void jwks_keys_free (jwks_key_t *keys, unsigned n)
+{
+  for (unsigned i = 0; i < n; i++)
+  {
+    free (keys[i].kid);
+    EVP_PKEY_free (keys[i].pkey);
+  }
+  free (keys);
+}
+
+bool edgex_jwks_available (void)
+{
+  return true;
+}
+
+edgex_jwks_t *edgex_jwks_alloc (iot_logger_t *lc)
+{
+  edgex_jwks_t *jwks = calloc (1, sizeof (edgex_jwks_t));
+  jwks->lc = lc;
+  pthread_rwlock_init (&jwks->lock, NULL);
+  return jwks;
+}
+
+bool edgex_jwks_update (edgex_jwks_t *jwks, const char *json)
+{
+  JSON_Value *val = json_parse_string (json);
+  JSON_Array *arr = json_object_get_array (json_value_get_object (val), "keys");
+  if (arr == NULL)
+  {
+    iot_log_error (jwks->lc, "jwks: key set does not parse");
+    json_value_free (val);
+    return false;
+  }
+
+  size_t n = json_array_get_count (arr);
+  jwks_key_t *keys = calloc (n ? n : 1, sizeof (jwks_key_t));
+  unsigned nkeys = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    const JSON_Object *jwk = json_array_get_object (arr, i);
+    const char *use = json_object_get_string (jwk, "use");
+    const char *kid = json_object_get_string (jwk, "kid");
+    if (use && strcmp (use, "sig"))
+    {
+      continue;
+    }
+    if (jwks_load_key (jwk, &keys[nkeys]))
+    {
+      keys[nkeys++].kid = kid ? strdup (kid) : NULL;
+    }
+    else
+    {
+      iot_log_warn (jwks->lc, "jwks: skipping unsupported key %s", kid ? kid : "(no kid)");
+    }
+  }
+  json_value_free (val);
+
+  pthread_rwlock_wrlock (&jwks->lock);
+  jwks_key_t *old = jwks->keys;
+  unsigned nold = jwks->nkeys;
+  jwks->keys = keys;
+  jwks->nkeys = nkeys;
+  pthread_rwlock_unlock (&jwks->lock);
+  jwks_keys_free (old, nold);
+  iot_log_debug (jwks->lc, "jwks: loaded %u signing keys", nkeys);
+  return true;
+}
+
+static const jwks_key_t *jwks_find (const edgex_jwks_t *jwks, const char *kid, const jwks_alg_t *alg)
+{
+  for (unsigned i = 0; i < jwks->nkeys; i++)
+  {
+    const jwks_key_t *key = &jwks->keys[i];
+    if (key->kind == alg->kind && key->clen == alg->clen && (kid == NULL || (key->kid && strcmp (key->kid, kid) == 0)))
+    {
+      return key;
+    }
+  }
+  return NULL;
+}
+
+static bool jwks_check_sig (const jwks_key_t *key, const jwks_alg_t *alg, const char *signed_part, size_t slen, const uint8_t *sig, size_t siglen)
+{
+  bool result = false;
+  jwks_buf der = { NULL, 0 };
+
+  // JWS carries ECDSA signatures as r || s; OpenSSL expects DER
+  if (alg->kind == JWKS_EC)
+  {
+    if (siglen != 2 * alg->clen)
+    {
+      return false;
+    }
+    der_uint (&der, sig, alg->clen);
+    der_uint (&der, sig + alg->clen, alg->clen);
+    der_wrap (&der, 0x30);
+    sig = der.data;
+    siglen = der.len;
+  }
+
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new ();
+  if (EVP_DigestVerifyInit (ctx, NULL, alg->md ? alg->md () : NULL, NULL, key->pkey) == 1)
+  {
+    result = EVP_DigestVerify (ctx, sig, siglen, (const unsigned char *)signed_part, slen) == 1;
+  }
+  EVP_MD_CTX_free (ctx);
+  free (der.data);
+  return result;
+}
+
+static bool jwks_check_aud (const JSON_Object *claims, const char *aud)
+{
+  const char *str = json_object_get_string (claims, "aud");
+  if (str)
+  {
+    return strcmp (str, aud) == 0;
+  }
+  JSON_Array *arr = json_object_get_array (claims, "aud");
+  for (size_t i = 0; i < json_array_get_count (arr); i++)
+  {
+    str = json_array_get_string (arr, i);
+    if (str && strcmp (str, aud) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+edgex_jwt_status edgex_jwks_verify (edgex_jwks_t *jwks, const char *jwt, const char *aud, uint64_t now, bool *refresh)
+{
+  edgex_jwt_status result = EDGEX_JWT_INVALID;
+  const char *hend = strchr (jwt, '.');
+  const char *pend = hend ? strchr (hend + 1, '.') : NULL;
+  *refresh = false;
+  if (pend == NULL || strchr (pend + 1, '.'))
+  {
+    return EDGEX_JWT_INVALID;
+  }
+
+  JSON_Value *hval = jwks_decode_json (jwt, hend - jwt);
+  const JSON_Object *hdr = json_value_get_object (hval);
+  const char *algname = json_object_get_string (hdr, "alg");
+  const char *kid = json_object_get_string (hdr, "kid");
+  const jwks_alg_t *alg = jwks_algs;
+  while (alg->name && (algname == NULL || strcmp (alg->name, algname)))
+  {
+    alg++;
+  }
+
+  if (alg->name == NULL)
+  {
+    // Unsigned tokens are never accepted; others may be checked remotely
+    result = (algname && strcmp (algname, "none")) ? EDGEX_JWT_UNKNOWN : EDGEX_JWT_INVALID;
+  }
+  else
+  {
+    pthread_rwlock_rdlock (&jwks->lock);
+    const jwks_key_t *key = jwks_find (jwks, kid, alg);
+    if (key == NULL)
+    {
+      result = EDGEX_JWT_UNKNOWN;
+      *refresh = true;
+    }
+    else
+    {
+      size_t siglen;
+      uint8_t *sig = jwks_decode (pend + 1, strlen (pend + 1), &siglen);
+      if (sig && jwks_check_sig (key, alg, jwt, pend - jwt, sig, siglen))
+      {
+        JSON_Value *cval = jwks_decode_json (hend + 1, pend - hend - 1);
+        const JSON_Object *claims = json_value_get_object (cval);
+        double exp = json_object_get_number (claims, "exp");
+        double nbf = json_object_get_number (claims, "nbf");
+        if (claims && exp * 1000 > now && nbf * 1000 <= now && (aud == NULL || *aud == '\0' || jwks_check_aud (claims, aud)))
+        {
+          result = EDGEX_JWT_VALID;
+        }
+        json_value_free (cval);
+      }
+      free (sig);
+    }
+    pthread_rwlock_unlock (&jwks->lock);
+  }
+  json_value_free (hval);
+  return result;
+}
+
+void edgex_jwks_free (edgex_jwks_t *jwks)
+{
+  if (jwks)
+  {
+    jwks_keys_free (jwks->keys, jwks->nkeys);
+    pthread_rwlock_destroy (&jwks->lock);
+    free (jwks);
+  }
+}
+
+#else
+
+#include <stdlib.h>
+
+struct edgex_jwks_t
+{
+  iot_logger_t *lc;
+};
+
+bool edgex_jwks_available (void)
+{
+  return false;
+}
+
+edgex_jwks_t *edgex_jwks_alloc (iot_logger_t *lc)
+{
+  edgex_jwks_t *jwks = calloc (1, sizeof (edgex_jwks_t));
+  jwks->lc = lc;
+  return jwks;
+}
+
+bool edgex_jwks_update (edgex_jwks_t *jwks, const char *json)
+{
+  iot_log_error (jwks->lc, "jwks: local JWT verification requires OpenSSL");
+  return false;
+}
+
+edgex_jwt_status edgex_jwks_verify (edgex_jwks_t *jwks, const char *jwt, const char *aud, uint64_t now, bool *refresh)
+{
+  *refresh = false;
+  return EDGEX_JWT_UNKNOWN;
+}
+
+void edgex_jwks_free (edgex_jwks_t *jwks)
+{
+  free (jwks);
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_JWKS_H_
+#define _EDGEX_JWKS_H_ 1
+
+#include "jwtcache.h"
+
+#include <iot/logger.h>
+
+/* Local verification of JWTs against a set of public signing keys, as
+ * published by an identity provider in JSON Web Key Set form (RFC 7517).
+ * RSA (RS256/384/512), ECDSA (ES256/384/512) and Ed25519 (EdDSA) keys are
+ * supported. The key set may be replaced at any time; verification runs
+ * concurrently with other verifications.
+ *
+ * Verification requires OpenSSL. Where the SDK is built without it,
+ * edgex_jwks_available returns false and no token can be verified.
+ */
+
+typedef struct edgex_jwks_t edgex_jwks_t;
+
+bool edgex_jwks_available (void);
+
+edgex_jwks_t *edgex_jwks_alloc (iot_logger_t *lc);
+
+/* Replaces the key set with the keys in a JWKS document. Keys of
+   unsupported types are skipped. Returns false, leaving the key set
+   unchanged, if the document cannot be parsed. */
+bool edgex_jwks_update (edgex_jwks_t *jwks, const char *json);
+
+/* Checks the signature of a token and its exp and nbf claims against the
+   current time in milliseconds, and if aud is set, that the token's aud
+   claim includes it. Returns unknown if the token is signed with a key or
+   algorithm not in the set; refresh is then set if the key set may be out
+   of date. */
+edgex_jwt_status edgex_jwks_verify (edgex_jwks_t *jwks, const char *jwt, const char *aud, uint64_t now, bool *refresh);
+
+void edgex_jwks_free (edgex_jwks_t *jwks);
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "jwtcache.h"
+#include "b64.h"
+#include "parson.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct edgex_jwt_entry_t
+{
+  uint64_t hash;
+  char *jwt;
+  bool valid;
+  uint64_t expires;
+  struct edgex_jwt_entry_t *chain;
+  struct edgex_jwt_entry_t *prev;
+  struct edgex_jwt_entry_t *next;
+} edgex_jwt_entry_t;
+
+/* Entries are chained from a power-of-two table of buckets, and linked in
+   order of use with the most recent at the head */
+
+struct edgex_jwt_cache_t
+{
+  edgex_jwt_entry_t **buckets;
+  uint32_t mask;
+  uint32_t size;
+  uint32_t count;
+  edgex_jwt_entry_t *head;
+  edgex_jwt_entry_t *tail;
+  pthread_mutex_t mtx;
+};
+
+static uint64_t edgex_jwt_hash (const char *jwt)
+{
+  uint64_t h = 14695981039346656037u;
+  while (*jwt)
+  {
+    h = (h ^ (uint8_t)*jwt++) * 1099511628211u;
+  }
+  return h;
+}
+
+edgex_jwt_cache_t *edgex_jwt_cache_alloc (uint32_t size)
+{
+  edgex_jwt_cache_t *cache = calloc (1, sizeof (edgex_jwt_cache_t));
+  uint32_t nbuckets = 16;
+  while (nbuckets < size)
+  {
+    nbuckets <<= 1;
+  }
+  cache->buckets = calloc (nbuckets, sizeof (edgex_jwt_entry_t *));
+  cache->mask = nbuckets - 1;
+  cache->size = size;
+  pthread_mutex_init (&cache->mtx, NULL);
+  return cache;
+}
+
+static edgex_jwt_entry_t **edgex_jwt_cache_find (edgex_jwt_cache_t *cache, const char *jwt, uint64_t hash)
+{
+  edgex_jwt_entry_t **e = &cache->buckets[hash & cache->mask];
+  while (*e && ((*e)->hash != hash || strcmp ((*e)->jwt, jwt)))
+  {
+    e = &(*e)->chain;
+  }
+  return e;
+}
+
+static void edgex_jwt_cache_unlink (edgex_jwt_cache_t *cache, edgex_jwt_entry_t *e)
+{
+  if (e->prev)
+  {
+    e->prev->next = e->next;
+  }
+  else
+  {
+    cache->head = e->next;
+  }
+  if (e->next)
+  {
+    e->next->prev = e->prev;
+  }
+  else
+  {
+    cache->tail = e->prev;
+  }
+}
+
+static void edgex_jwt_cache_push (edgex_jwt_cache_t *cache, edgex_jwt_entry_t *e)
+{
+  e->prev = NULL;
+  e->next = cache->head;
+  if (cache->head)
+  {
+    cache->head->prev = e;
+  }
+  else
+  {
+    cache->tail = e;
+  }
+  cache->head = e;
+}
+
+static void edgex_jwt_cache_remove (edgex_jwt_cache_t *cache, edgex_jwt_entry_t **pos)
+{
+  edgex_jwt_entry_t *e = *pos;
+  *pos = e->chain;
+  edgex_jwt_cache_unlink (cache, e);
+  cache->count--;
+  free (e->jwt);
+  free (e);
+}
+
+edgex_jwt_status edgex_jwt_cache_get (edgex_jwt_cache_t *cache, const char *jwt, uint64_t now)
+{
+  edgex_jwt_status result = EDGEX_JWT_UNKNOWN;
+  uint64_t hash = edgex_jwt_hash (jwt);
+  pthread_mutex_lock (&cache->mtx);
+  edgex_jwt_entry_t **pos = edgex_jwt_cache_find (cache, jwt, hash);
+  if (*pos)
+  {
+    if ((*pos)->expires <= now)
+    {
+      edgex_jwt_cache_remove (cache, pos);
+    }
+    else
+    {
+      result = (*pos)->valid ? EDGEX_JWT_VALID : EDGEX_JWT_INVALID;
+      edgex_jwt_cache_unlink (cache, *pos);
+      edgex_jwt_cache_push (cache, *pos);
+    }
+  }
+  pthread_mutex_unlock (&cache->mtx);
+  return result;
+}
+
+void edgex_jwt_cache_put (edgex_jwt_cache_t *cache, const char *jwt, bool valid, uint64_t expires)
+{
+  uint64_t hash = edgex_jwt_hash (jwt);
+  pthread_mutex_lock (&cache->mtx);
+  edgex_jwt_entry_t **pos = edgex_jwt_cache_find (cache, jwt, hash);
+  edgex_jwt_entry_t *e = *pos;
+  if (e)
+  {
+    edgex_jwt_cache_unlink (cache, e);
+  }
+  else
+  {
+    if (cache->count == cache->size)
+    {
+      edgex_jwt_entry_t *lru = cache->tail;
+      edgex_jwt_cache_remove (cache, edgex_jwt_cache_find (cache, lru->jwt, lru->hash));
+      pos = edgex_jwt_cache_find (cache, jwt, hash);
+    }
+    e = calloc (1, sizeof (edgex_jwt_entry_t));
+    e->hash = hash;
+    e->jwt = strdup (jwt);
+    *pos = e;
+    cache->count++;
+  }
+  e->valid = valid;
+  e->expires = expires;
+  edgex_jwt_cache_push (cache, e);
+  pthread_mutex_unlock (&cache->mtx);
+}
+
+void edgex_jwt_cache_free (edgex_jwt_cache_t *cache)
+{
+  if (cache)
+  {
+    edgex_jwt_entry_t *e = cache->head;
+    while (e)
+    {
+      edgex_jwt_entry_t *next = e->next;
+      free (e->jwt);
+      free (e);
+      e = next;
+    }
+    pthread_mutex_destroy (&cache->mtx);
+    free (cache->buckets);
+    free (cache);
+  }
+}
+
+uint64_t edgex_jwt_expiry (const char *jwt)
+{
+  uint64_t result = 0;
+  const char *payload = strchr (jwt, '.');
+  const char *end = payload ? strchr (payload + 1, '.') : NULL;
+  if (end)
+  {
+    size_t len = end - payload - 1;
+    size_t outlen;
+    char *json = malloc (EDGEX_B64_MAXDECLEN (len) + 1);
+    if (edgex_b64url_decode (payload + 1, len, json, &outlen))
+    {
+      json[outlen] = '\0';
+      JSON_Value *val = json_parse_string (json);
+      double exp = json_object_get_number (json_value_get_object (val), "exp");
+      if (exp > 0)
+      {
+        result = (uint64_t)exp * 1000;
+      }
+      json_value_free (val);
+    }
+    free (json);
+  }
+  return result;
+}
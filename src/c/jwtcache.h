@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_JWTCACHE_H_
+#define _EDGEX_JWTCACHE_H_ 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Cache of JWT validation results, holding up to a fixed number of tokens
+ * with the least recently used evicted first. Entries are found by a hash
+ * of the token and confirmed against a copy of it, so that a token which
+ * collides with a cached one cannot take its result. Each entry carries its
+ * own expiry time. All operations are thread-safe.
+ */
+
+typedef struct edgex_jwt_cache_t edgex_jwt_cache_t;
+
+typedef enum
+{
+  EDGEX_JWT_UNKNOWN,
+  EDGEX_JWT_VALID,
+  EDGEX_JWT_INVALID
+} edgex_jwt_status;
+
+edgex_jwt_cache_t *edgex_jwt_cache_alloc (uint32_t size);
+
+/* Looks up a token, given the current time in milliseconds. Expired entries
+   are reported as unknown. */
+edgex_jwt_status edgex_jwt_cache_get (edgex_jwt_cache_t *cache, const char *jwt, uint64_t now);
+
+/* Records a result, to expire at the given time in milliseconds */
+void edgex_jwt_cache_put (edgex_jwt_cache_t *cache, const char *jwt, bool valid, uint64_t expires);
+
+void edgex_jwt_cache_free (edgex_jwt_cache_t *cache);
+
+/* Returns the exp claim of a token in milliseconds since the epoch, or zero
+   if it has none. The token's signature is not checked. */
+uint64_t edgex_jwt_expiry (const char *jwt);
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "lastconnected.h"
+#include "service.h"
+#include "metadata.h"
+#include "errorlist.h"
+#include <iot/time.h>
+
+#define EDGEX_LC_BATCH 100
+
+struct edgex_lastconnected_t
+{
+  devsdk_service_t *svc;
+  pthread_mutex_t mtx;
+  char **pending;
+  unsigned npending;
+  unsigned size;
+};
+
+edgex_lastconnected_t *edgex_lastconnected_alloc (devsdk_service_t *svc)
+{
+  edgex_lastconnected_t *lcu = calloc (1, sizeof (edgex_lastconnected_t));
+  lcu->svc = svc;
+  pthread_mutex_init (&lcu->mtx, NULL);
+  return lcu;
+}
+
+void edgex_lastconnected_record (edgex_lastconnected_t *lcu, edgex_device *dev)
+{
+  atomic_store (&dev->lastconnected, iot_time_msecs ());
+  if (!atomic_exchange (&dev->lcpending, true))
+  {
+    // First access since the last flush: queue the device for the next one
+    pthread_mutex_lock (&lcu->mtx);
+    if (lcu->npending == lcu->size)
+    {
+      lcu->size = lcu->size ? lcu->size * 2 : 64;
+      lcu->pending = realloc (lcu->pending, lcu->size * sizeof (char *));
+    }
+    lcu->pending[lcu->npending++] = strdup (dev->name);
+    pthread_mutex_unlock (&lcu->mtx);
+  }
+}
+
+static void edgex_lastconnected_send (edgex_lastconnected_t *lcu, const char **names, const uint64_t *times, unsigned n)
+{
+  devsdk_service_t *svc = lcu->svc;
+  devsdk_error err = EDGEX_OK;
+  edgex_metadata_client_update_lastconnected (svc->logger, &svc->config.endpoints, svc->secretstore, names, times, n, &err);
+  if (err.code)
+  {
+    iot_log_warn (svc->logger, "Unable to update LastConnected for %u device(s)", n);
+  }
+}
+
+void edgex_lastconnected_flush (edgex_lastconnected_t *lcu)
+{
+  const char *names[EDGEX_LC_BATCH];
+  uint64_t times[EDGEX_LC_BATCH];
+  unsigned n = 0;
+
+  pthread_mutex_lock (&lcu->mtx);
+  char **pending = lcu->pending;
+  unsigned npending = lcu->npending;
+  lcu->pending = NULL;
+  lcu->npending = 0;
+  lcu->size = 0;
+  pthread_mutex_unlock (&lcu->mtx);
+
+  for (unsigned i = 0; i < npending; i++)
+  {
+    edgex_device *dev = edgex_devmap_device_byname (lcu->svc->devices, pending[i]);
+    if (dev)
+    {
+      // Clear the flag before reading the time, so a later access is not lost
+      atomic_store (&dev->lcpending, false);
+      names[n] = pending[i];
+      times[n] = atomic_load (&dev->lastconnected);
+      edgex_device_release (lcu->svc, dev);
+      if (times[n] == 0)
+      {
+        // A new instance of the device which has not been accessed yet
+        continue;
+      }
+      if (++n == EDGEX_LC_BATCH)
+      {
+        edgex_lastconnected_send (lcu, names, times, n);
+        n = 0;
+      }
+    }
+  }
+  if (n)
+  {
+    edgex_lastconnected_send (lcu, names, times, n);
+  }
+
+  for (unsigned i = 0; i < npending; i++)
+  {
+    free (pending[i]);
+  }
+  free (pending);
+}
+
+void edgex_lastconnected_free (edgex_lastconnected_t *lcu)
+{
+  if (lcu)
+  {
+    for (unsigned i = 0; i < lcu->npending; i++)
+    {
+      free (lcu->pending[i]);
+    }
+    free (lcu->pending);
+    pthread_mutex_destroy (&lcu->mtx);
+    free (lcu);
+  }
+}
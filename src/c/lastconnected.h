@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_LASTCONNECTED_H_
+#define _EDGEX_LASTCONNECTED_H_ 1
+
+#include "devmap.h"
+
+/* Coalesces device LastConnected updates. Recording an access only stores
+ * the time in the device; devices accessed since the last flush are sent
+ * to core-metadata together, in batched PATCH requests.
+ */
+
+typedef struct edgex_lastconnected_t edgex_lastconnected_t;
+
+/* Flush interval in milliseconds used if none is configured */
+#define EDGEX_LC_DEFAULT_INTERVAL 5000
+
+edgex_lastconnected_t *edgex_lastconnected_alloc (devsdk_service_t *svc);
+
+void edgex_lastconnected_record (edgex_lastconnected_t *lcu, edgex_device *dev);
+
+void edgex_lastconnected_flush (edgex_lastconnected_t *lcu);
+
+void edgex_lastconnected_free (edgex_lastconnected_t *lcu);
+
+#endif
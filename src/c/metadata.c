@@ -137,7 +137,9 @@ void edgex_metadata_client_update_lastconnected
   iot_logger_t * lc,
   edgex_service_endpoints * endpoints,
   edgex_secret_provider_t * secretprovider,
-  const char * devicename,
+  const char ** devicenames,
+  const uint64_t * times,
+  unsigned ndevices,
   devsdk_error * err
 )
 {
@@ -145,7 +147,7 @@ void edgex_metadata_client_update_lastconnected
   char url[URL_BUF_SIZE];
 
   memset (&ctx, 0, sizeof (edgex_ctx));
-  char *json = edgex_updateDevLCreq_write (devicename, iot_time_msecs ());
+  char *json = edgex_updateDevLCreq_write (devicenames, times, ndevices);
 
   snprintf (url, URL_BUF_SIZE - 1, "http://%s:%u/api/" EDGEX_API_VERSION" /device", endpoints->metadata.host, endpoints->metadata.port);
 
@@ -148,7 +148,9 @@ void edgex_metadata_client_update_lastconnected
   iot_logger_t * lc,
   edgex_service_endpoints * endpoints,
   edgex_secret_provider_t * secretprovider,
-  const char * devicename,
+  const char ** devicenames,
+  const uint64_t * times,
+  unsigned ndevices,
   devsdk_error * err
 );
 edgex_watcher *edgex_metadata_client_get_watchers
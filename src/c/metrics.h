@@ -18,6 +18,13 @@ typedef struct devsdk_metrics_t
   atomic_uint_fast64_t rcexe;
   atomic_uint_fast64_t secrq;
   atomic_uint_fast64_t secsto;
+  atomic_uint_fast64_t evqdrop;
+  atomic_uint_fast64_t evqlatsum;
+  atomic_uint_fast64_t evqlatcount;
+  atomic_uint_fast64_t evqlatmax;
+  atomic_uint_fast64_t cmdqwaitsum;
+  atomic_uint_fast64_t cmdqwaitcount;
+  atomic_uint_fast64_t cmdqwaitmax;
 } devsdk_metrics_t;
 
 #endif
@@ -8,6 +8,7 @@
 
 #include "reqdata.h"
 #include "parson.h"
+#include "b64.h"
 #include <cbor.h>
 
 struct edgex_reqdata_t
@@ -146,8 +147,7 @@ extern iot_data_t *edgex_reqdata_get_binary (const edgex_reqdata_t *data, const
     const char *b64 = json_object_get_string (data->json, name);
     if (b64)
     {
-      result = iot_data_alloc_array_from_base64 (b64);
-      iot_data_array_to_binary (result);
+      result = edgex_b64_to_binary (b64);
     }
   }
   else
@@ -15,10 +15,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <microhttpd.h>
+#include <iot/threadpool.h>
 
 #define EDGEX_ERRBUFSZ 1024
 
@@ -28,15 +30,57 @@
 #define EDGEX_MHD_RESULT int
 #endif
 
+#if MHD_VERSION >= 0x00097302
+#define EDGEX_MHD_HAVE_FREE_CLS 1
+#endif
+
+#if MHD_VERSION >= 0x00095700
+#define EDGEX_MHD_POOL_FLAGS (MHD_USE_AUTO | MHD_ALLOW_SUSPEND_RESUME)
+#else
+#define EDGEX_MHD_POOL_FLAGS (MHD_USE_POLL | MHD_USE_SUSPEND_RESUME)
+#endif
+
+/* Requests are routed through a trie of URL segments. A segment is either
+   a literal or a {param} capture. As for the message bus, the trie is
+   immutable once built: registration builds a new one under the server lock
+   and publishes it with an atomic pointer swap, so routing takes no lock.
+   Superseded tries are retained until the server is destroyed. */
+
+#define EDGEX_REST_MAXPARAMS 8
+
 typedef struct handler_list
 {
   devsdk_strings *url;
+  char *names[EDGEX_REST_MAXPARAMS];
+  unsigned nparams;
   uint32_t methods;
   void *ctx;
   devsdk_http_handler_fn handler;
   struct handler_list *next;
 } handler_list;
 
+typedef struct rest_node_t
+{
+  char *seg;
+  size_t len;
+  struct rest_node_t *children;
+  struct rest_node_t *next;
+  struct rest_node_t *param;
+  const handler_list *h;
+} rest_node_t;
+
+typedef struct rest_trie_t
+{
+  rest_node_t root;
+  struct rest_trie_t *retired;
+} rest_trie_t;
+
+typedef struct rest_match_t
+{
+  const char *start[EDGEX_REST_MAXPARAMS];
+  size_t len[EDGEX_REST_MAXPARAMS];
+} rest_match_t;
+
 typedef struct cors_config
 {
   const char *allowedorigin;
@@ -55,8 +99,10 @@ struct edgex_rest_server
   iot_logger_t *lc;
   struct MHD_Daemon *daemon;
   handler_list *handlers;
+  _Atomic (rest_trie_t *) trie;
   pthread_mutex_t lock;
   uint64_t maxsize;
+  iot_threadpool_t *workers;
   cors_config cors;
 };
 
@@ -64,6 +110,17 @@ typedef struct http_context_s
 {
   char *m_data;
   size_t m_size;
+  /* Set when the request is passed to a worker */
+  struct MHD_Connection *conn;
+  const handler_list *h;
+  devsdk_http_request req;
+  devsdk_http_reply rep;
+  char *crlid;
+  bool cors_passed;
+  atomic_bool done;
+  /* Path parameters point into the copy of the URL */
+  devsdk_nvpairs params[EDGEX_REST_MAXPARAMS];
+  char url[];
 } http_context_t;
 
 static const char *ds_paramlist[] = DS_PARAMLIST;
@@ -129,30 +186,142 @@ static EDGEX_MHD_RESULT queryIterator (void *p, enum MHD_ValueKind kind, const c
   return MHD_YES;
 }
 
-static bool match_url_pattern (const devsdk_strings *pattern, const devsdk_strings *url, devsdk_nvpairs **params)
+static void handler_list_free (handler_list *h)
+{
+  devsdk_strings_free (h->url);
+  for (unsigned i = 0; i < h->nparams; i++)
+  {
+    free (h->names[i]);
+  }
+  free (h);
+}
+
+static void rest_node_free (rest_node_t *node)
+{
+  while (node)
+  {
+    rest_node_t *next = node->next;
+    rest_node_free (node->children);
+    rest_node_free (node->param);
+    free (node->seg);
+    free (node);
+    node = next;
+  }
+}
+
+static void rest_trie_free (rest_trie_t *trie)
 {
-  bool result = true;
-  while (result && pattern && url)
+  while (trie)
   {
-    if (strcmp (pattern->str, url->str))
+    rest_trie_t *next = trie->retired;
+    rest_node_free (trie->root.children);
+    rest_node_free (trie->root.param);
+    free (trie);
+    trie = next;
+  }
+}
+
+static rest_node_t *rest_node_child (rest_node_t *node, const char *seg, size_t len)
+{
+  rest_node_t *child;
+  for (child = node->children; child; child = child->next)
+  {
+    if (child->len == len && strncmp (child->seg, seg, len) == 0)
     {
-      size_t plen = strlen (pattern->str);
-      if (plen >= 3 && *pattern->str == '{' && *(pattern->str + plen - 1) == '}')
-      {
-        char *name = alloca (plen - 1);
-        strncpy (name, pattern->str + 1, plen - 2);
-        name[plen - 2] = '\0';
-        *params = devsdk_nvpairs_new (name, url->str, *params);
-      }
-      else
+      return child;
+    }
+  }
+  child = calloc (1, sizeof (rest_node_t));
+  child->seg = strndup (seg, len);
+  child->len = len;
+  child->next = node->children;
+  node->children = child;
+  return child;
+}
+
+/* Handlers are inserted in order of registration; where two share a
+   pattern, the first registered takes precedence */
+
+static void rest_trie_insert (rest_trie_t *trie, const handler_list *h)
+{
+  rest_node_t *node = &trie->root;
+  for (const devsdk_strings *s = h->url; s; s = s->next)
+  {
+    size_t len = strlen (s->str);
+    if (len >= 3 && *s->str == '{' && s->str[len - 1] == '}')
+    {
+      if (node->param == NULL)
       {
-        result = false;
+        node->param = calloc (1, sizeof (rest_node_t));
       }
+      node = node->param;
+    }
+    else
+    {
+      node = rest_node_child (node, s->str, len);
+    }
+  }
+  if (node->h == NULL)
+  {
+    node->h = h;
+  }
+}
+
+/* Finds the handler for the remainder of a URL, trying literal segments
+   before captures. Repeated slashes separate segments as a single one
+   would. Captured segments are recorded as slices of the URL. */
+
+static const handler_list *rest_trie_match (const rest_node_t *node, const char *seg, unsigned depth, rest_match_t *m)
+{
+  const handler_list *result = NULL;
+  while (*seg == '/') seg++;
+  const char *end = seg + strcspn (seg, "/");
+  size_t len = end - seg;
+
+  for (const rest_node_t *child = node->children; child; child = child->next)
+  {
+    if (child->len == len && memcmp (child->seg, seg, len) == 0)
+    {
+      result = *end ? rest_trie_match (child, end, depth, m) : child->h;
+      break;
+    }
+  }
+  if (result == NULL && node->param && depth < EDGEX_REST_MAXPARAMS)
+  {
+    m->start[depth] = seg;
+    m->len[depth] = len;
+    result = *end ? rest_trie_match (node->param, end, depth + 1, m) : node->param->h;
+  }
+  return result;
+}
+
+/* Routes the context's copy of the URL, terminating each captured segment
+   in place so that the parameters need no allocation */
+
+static const handler_list *rest_route (edgex_rest_server *svr, http_context_t *ctx)
+{
+  rest_match_t m;
+  const handler_list *h = NULL;
+  const rest_trie_t *trie = atomic_load_explicit (&svr->trie, memory_order_acquire);
+  if (trie)
+  {
+    h = rest_trie_match (&trie->root, ctx->url, 0, &m);
+  }
+  if (h)
+  {
+    devsdk_nvpairs *params = NULL;
+    for (unsigned i = 0; i < h->nparams; i++)
+    {
+      char *value = (char *)m.start[i];
+      value[m.len[i]] = '\0';
+      ctx->params[i].name = h->names[i];
+      ctx->params[i].value = value;
+      ctx->params[i].next = params;
+      params = &ctx->params[i];
     }
-    pattern = pattern->next;
-    url = url->next;
+    ctx->req.params = params;
   }
-  return result && !(pattern || url);
+  return h;
 }
 
 static bool cors_string_in_list (const char *s, char ** l)
@@ -254,6 +423,85 @@ static void set_header_if_nonempty (struct MHD_Response *response, const char *h
   }
 }
 
+#ifdef EDGEX_MHD_HAVE_FREE_CLS
+static void edgex_rest_release_owner (void *owner)
+{
+  iot_data_free ((iot_data_t *)owner);
+}
+#endif
+
+static void http_send_reply
+(
+  edgex_rest_server *svr,
+  struct MHD_Connection *conn,
+  int status,
+  void *reply,
+  size_t reply_size,
+  const char *reply_type,
+  iot_data_t *reply_owner,
+  bool cors_passed
+)
+{
+  struct MHD_Response *response;
+
+  if (reply_type == NULL)
+  {
+    reply_type = CONTENT_PLAINTEXT;
+  }
+  if (reply == NULL)
+  {
+    reply = strdup ("");
+    reply_size = 0;
+  }
+  if (reply_owner)
+  {
+#ifdef EDGEX_MHD_HAVE_FREE_CLS
+    response = MHD_create_response_from_buffer_with_free_callback_cls (reply_size, reply, edgex_rest_release_owner, reply_owner);
+#else
+    response = MHD_create_response_from_buffer (reply_size, reply, MHD_RESPMEM_MUST_COPY);
+    iot_data_free (reply_owner);
+#endif
+  }
+  else
+  {
+    response = MHD_create_response_from_buffer (reply_size, reply, MHD_RESPMEM_MUST_FREE);
+  }
+  MHD_add_response_header (response, "Content-Type", reply_type);
+  MHD_add_response_header (response, "X-Correlation-ID", edgex_device_get_crlid ());
+  if (cors_passed)
+  {
+    set_header_if_nonempty (response, MHD_HTTP_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN, svr->cors.allowedorigin);
+    MHD_add_response_header (response, "Access-Control-Allow-Credentials", svr->cors.allowcreds);
+    set_header_if_nonempty (response, "Access-Control-Expose-Headers", svr->cors.exposeheaders);
+    MHD_add_response_header (response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ORIGIN);
+  }
+  MHD_queue_response (conn, status, response);
+  MHD_destroy_response (response);
+}
+
+/* Runs a handler on a worker thread while its connection is suspended. The
+   connection is then resumed, and the reply sent from the polling thread. */
+
+static void *http_run_handler (void *p)
+{
+  http_context_t *ctx = (http_context_t *)p;
+  edgex_device_alloc_crlid (ctx->crlid);
+  memset (&ctx->rep, 0, sizeof (devsdk_http_reply));
+  ctx->h->handler (ctx->h->ctx, &ctx->req, &ctx->rep);
+  edgex_device_free_crlid ();
+  atomic_store (&ctx->done, true);
+  MHD_resume_connection (ctx->conn);
+  return NULL;
+}
+
+static void http_context_free (http_context_t *ctx)
+{
+  iot_data_free (ctx->req.qparams);
+  free (ctx->crlid);
+  free (ctx->m_data);
+  free (ctx);
+}
+
 static EDGEX_MHD_RESULT http_handler
 (
   void *this,
@@ -269,24 +517,37 @@ static EDGEX_MHD_RESULT http_handler
   int status = MHD_HTTP_OK;
   http_context_t *ctx = (http_context_t *) *context;
   edgex_rest_server *svr = (edgex_rest_server *) this;
-  struct MHD_Response *response = NULL;
+  struct MHD_Response *response;
   void *reply = NULL;
   size_t reply_size = 0;
   const char *reply_type = NULL;
-  handler_list *h;
+  iot_data_t *reply_owner = NULL;
+  const handler_list *h;
   bool cors_passed = false;
 
   /* First call used to create call context */
 
   if (ctx == 0)
   {
-    ctx = (http_context_t *) malloc (sizeof (*ctx));
-    ctx->m_size = 0;
-    ctx->m_data = NULL;
+    ctx = (http_context_t *) calloc (1, sizeof (*ctx) + strlen (url) + 1);
+    strcpy (ctx->url, url);
     *context = (void *) ctx;
     return MHD_YES;
   }
 
+  /* Call on resumption after a worker has run the handler */
+
+  if (atomic_load (&ctx->done))
+  {
+    *context = 0;
+    edgex_device_alloc_crlid (ctx->crlid);
+    http_send_reply
+      (svr, conn, ctx->rep.code, ctx->rep.data.bytes, ctx->rep.data.size, ctx->rep.content_type, ctx->rep.data_owner, ctx->cors_passed);
+    http_context_free (ctx);
+    edgex_device_free_crlid ();
+    return MHD_YES;
+  }
+
   /* Subsequent calls transfer data */
 
   if (*upload_data_size)
@@ -294,8 +555,8 @@ static EDGEX_MHD_RESULT http_handler
     size_t required = ctx->m_size + (*upload_data_size) + 1;
     if (svr->maxsize && required > svr->maxsize)
     {
-      free (ctx->m_data);
-      free (ctx);
+      http_context_free (ctx);
+      *context = 0;
       iot_log_error (svr->lc, "http: request size of %zu exceeds configured maximum", required);
       return MHD_NO;
     }
@@ -326,8 +587,7 @@ static EDGEX_MHD_RESULT http_handler
       MHD_add_response_header (response, "Access-Control-Max-Age", svr->cors.maxage);
       MHD_queue_response (conn, MHD_HTTP_NO_CONTENT, response);
       MHD_destroy_response (response);
-      free (ctx->m_data);
-      free (ctx);
+      http_context_free (ctx);
       edgex_device_free_crlid ();
       return MHD_YES;
     }
@@ -370,19 +630,9 @@ static EDGEX_MHD_RESULT http_handler
   }
   else
   {
-    devsdk_nvpairs *params = NULL;
-    devsdk_strings *elems = processUrl (url);
     status = MHD_HTTP_NOT_FOUND;
     iot_log_trace (svr->lc, "Incoming %s request to %s%s%s", methodname, url, ctx->m_size ? ", data " : " (no data)", ctx->m_size ? ctx->m_data : "");
-    pthread_mutex_lock (&svr->lock);
-    for (h = svr->handlers; h; h = h->next)
-    {
-      if (match_url_pattern (h->url, elems, &params))
-      {
-        break;
-      }
-    }
-    pthread_mutex_unlock (&svr->lock);
+    h = rest_route (svr, ctx);
     if (h)
     {
       if (method & h->methods)
@@ -393,24 +643,36 @@ static EDGEX_MHD_RESULT http_handler
         }
         else
         {
-          devsdk_http_request req;
+          devsdk_http_request *req = &ctx->req;
           devsdk_http_reply rep;
-          req.qparams = iot_data_alloc_map (IOT_DATA_STRING);
-          MHD_get_connection_values (conn, MHD_GET_ARGUMENT_KIND, queryIterator, req.qparams);
-          req.params = params;
-          req.method = method;
-          req.data.bytes = ctx->m_data;
-          req.data.size = ctx->m_size;
-          req.authorization_header_value = MHD_lookup_connection_value (conn, MHD_HEADER_KIND, MHD_HTTP_HEADER_AUTHORIZATION);
-          req.content_type = MHD_lookup_connection_value (conn, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_TYPE);
+          req->qparams = iot_data_alloc_map (IOT_DATA_STRING);
+          MHD_get_connection_values (conn, MHD_GET_ARGUMENT_KIND, queryIterator, req->qparams);
+          req->method = method;
+          req->data.bytes = ctx->m_data;
+          req->data.size = ctx->m_size;
+          req->authorization_header_value = MHD_lookup_connection_value (conn, MHD_HEADER_KIND, MHD_HTTP_HEADER_AUTHORIZATION);
+          req->content_type = MHD_lookup_connection_value (conn, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_TYPE);
+          if (svr->workers)
+          {
+            /* Header values remain valid while the connection is suspended */
+            ctx->conn = conn;
+            ctx->h = h;
+            ctx->crlid = strdup (edgex_device_get_crlid ());
+            ctx->cors_passed = svr->cors.enabled;
+            *context = (void *) ctx;
+            MHD_suspend_connection (conn);
+            iot_threadpool_add_work (svr->workers, http_run_handler, ctx, IOT_THREAD_NO_PRIORITY);
+            edgex_device_free_crlid ();
+            return MHD_YES;
+          }
           memset (&rep, 0, sizeof (devsdk_http_reply));
-          h->handler (h->ctx, &req, &rep);
+          h->handler (h->ctx, req, &rep);
           status = rep.code;
           reply = rep.data.bytes;
           reply_size = rep.data.size;
           reply_type = rep.content_type;
+          reply_owner = rep.data_owner;
           cors_passed = svr->cors.enabled;
-          iot_data_free (req.qparams);
         }
       }
       else
@@ -418,38 +680,15 @@ static EDGEX_MHD_RESULT http_handler
         status = MHD_HTTP_METHOD_NOT_ALLOWED;
       }
     }
-    devsdk_nvpairs_free (params);
-    devsdk_strings_free (elems);
   }
 
   /* Send reply */
 
-  if (reply_type == NULL)
-  {
-    reply_type = CONTENT_PLAINTEXT;
-  }
-  if (reply == NULL)
-  {
-    reply = strdup ("");
-    reply_size = 0;
-  }
-  response = MHD_create_response_from_buffer (reply_size, reply, MHD_RESPMEM_MUST_FREE);
-  MHD_add_response_header (response, "Content-Type", reply_type);
-  MHD_add_response_header (response, "X-Correlation-ID", edgex_device_get_crlid ());
-  if (cors_passed)
-  {
-    set_header_if_nonempty (response, MHD_HTTP_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN, svr->cors.allowedorigin);
-    MHD_add_response_header (response, "Access-Control-Allow-Credentials", svr->cors.allowcreds);
-    set_header_if_nonempty (response, "Access-Control-Expose-Headers", svr->cors.exposeheaders);
-    MHD_add_response_header (response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ORIGIN);
-  }
-  MHD_queue_response (conn, status, response);
-  MHD_destroy_response (response);
+  http_send_reply (svr, conn, status, reply, reply_size, reply_type, reply_owner, cors_passed);
 
   /* Clean up */
 
-  free (ctx->m_data);
-  free (ctx);
+  http_context_free (ctx);
   edgex_device_free_crlid ();
   return MHD_YES;
 }
@@ -489,17 +728,42 @@ static void edgex_rest_server_log (void *ctx, const char * fmt, va_list ap)
 }
 
 edgex_rest_server *edgex_rest_server_create
-  (iot_logger_t *lc, const char *bindaddr, uint16_t port, uint64_t maxsize, devsdk_error *err)
+  (iot_logger_t *lc, const char *bindaddr, uint16_t port, const edgex_rest_server_opts *opts, devsdk_error *err)
 {
   edgex_rest_server *svr;
-  uint16_t flags = MHD_USE_THREAD_PER_CONNECTION | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG;
+  unsigned int flags = MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG;
+  struct MHD_OptionItem mhdopts[4];
+  int nopts = 0;
 
   svr = calloc (1, sizeof (edgex_rest_server));
   svr->lc = lc;
-  svr->maxsize = maxsize;
+  atomic_init (&svr->trie, NULL);
+  svr->maxsize = opts->maxsize;
 
   pthread_mutex_init (&svr->lock, NULL);
 
+  if (opts->threads)
+  {
+    flags |= EDGEX_MHD_POOL_FLAGS;
+    mhdopts[nopts++] = (struct MHD_OptionItem){ MHD_OPTION_THREAD_POOL_SIZE, opts->threads, NULL };
+    svr->workers = iot_threadpool_alloc (opts->workers ? opts->workers : 1, 0, IOT_THREAD_NO_PRIORITY, IOT_THREAD_NO_AFFINITY, lc);
+    iot_threadpool_start (svr->workers);
+    iot_log_info (lc, "HTTP server using %" PRIu16 " polling threads and %" PRIu16 " workers", opts->threads, opts->workers ? opts->workers : 1);
+  }
+  else
+  {
+    flags |= MHD_USE_THREAD_PER_CONNECTION;
+  }
+  if (opts->maxconns)
+  {
+    mhdopts[nopts++] = (struct MHD_OptionItem){ MHD_OPTION_CONNECTION_LIMIT, opts->maxconns, NULL };
+  }
+  if (opts->timeout)
+  {
+    mhdopts[nopts++] = (struct MHD_OptionItem){ MHD_OPTION_CONNECTION_TIMEOUT, opts->timeout, NULL };
+  }
+  mhdopts[nopts] = (struct MHD_OptionItem){ MHD_OPTION_END, 0, NULL };
+
   /* Start http server */
 
   if (strcmp (bindaddr, "0.0.0.0"))
@@ -517,7 +781,7 @@ edgex_rest_server *edgex_rest_server_create
       {
         flags |= MHD_USE_IPv6;
       }
-      svr->daemon = MHD_start_daemon (flags, port, 0, 0, http_handler, svr, MHD_OPTION_EXTERNAL_LOGGER, edgex_rest_server_log, lc, MHD_OPTION_SOCK_ADDR, res->ai_addr, MHD_OPTION_END);
+      svr->daemon = MHD_start_daemon (flags, port, 0, 0, http_handler, svr, MHD_OPTION_EXTERNAL_LOGGER, edgex_rest_server_log, lc, MHD_OPTION_SOCK_ADDR, res->ai_addr, MHD_OPTION_ARRAY, mhdopts, MHD_OPTION_END);
       freeaddrinfo (res);
     }
     else
@@ -528,7 +792,7 @@ edgex_rest_server *edgex_rest_server_create
   else
   {
     iot_log_info (lc, "Starting HTTP server on port %d (all interfaces)", port);
-    svr->daemon = MHD_start_daemon (flags, port, 0, 0, http_handler, svr, MHD_OPTION_EXTERNAL_LOGGER, edgex_rest_server_log, lc, MHD_OPTION_END);
+    svr->daemon = MHD_start_daemon (flags, port, 0, 0, http_handler, svr, MHD_OPTION_EXTERNAL_LOGGER, edgex_rest_server_log, lc, MHD_OPTION_ARRAY, mhdopts, MHD_OPTION_END);
   }
 
   if (svr->daemon == NULL)
@@ -553,13 +817,26 @@ bool edgex_rest_server_register_handler
   devsdk_http_handler_fn handler
 )
 {
-  bool result = true;
-  handler_list *entry = malloc (sizeof (handler_list));
+  handler_list *entry = calloc (1, sizeof (handler_list));
   entry->handler = handler;
   entry->url = processUrl (url);
   entry->methods = methods;
   entry->ctx = context;
-  entry->next = NULL;
+  for (const devsdk_strings *s = entry->url; s; s = s->next)
+  {
+    size_t len = strlen (s->str);
+    if (len >= 3 && *s->str == '{' && s->str[len - 1] == '}')
+    {
+      if (entry->nparams == EDGEX_REST_MAXPARAMS)
+      {
+        iot_log_error (svr->lc, "edgex_rest_server_register_handler: too many parameters in %s", url);
+        handler_list_free (entry);
+        return false;
+      }
+      entry->names[entry->nparams++] = strndup (s->str + 1, len - 2);
+    }
+  }
+
   pthread_mutex_lock (&svr->lock);
   handler_list **tail = &svr->handlers;
   while (*tail)
@@ -567,8 +844,15 @@ bool edgex_rest_server_register_handler
     tail = &((*tail)->next);
   }
   *tail = entry;
+  rest_trie_t *trie = calloc (1, sizeof (rest_trie_t));
+  for (const handler_list *h = svr->handlers; h; h = h->next)
+  {
+    rest_trie_insert (trie, h);
+  }
+  trie->retired = atomic_load_explicit (&svr->trie, memory_order_relaxed);
+  atomic_store_explicit (&svr->trie, trie, memory_order_release);
   pthread_mutex_unlock (&svr->lock);
-  return result;
+  return true;
 }
 
 void edgex_error_response (iot_logger_t *lc, devsdk_http_reply *reply, int code, char *msg, ...)
@@ -612,15 +896,24 @@ iot_data_t *edgex_v3_base_response (const char *msg)
 void edgex_rest_server_destroy (edgex_rest_server *svr)
 {
   handler_list *tmp;
+  if (svr->workers)
+  {
+    // Suspended connections must be resumed before the daemon is stopped
+    iot_threadpool_wait (svr->workers);
+  }
   if (svr->daemon)
   {
     MHD_stop_daemon (svr->daemon);
   }
+  if (svr->workers)
+  {
+    iot_threadpool_free (svr->workers);
+  }
+  rest_trie_free (atomic_load (&svr->trie));
   while (svr->handlers)
   {
     tmp = svr->handlers->next;
-    devsdk_strings_free (svr->handlers->url);
-    free (svr->handlers);
+    handler_list_free (svr->handlers);
     svr->handlers = tmp;
   }
   pthread_mutex_destroy (&svr->lock);
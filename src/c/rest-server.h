@@ -14,7 +14,22 @@
 struct edgex_rest_server;
 typedef struct edgex_rest_server edgex_rest_server;
 
-extern edgex_rest_server *edgex_rest_server_create (iot_logger_t *lc, const char *bindaddr, uint16_t port, uint64_t maxsize, devsdk_error *err);
+/* Server tuning. With threads zero, each connection is served by its own
+   thread. Otherwise that many threads poll the connections and handlers run
+   on a separate pool of workers, so that a slow handler does not hold up
+   other connections. Zero maxconns or timeout selects the MHD default. */
+
+typedef struct edgex_rest_server_opts
+{
+  uint64_t maxsize;
+  uint16_t threads;
+  uint16_t workers;
+  uint32_t maxconns;
+  uint32_t timeout;
+} edgex_rest_server_opts;
+
+extern edgex_rest_server *edgex_rest_server_create
+  (iot_logger_t *lc, const char *bindaddr, uint16_t port, const edgex_rest_server_opts *opts, devsdk_error *err);
 
 extern void edgex_rest_server_enable_cors
   (edgex_rest_server *svr, const char *origin, const char *methods, const char *headers, const char *expose, bool creds, int64_t maxage);
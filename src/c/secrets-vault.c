@@ -11,6 +11,9 @@
 #include "edgex-rest.h"
 #include "parson.h"
 #include "errorlist.h"
+#include "jwtcache.h"
+#include "jwks.h"
+#include "devutil.h"
 #include "iot/scheduler.h"
 
 typedef struct vault_impl_t
@@ -27,10 +30,29 @@ typedef struct vault_impl_t
   char *jwtvalidateurl;
   char *capath;
   bool bearer;
+  edgex_jwt_cache_t *jwtcache;
+  uint64_t jwtttl;
+  uint64_t jwtnegttl;
+  edgex_jwks_t *jwks;
+  char *jwksurl;
+  char *jwtaud;
+  uint64_t jwksfetched;
+  pthread_mutex_t jwksmtx;
+  iot_data_t *jwt;
+  uint64_t jwtexpires;
+  bool jwtpending;
+  pthread_mutex_t jwtmtx;
   devsdk_metrics_t *metrics;
   pthread_mutex_t mtx;
 } vault_impl_t;
 
+/* Minimum interval between key set fetches prompted by unknown key ids */
+#define VAULT_JWKS_MINREFRESH 30000
+
+/* An issued JWT is not handed out within this many milliseconds of its
+   expiry, and a failed background refresh is retried after this long */
+#define VAULT_JWT_MARGIN 5000
+
 static void vault_initctx (vault_impl_t *vault, edgex_ctx *ctx)
 {
   memset (ctx, 0, sizeof (edgex_ctx));
@@ -159,6 +181,46 @@ void vault_schedule_renewal (vault_impl_t *vault)
   iot_data_free (info);
 }
 
+/* Fetches the key set unless it was fetched within minage milliseconds.
+   The key set is public, so is fetched without the Vault token. */
+
+static bool vault_fetch_jwks (vault_impl_t *vault, uint64_t minage)
+{
+  bool result = false;
+  devsdk_error err = EDGEX_OK;
+  edgex_ctx ctx;
+  memset (&ctx, 0, sizeof (edgex_ctx));
+  if (vault->capath)
+  {
+    ctx.cacerts_path = vault->capath;
+    ctx.verify_peer = 1;
+  }
+  pthread_mutex_lock (&vault->jwksmtx);
+  uint64_t now = iot_time_msecs ();
+  if (minage == 0 || now - vault->jwksfetched >= minage)
+  {
+    vault->jwksfetched = now;
+    edgex_http_get (vault->lc, &ctx, vault->jwksurl, edgex_http_write_cb, &err);
+    if (err.code == 0)
+    {
+      result = edgex_jwks_update (vault->jwks, ctx.buff);
+    }
+    else
+    {
+      iot_log_error (vault->lc, "vault: unable to fetch signing keys from %s", vault->jwksurl);
+    }
+  }
+  pthread_mutex_unlock (&vault->jwksmtx);
+  vault_freectx (&ctx);
+  return result;
+}
+
+static void *vault_refresh_jwks (void *v)
+{
+  vault_fetch_jwks ((vault_impl_t *)v, 0);
+  return NULL;
+}
+
 static bool vault_init
   (void *impl, iot_logger_t *lc, iot_scheduler_t *sched, iot_threadpool_t *pool, const char *svcname, iot_data_t *config, devsdk_metrics_t *m)
 {
@@ -188,6 +250,8 @@ static bool vault_init
   snprintf (vault->jwtissueurl, URL_BUF_SIZE, "%s/v1/identity/oidc/token/%s", host, svcname);
   vault->jwtvalidateurl = malloc (URL_BUF_SIZE);
   snprintf (vault->jwtvalidateurl, URL_BUF_SIZE, "%s/v1/identity/oidc/introspect", host);
+  vault->jwksurl = malloc (URL_BUF_SIZE);
+  snprintf (vault->jwksurl, URL_BUF_SIZE, "%s/v1/identity/oidc/.well-known/keys", host);
   free (host);
 
   const char *fname = iot_data_string_map_get_string (config, "SecretStore/TokenFile");
@@ -230,6 +294,42 @@ static bool vault_init
   }
   // TODO: SecretStore/ServerName (unsupported in libcurl?)
 
+  uint32_t cachesize = iot_data_ui32 (iot_data_string_map_get (config, "SecretStore/JWTCacheSize"));
+  if (cachesize)
+  {
+    vault->jwtcache = edgex_jwt_cache_alloc (cachesize);
+    vault->jwtttl = edgex_parsetime (iot_data_string_map_get_string (config, "SecretStore/JWTCacheTTL"));
+    vault->jwtnegttl = edgex_parsetime (iot_data_string_map_get_string (config, "SecretStore/JWTNegativeCacheTTL"));
+  }
+
+  if (iot_data_string_map_get_bool (config, "SecretStore/JWTVerifyLocally", false))
+  {
+    if (edgex_jwks_available ())
+    {
+      const char *jwksurl = iot_data_string_map_get_string (config, "SecretStore/JWKSUrl");
+      uint64_t interval = edgex_parsetime (iot_data_string_map_get_string (config, "SecretStore/JWKSRefreshInterval"));
+      if (*jwksurl)
+      {
+        free (vault->jwksurl);
+        vault->jwksurl = strdup (jwksurl);
+      }
+      vault->jwtaud = strdup (iot_data_string_map_get_string (config, "SecretStore/JWTAudience"));
+      vault->jwks = edgex_jwks_alloc (lc);
+      vault_fetch_jwks (vault, 0);
+      if (interval)
+      {
+        iot_schedule_t *job = iot_schedule_create
+          (vault->scheduler, vault_refresh_jwks, NULL, vault, IOT_MS_TO_NS (interval), IOT_MS_TO_NS (interval), 0, vault->thpool, -1);
+        iot_schedule_add (vault->scheduler, job);
+      }
+      iot_log_info (lc, "vault: verifying JWTs locally with keys from %s", vault->jwksurl);
+    }
+    else
+    {
+      iot_log_warn (lc, "vault: JWTVerifyLocally is set but this build lacks OpenSSL; JWTs will be introspected");
+    }
+  }
+
   vault_schedule_renewal (vault);
   return true;
 }
@@ -286,12 +386,15 @@ static void vault_set (void *impl, const char *path, const iot_data_t *secrets)
   vault_freectx (&ctx);
 }
 
-static iot_data_t * vault_requestjwt (void *impl)
+/* Requests a JWT from the issue endpoint, setting its expiry time from
+   its exp claim or, failing that, the ttl in the reply */
+
+static iot_data_t *vault_issue_jwt (vault_impl_t *vault, uint64_t *expires)
 {
   iot_data_t *result = NULL;
-  vault_impl_t *vault = (vault_impl_t *)impl;
-  
+  uint64_t now = iot_time_msecs ();
   iot_data_t *reply = vault_rest_get (vault, vault->jwtissueurl);
+  *expires = 0;
   if (reply)
   {
     const iot_data_t *d = iot_data_string_map_get (reply, "data");
@@ -301,22 +404,159 @@ static iot_data_t * vault_requestjwt (void *impl)
       if (t)
       {
         result = iot_data_copy (t);
+        *expires = edgex_jwt_expiry (iot_data_string (t));
+        if (*expires == 0)
+        {
+          const iot_data_t *ttl = iot_data_string_map_get (d, "ttl");
+          *expires = ttl ? now + 1000 * iot_data_i64 (ttl) : 0;
+        }
       }
     }
   }
+  iot_data_free (reply);
+  return result;
+}
+
+static void *vault_refresh_jwt (void *v);
+
+/* Takes ownership of a newly issued JWT, replacing the cached one, and
+   schedules a refresh three-quarters of the way through its lifetime.
+   Called with jwtmtx held. */
+
+static void vault_store_jwt (vault_impl_t *vault, iot_data_t *jwt, uint64_t expires)
+{
+  uint64_t now = iot_time_msecs ();
+  iot_data_free (vault->jwt);
+  vault->jwt = jwt;
+  vault->jwtexpires = expires;
+  if (expires > now + VAULT_JWT_MARGIN && !vault->jwtpending)
+  {
+    uint64_t delay = (expires - now) / 4 * 3;
+    iot_schedule_t *job = iot_schedule_create (vault->scheduler, vault_refresh_jwt, NULL, vault, 0, IOT_MS_TO_NS (delay), 1, vault->thpool, -1);
+    iot_schedule_add (vault->scheduler, job);
+    vault->jwtpending = true;
+  }
+}
+
+static void *vault_refresh_jwt (void *v)
+{
+  vault_impl_t *vault = (vault_impl_t *)v;
+  uint64_t expires;
+  iot_data_t *jwt = vault_issue_jwt (vault, &expires);
+  pthread_mutex_lock (&vault->jwtmtx);
+  vault->jwtpending = false;
+  if (jwt && expires)
+  {
+    vault_store_jwt (vault, jwt, expires);
+  }
+  else if (jwt)
+  {
+    // Not cacheable; requests will be made on demand from now on
+    iot_data_free (jwt);
+  }
+  else if (vault->jwtexpires > iot_time_msecs () + 2 * VAULT_JWT_MARGIN)
+  {
+    iot_log_warn (vault->lc, "vault: JWT refresh failed, retrying");
+    iot_schedule_t *job = iot_schedule_create (vault->scheduler, vault_refresh_jwt, NULL, vault, 0, IOT_MS_TO_NS (VAULT_JWT_MARGIN), 1, vault->thpool, -1);
+    iot_schedule_add (vault->scheduler, job);
+    vault->jwtpending = true;
+  }
+  pthread_mutex_unlock (&vault->jwtmtx);
+  return NULL;
+}
+
+/* Hands out a reference to the cached JWT. A token is only requested here
+   if there is none yet or the background refresh has fallen behind; the
+   lock then ensures that concurrent callers share one request. */
+
+static iot_data_t * vault_requestjwt (void *impl)
+{
+  iot_data_t *result = NULL;
+  vault_impl_t *vault = (vault_impl_t *)impl;
+
+  pthread_mutex_lock (&vault->jwtmtx);
+  if (vault->jwt == NULL || vault->jwtexpires <= iot_time_msecs () + VAULT_JWT_MARGIN)
+  {
+    uint64_t expires;
+    iot_data_t *jwt = vault_issue_jwt (vault, &expires);
+    if (jwt && expires == 0)
+    {
+      // No expiry is known, so the token cannot be cached, but is valid
+      result = jwt;
+    }
+    else if (jwt)
+    {
+      vault_store_jwt (vault, jwt, expires);
+    }
+  }
+  if (result == NULL && vault->jwt && vault->jwtexpires > iot_time_msecs ())
+  {
+    result = iot_data_add_ref (vault->jwt);
+  }
+  pthread_mutex_unlock (&vault->jwtmtx);
+
   if (result == NULL)
   {
     iot_log_error (vault->lc, "vault: get JWT request failed");
     result = iot_data_alloc_map (IOT_DATA_STRING);
   }
-  iot_data_free (reply);
   return result;
 }
 
+/* Results are cached until the token's expiry or the configured TTL,
+   whichever is sooner. Rejections are cached for the negative TTL. */
+
+static void vault_cache_jwt (vault_impl_t *vault, const char *jwt, bool valid, uint64_t now)
+{
+  if (vault->jwtcache)
+  {
+    uint64_t expires = now + (valid ? vault->jwtttl : vault->jwtnegttl);
+    uint64_t exp = valid ? edgex_jwt_expiry (jwt) : 0;
+    if (exp && exp < expires)
+    {
+      expires = exp;
+    }
+    if (expires > now)
+    {
+      edgex_jwt_cache_put (vault->jwtcache, jwt, valid, expires);
+    }
+  }
+}
+
+/* With local verification, Vault is only contacted to fetch keys when a
+   token names an unknown key, or to introspect tokens which cannot be
+   verified locally. Failures to reach Vault are not cached. */
+
 static bool vault_isjwtvalid (void *impl, const char *jwt)
 {
   bool result = false;
   vault_impl_t *vault = (vault_impl_t *)impl;
+  uint64_t now = iot_time_msecs ();
+
+  if (vault->jwtcache)
+  {
+    edgex_jwt_status status = edgex_jwt_cache_get (vault->jwtcache, jwt, now);
+    if (status != EDGEX_JWT_UNKNOWN)
+    {
+      return status == EDGEX_JWT_VALID;
+    }
+  }
+
+  if (vault->jwks)
+  {
+    bool refresh;
+    edgex_jwt_status status = edgex_jwks_verify (vault->jwks, jwt, vault->jwtaud, now, &refresh);
+    if (status == EDGEX_JWT_UNKNOWN && refresh && vault_fetch_jwks (vault, VAULT_JWKS_MINREFRESH))
+    {
+      status = edgex_jwks_verify (vault->jwks, jwt, vault->jwtaud, now, &refresh);
+    }
+    if (status != EDGEX_JWT_UNKNOWN)
+    {
+      result = (status == EDGEX_JWT_VALID);
+      vault_cache_jwt (vault, jwt, result, now);
+      return result;
+    }
+  }
 
   iot_data_t * body = iot_data_alloc_map(IOT_DATA_STRING);
   iot_data_string_map_add(body, "token", iot_data_alloc_string(jwt, IOT_DATA_REF));
@@ -332,6 +572,7 @@ static bool vault_isjwtvalid (void *impl, const char *jwt)
   if (reply)
   {
     result = iot_data_string_map_get_bool (reply, "active", false);
+    vault_cache_jwt (vault, jwt, result, now);
   }
   iot_data_free (reply);
   return result;
@@ -341,6 +582,13 @@ static void vault_fini (void *impl)
 {
   vault_impl_t *vault = (vault_impl_t *)impl;
   pthread_mutex_destroy (&vault->mtx);
+  edgex_jwt_cache_free (vault->jwtcache);
+  edgex_jwks_free (vault->jwks);
+  pthread_mutex_destroy (&vault->jwksmtx);
+  free (vault->jwksurl);
+  free (vault->jwtaud);
+  iot_data_free (vault->jwt);
+  pthread_mutex_destroy (&vault->jwtmtx);
   free (vault->baseurl);
   free (vault->regurl);
   free (vault->tokinfourl);
@@ -354,6 +602,8 @@ void *edgex_secrets_vault_alloc ()
 {
   vault_impl_t *vault = calloc (1, sizeof (vault_impl_t));
   pthread_mutex_init (&vault->mtx, NULL);
+  pthread_mutex_init (&vault->jwksmtx, NULL);
+  pthread_mutex_init (&vault->jwtmtx, NULL);
   return vault;
 }
 
@@ -11,6 +11,7 @@
 #include "edgex-logging.h"
 #include "bus.h"
 #include "device.h"
+#include "autoevent.h"
 #include "discovery.h"
 #include "callback3.h"
 #include "iot/data.h"
@@ -417,6 +418,7 @@ devsdk_service_t *devsdk_service_new
   *err = EDGEX_OK;
   devsdk_service_t *result = malloc (sizeof (devsdk_service_t));
   memset (result, 0, sizeof (devsdk_service_t));
+  pthread_mutex_init (&result->aelock, NULL);
   result->logger = logger;
   result->config.loglevel = ll;
 
@@ -537,21 +539,16 @@ extern void devsdk_publish_discovery_event (devsdk_service_t *svc, const char *
   iot_data_free (event);
 }
 
-static void devsdk_publish_metric (devsdk_service_t *svc, const char *mname, uint64_t val)
+static void devsdk_publish_metric_fields (devsdk_service_t *svc, const char *mname, iot_data_t *fields, iot_data_t *tags)
 {
-  iot_data_t *field;
-  iot_data_t *fields;
-  iot_data_t *metric;
-
-  field = iot_data_alloc_map (IOT_DATA_STRING);
-  iot_data_string_map_add (field, "name", iot_data_alloc_string ("counter-count", IOT_DATA_REF));
-  iot_data_string_map_add (field, "value", iot_data_alloc_ui64 (val));
-  fields = iot_data_alloc_vector (1);
-  iot_data_vector_add (fields, 0, field);
-  metric = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t *metric = iot_data_alloc_map (IOT_DATA_STRING);
   iot_data_string_map_add (metric, "apiVersion", iot_data_alloc_string (EDGEX_API_VERSION, IOT_DATA_REF));
   iot_data_string_map_add (metric, "name", iot_data_alloc_string (mname, IOT_DATA_REF));
   iot_data_string_map_add (metric, "fields", fields);
+  if (tags)
+  {
+    iot_data_string_map_add (metric, "tags", tags);
+  }
   iot_data_string_map_add (metric, "timestamp", iot_data_alloc_ui64 (iot_time_nsecs ()));
 
   char *topic = edgex_bus_mktopic (svc->msgbus, EDGEX_DEV_TOPIC_METRIC, mname);
@@ -561,6 +558,93 @@ static void devsdk_publish_metric (devsdk_service_t *svc, const char *mname, uin
   iot_data_free (metric);
 }
 
+static void devsdk_metric_add_field (iot_data_t *fields, uint32_t index, const char *name, uint64_t val)
+{
+  iot_data_t *field = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_string_map_add (field, "name", iot_data_alloc_string (name, IOT_DATA_REF));
+  iot_data_string_map_add (field, "value", iot_data_alloc_ui64 (val));
+  iot_data_vector_add (fields, index, field);
+}
+
+static void devsdk_publish_metric_value (devsdk_service_t *svc, const char *mname, const char *fname, uint64_t val)
+{
+  iot_data_t *fields = iot_data_alloc_vector (1);
+  devsdk_metric_add_field (fields, 0, fname, val);
+  devsdk_publish_metric_fields (svc, mname, fields, NULL);
+}
+
+static void devsdk_publish_metric (devsdk_service_t *svc, const char *mname, uint64_t val)
+{
+  devsdk_publish_metric_value (svc, mname, "counter-count", val);
+}
+
+static void devsdk_publish_timer
+  (devsdk_service_t *svc, const char *mname, atomic_uint_fast64_t *sumvar, atomic_uint_fast64_t *countvar, atomic_uint_fast64_t *maxvar)
+{
+  // Timer values cover the period since the last report
+  uint64_t count = atomic_exchange (countvar, 0);
+  uint64_t sum = atomic_exchange (sumvar, 0);
+  uint64_t max = atomic_exchange (maxvar, 0);
+  iot_data_t *fields = iot_data_alloc_vector (3);
+  devsdk_metric_add_field (fields, 0, "timer-count", count);
+  devsdk_metric_add_field (fields, 1, "timer-mean", count ? sum / count : 0);
+  devsdk_metric_add_field (fields, 2, "timer-max", max);
+  devsdk_publish_metric_fields (svc, mname, fields, NULL);
+}
+
+/* Upper bound in ns of the execution time bucket containing the given
+   percentile of runs */
+
+static uint64_t devsdk_ae_percentile (const edgex_autoevent_stats *st, unsigned pct)
+{
+  uint64_t target = (st->runs * pct + 99) / 100;
+  uint64_t seen = 0;
+  for (unsigned b = 0; b < EDGEX_AE_EXEC_BUCKETS - 1; b++)
+  {
+    seen += st->buckets[b];
+    if (seen >= target)
+    {
+      return IOT_MS_TO_NS (1ull << b);
+    }
+  }
+  return st->execmax;
+}
+
+static void devsdk_publish_ae_stats (devsdk_service_t *svc)
+{
+  unsigned n;
+  edgex_autoevent_stats *stats = edgex_device_autoevent_stats (svc, &n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    const edgex_autoevent_stats *st = &stats[i];
+    if (svc->config.metrics.flags & EX_METRIC_AEOVERRUN)
+    {
+      iot_data_t *fields = iot_data_alloc_vector (1);
+      iot_data_t *tags = iot_data_alloc_map (IOT_DATA_STRING);
+      devsdk_metric_add_field (fields, 0, "counter-count", st->overruns);
+      iot_data_string_map_add (tags, "device", iot_data_alloc_string (st->device, IOT_DATA_COPY));
+      iot_data_string_map_add (tags, "source", iot_data_alloc_string (st->resource, IOT_DATA_COPY));
+      devsdk_publish_metric_fields (svc, "AutoEventOverruns", fields, tags);
+    }
+    if ((svc->config.metrics.flags & EX_METRIC_AEEXEC) && st->runs)
+    {
+      iot_data_t *fields = iot_data_alloc_vector (7);
+      iot_data_t *tags = iot_data_alloc_map (IOT_DATA_STRING);
+      devsdk_metric_add_field (fields, 0, "histogram-count", st->runs);
+      devsdk_metric_add_field (fields, 1, "histogram-mean", st->exectotal / st->runs);
+      devsdk_metric_add_field (fields, 2, "histogram-max", st->execmax);
+      devsdk_metric_add_field (fields, 3, "histogram-p50", devsdk_ae_percentile (st, 50));
+      devsdk_metric_add_field (fields, 4, "histogram-p95", devsdk_ae_percentile (st, 95));
+      devsdk_metric_add_field (fields, 5, "histogram-p99", devsdk_ae_percentile (st, 99));
+      devsdk_metric_add_field (fields, 6, "lag-max", st->lagmax);
+      iot_data_string_map_add (tags, "device", iot_data_alloc_string (st->device, IOT_DATA_COPY));
+      iot_data_string_map_add (tags, "source", iot_data_alloc_string (st->resource, IOT_DATA_COPY));
+      devsdk_publish_metric_fields (svc, "AutoEventExecutionTime", fields, tags);
+    }
+  }
+  edgex_device_autoevent_stats_free (stats, n);
+}
+
 static void *devsdk_run_metrics (void *p)
 {
   devsdk_service_t *svc = (devsdk_service_t *)p;
@@ -571,11 +655,35 @@ static void *devsdk_run_metrics (void *p)
   if (svc->config.metrics.flags & EX_METRIC_RDCMDS) devsdk_publish_metric (svc, "ReadCommandsExecuted", atomic_load (&svc->metrics.rcexe));
   if (svc->config.metrics.flags & EX_METRIC_SECREQ) devsdk_publish_metric (svc, "SecuritySecretsRequested", atomic_load (&svc->metrics.secrq));
   if (svc->config.metrics.flags & EX_METRIC_SECSTO) devsdk_publish_metric (svc, "SecuritySecretsStored", atomic_load (&svc->metrics.secsto));
+  if (svc->config.metrics.flags & EX_METRIC_EVQDEPTH) devsdk_publish_metric_value (svc, "EventQueueDepth", "gauge-value", edgex_eventq_depth (svc->events));
+  if (svc->config.metrics.flags & EX_METRIC_EVQDROP) devsdk_publish_metric (svc, "EventQueueDropped", atomic_load (&svc->metrics.evqdrop));
+  if (svc->config.metrics.flags & EX_METRIC_EVQLAT)
+    devsdk_publish_timer (svc, "EventQueueLatency", &svc->metrics.evqlatsum, &svc->metrics.evqlatcount, &svc->metrics.evqlatmax);
+  if (svc->config.metrics.flags & EX_METRIC_CMDQDEPTH) devsdk_publish_metric_value (svc, "CommandQueueDepth", "gauge-value", svc->cmdq ? edgex_cmdq_depth (svc->cmdq) : 0);
+  if (svc->config.metrics.flags & EX_METRIC_CMDQWAIT)
+    devsdk_publish_timer (svc, "CommandQueueWait", &svc->metrics.cmdqwaitsum, &svc->metrics.cmdqwaitcount, &svc->metrics.cmdqwaitmax);
+  if (svc->config.metrics.flags & (EX_METRIC_BUSINFLIGHT | EX_METRIC_BUSBUFFERED | EX_METRIC_BUSFAILED | EX_METRIC_BUSSPOOLED))
+  {
+    edgex_bus_stats st;
+    edgex_bus_get_stats (svc->msgbus, &st);
+    if (svc->config.metrics.flags & EX_METRIC_BUSINFLIGHT) devsdk_publish_metric_value (svc, "MessageBusInFlight", "gauge-value", st.inflight);
+    if (svc->config.metrics.flags & EX_METRIC_BUSBUFFERED) devsdk_publish_metric_value (svc, "MessageBusBuffered", "gauge-value", st.buffered);
+    if (svc->config.metrics.flags & EX_METRIC_BUSFAILED) devsdk_publish_metric (svc, "MessageBusFailed", st.failed);
+    if (svc->config.metrics.flags & EX_METRIC_BUSSPOOLED) devsdk_publish_metric_value (svc, "MessageBusSpooled", "gauge-value", st.spooled);
+  }
+  if (svc->config.metrics.flags & (EX_METRIC_AEOVERRUN | EX_METRIC_AEEXEC)) devsdk_publish_ae_stats (svc);
   edgex_device_free_crlid ();
 
   return NULL;
 }
 
+static void *devsdk_flush_lastconnected (void *p)
+{
+  devsdk_service_t *svc = (devsdk_service_t *)p;
+  edgex_lastconnected_flush (svc->lastconn);
+  return NULL;
+}
+
 void devsdk_schedule_metrics (devsdk_service_t *svc)
 {
   uint64_t interval = edgex_parsetime (svc->config.metrics.interval);
@@ -737,6 +845,17 @@ static void startConfigured (devsdk_service_t *svc, const devsdk_timeout *deadli
   char *topic;
   svc->adminstate = UNLOCKED;
 
+  /* LastConnected updates may be recorded as soon as devices are added */
+
+  uint64_t lcinterval = edgex_parsetime (svc->config.device.lcinterval);
+  if (lcinterval == 0)
+  {
+    lcinterval = EDGEX_LC_DEFAULT_INTERVAL;
+  }
+  svc->lastconn = edgex_lastconnected_alloc (svc);
+  svc->lcschedule = iot_schedule_create (svc->scheduler, devsdk_flush_lastconnected, NULL, svc, IOT_MS_TO_NS (lcinterval), 0, 0, svc->thpool, -1);
+  iot_schedule_add (svc->scheduler, svc->lcschedule);
+
   svc->eventq = iot_threadpool_alloc (1, svc->config.device.eventqlen, IOT_THREAD_NO_PRIORITY, IOT_THREAD_NO_AFFINITY, svc->logger);
   iot_threadpool_start (svc->eventq);
 
@@ -746,6 +865,14 @@ static void startConfigured (devsdk_service_t *svc, const devsdk_timeout *deadli
   {
     svc->msgbus = edgex_bus_create_mqtt (svc->logger, svc->name, svc->config.sdkconf, svc->secretstore, svc->eventq, deadline);
   }
+  else if (strcmp (bustype, "local") == 0)
+  {
+    svc->msgbus = edgex_bus_create_local (svc->logger, svc->name, svc->config.sdkconf, svc->localsink, svc->localsinkctx);
+  }
+  else if (strcmp (bustype, "shm") == 0)
+  {
+    svc->msgbus = edgex_bus_create_shm (svc->logger, svc->name, svc->config.sdkconf);
+  }
   else
   {
     iot_log_error (svc->logger, "Unknown Message Bus type %s", bustype);
@@ -755,6 +882,18 @@ static void startConfigured (devsdk_service_t *svc, const devsdk_timeout *deadli
     *err = EDGEX_REMOTE_SERVER_DOWN;
     return;
   }
+  svc->events = edgex_eventq_alloc
+    (svc->logger, svc->msgbus, &svc->metrics, svc->config.device.eventqlen, edgex_eventq_policy_fromstring (svc->config.device.eventqpolicy));
+  edgex_eventq_start (svc->events, svc->eventq);
+
+  if (svc->config.device.cmdworkers)
+  {
+    svc->cmdpool = iot_threadpool_alloc (svc->config.device.cmdworkers, 0, IOT_THREAD_NO_PRIORITY, IOT_THREAD_NO_AFFINITY, svc->logger);
+    iot_threadpool_start (svc->cmdpool);
+    svc->cmdq = edgex_cmdq_alloc (svc->logger, &svc->metrics, svc->config.device.cmdqlen);
+    edgex_cmdq_start (svc->cmdq, svc->cmdpool);
+    edgex_bus_set_cmdq (svc->msgbus, svc->cmdq);
+  }
 
   /* Wait for core-metadata to be available */
 
@@ -870,7 +1009,15 @@ static void startConfigured (devsdk_service_t *svc, const devsdk_timeout *deadli
   /* Start REST server now so that we get the callbacks on device addition */
 
   const char *bindaddr = strlen (svc->config.service.bindaddr) ? svc->config.service.bindaddr : svc->config.service.host;
-  svc->daemon = edgex_rest_server_create (svc->logger, bindaddr, svc->config.service.port, svc->config.service.maxreqsz, err);
+  edgex_rest_server_opts httpopts =
+  {
+    .maxsize = svc->config.service.maxreqsz,
+    .threads = svc->config.service.httpthreads,
+    .workers = svc->config.service.httpworkers,
+    .maxconns = svc->config.service.maxconns,
+    .timeout = (svc->config.service.conntimeout + 999) / 1000
+  };
+  svc->daemon = edgex_rest_server_create (svc->logger, bindaddr, svc->config.service.port, &httpopts, err);
   if (err->code)
   {
     return;
@@ -1395,12 +1542,16 @@ void devsdk_post_readings
   }
 
   const edgex_cmdinfo *command = edgex_deviceprofile_findcommand (svc, resname, dev->profile, true);
-  edgex_device_release (svc, dev);
 
   if (command)
   {
     edgex_event_cooked *event = edgex_data_process_event
       (dev, command, values, tags, svc->config.device.datatransform, svc->reduced_events);
+    if (event && svc->config.device.updatelastconnected)
+    {
+      edgex_lastconnected_record (svc->lastconn, dev);
+    }
+    edgex_device_release (svc, dev);
 
     if (event)
     {
@@ -1411,13 +1562,7 @@ void devsdk_post_readings
       }
       else
       {
-        edgex_data_client_add_event (svc->msgbus, event, &svc->metrics);
-      }
-
-      if (svc->config.device.updatelastconnected)
-      {
-        devsdk_error err = EDGEX_OK;
-        edgex_metadata_client_update_lastconnected (svc->logger, &svc->config.endpoints, svc->secretstore, devname, &err);
+        edgex_eventq_push (svc->events, event);
       }
       edgex_device_free_crlid();
       edgex_event_cooked_free (event);
@@ -1425,10 +1570,22 @@ void devsdk_post_readings
   }
   else
   {
+    edgex_device_release (svc, dev);
     iot_log_error (svc->logger, "Post readings: no such resource %s", resname);
   }
 }
 
+void devsdk_set_local_bus_sink (devsdk_service_t *svc, devsdk_bus_sink sink, void *ctx)
+{
+  svc->localsink = sink;
+  svc->localsinkctx = ctx;
+}
+
+bool devsdk_local_bus_send (devsdk_service_t *svc, const char *topic, const void *envelope, size_t len)
+{
+  return edgex_bus_local_inject (svc->msgbus, topic, envelope, len);
+}
+
 iot_data_t *devsdk_get_secrets (devsdk_service_t *svc, const char *path)
 {
   return edgex_secrets_get (svc->secretstore, path);
@@ -1454,6 +1611,10 @@ void devsdk_service_stop (devsdk_service_t *svc, bool force, devsdk_error *err)
   {
     iot_schedule_delete (svc->scheduler, svc->metricschedule);
   }
+  if (svc->lcschedule)
+  {
+    iot_schedule_delete (svc->scheduler, svc->lcschedule);
+  }
   if (svc->scheduler)
   {
     iot_scheduler_stop (svc->scheduler);
@@ -1466,8 +1627,20 @@ void devsdk_service_stop (devsdk_service_t *svc, bool force, devsdk_error *err)
       iot_log_error (svc->logger, "Unable to deregister service from registry");
     }
   }
-  iot_threadpool_wait (svc->eventq);
+  if (svc->cmdq)
+  {
+    edgex_cmdq_stop (svc->cmdq);
+  }
   iot_threadpool_wait (svc->thpool);
+  if (svc->lastconn)
+  {
+    edgex_lastconnected_flush (svc->lastconn);
+  }
+  if (svc->events)
+  {
+    edgex_eventq_stop (svc->events);
+  }
+  iot_threadpool_wait (svc->eventq);
   svc->userfns.stop (svc->userdata, force);
   edgex_devmap_clear (svc->devices);
   iot_log_info (svc->logger, "Stopped device service");
@@ -1479,11 +1652,17 @@ void devsdk_service_free (devsdk_service_t *svc)
   {
     iot_scheduler_free (svc->scheduler);
     edgex_devmap_free (svc->devices);
+    edgex_eventq_free (svc->events);
+    edgex_lastconnected_free (svc->lastconn);
     edgex_bus_free (svc->msgbus);
+    edgex_cmdq_free (svc->cmdq);
+    iot_threadpool_free (svc->cmdpool);
     edgex_watchlist_free (svc->watchlist);
     edgex_device_periodic_discovery_free (svc->discovery);
     iot_threadpool_free (svc->thpool);
     iot_threadpool_free (svc->eventq);
+    edgex_device_autoevent_fini (svc);
+    pthread_mutex_destroy (&svc->aelock);
     devsdk_registry_free (svc->registry);
     edgex_secrets_fini (svc->secretstore);
     iot_logger_free (svc->logger);
@@ -21,6 +21,9 @@
 #include "iot/threadpool.h"
 #include "iot/scheduler.h"
 #include "request_auth.h"
+#include "eventq.h"
+#include "cmdq.h"
+#include "lastconnected.h"
 
 struct devsdk_callbacks
 {
@@ -69,6 +72,10 @@ struct devsdk_service_t
   uint64_t starttime;
   devsdk_metrics_t metrics;
   iot_schedule_t *metricschedule;
+  iot_schedule_t *lcschedule;
+  edgex_lastconnected_t *lastconn;
+  pthread_mutex_t aelock;
+  struct edgex_aestats *aestats;
   bool overwriteconfig;
   bool overwritedevices;
   bool overwriteprofiles;
@@ -85,6 +92,11 @@ struct devsdk_service_t
   edgex_watchlist_t *watchlist;
   iot_threadpool_t *thpool;
   iot_threadpool_t *eventq;
+  edgex_eventq_t *events;
+  iot_threadpool_t *cmdpool;
+  devsdk_bus_sink localsink;
+  void *localsinkctx;
+  edgex_cmdq_t *cmdq;
   iot_scheduler_t *scheduler;
 
   auth_wrapper_t callback_profile_wrapper;
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "spool.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define EDGEX_SPOOL_MAGIC 0x4c505345
+#define EDGEX_SPOOL_VERSION 1
+#define EDGEX_SPOOL_ALIGN 8
+#define EDGEX_SPOOL_SUFFIX ".seg"
+#define EDGEX_SPOOL_NAMELEN 20
+
+#define EDGEX_SPOOL_ALIGNED(n) (((n) + EDGEX_SPOOL_ALIGN - 1) & ~(size_t)(EDGEX_SPOOL_ALIGN - 1))
+
+/* Segment layout: a header, then records of a topic (with terminator) and
+   data, padded to the alignment. The file is zero-filled when created, so a
+   zero length marks the end of the records. The check is a hash of the
+   record's contents, so that a record torn by a crash is recognized. */
+
+typedef struct edgex_spool_seghdr
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t readpos;
+} edgex_spool_seghdr;
+
+typedef struct edgex_spool_rec
+{
+  uint32_t len;
+  uint32_t topiclen;
+  uint32_t datalen;
+  uint32_t flags;
+  uint32_t check;
+} edgex_spool_rec;
+
+typedef struct edgex_spool_seg
+{
+  uint64_t seq;
+  uint8_t *map;
+} edgex_spool_seg;
+
+struct edgex_spool_t
+{
+  iot_logger_t *lc;
+  char *dir;
+  uint32_t segsize;
+  uint32_t maxsegs;
+  edgex_spool_policy policy;
+  edgex_spool_seg *segs;   // Oldest first; only the oldest and newest are mapped
+  uint32_t nsegs;
+  uint32_t capacity;
+  uint64_t nextseq;        // Sequence number for the next new segment
+  uint32_t wpos;
+  uint64_t sendseq;        // Send position, in the oldest segment only
+  uint32_t sendpos;
+  uint64_t count;
+  pthread_mutex_t mtx;
+};
+
+edgex_spool_policy edgex_spool_policy_fromstring (const char *str)
+{
+  if (str && strcasecmp (str, "DropNewest") == 0)
+  {
+    return EDGEX_SPOOL_DROP_NEWEST;
+  }
+  return EDGEX_SPOOL_DROP_OLDEST;
+}
+
+static uint32_t edgex_spool_hash (const uint8_t *p, size_t len)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+  {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static char *edgex_spool_segpath (const edgex_spool_t *sp, uint64_t seq)
+{
+  char *path = malloc (strlen (sp->dir) + EDGEX_SPOOL_NAMELEN + 2);
+  sprintf (path, "%s/%016" PRIx64 EDGEX_SPOOL_SUFFIX, sp->dir, seq);
+  return path;
+}
+
+static inline edgex_spool_seghdr *edgex_spool_hdr (const edgex_spool_seg *seg)
+{
+  return (edgex_spool_seghdr *)seg->map;
+}
+
+/* Returns the record at off if it is complete and lies within limit */
+
+static const edgex_spool_rec *edgex_spool_record (const uint8_t *map, uint32_t off, uint32_t limit)
+{
+  if (off + sizeof (edgex_spool_rec) > limit)
+  {
+    return NULL;
+  }
+  const edgex_spool_rec *rec = (const edgex_spool_rec *)(map + off);
+  if (rec->len == 0 || rec->len > limit - off || rec->topiclen == 0 ||
+      rec->len != EDGEX_SPOOL_ALIGNED (sizeof (edgex_spool_rec) + (uint64_t)rec->topiclen + rec->datalen) ||
+      rec->check != edgex_spool_hash ((const uint8_t *)(rec + 1), rec->topiclen + rec->datalen))
+  {
+    return NULL;
+  }
+  return rec;
+}
+
+/* The limit of valid records in a segment; for the newest, the write position */
+
+static uint32_t edgex_spool_limit (const edgex_spool_t *sp, uint32_t i)
+{
+  return (i == sp->nsegs - 1) ? sp->wpos : edgex_spool_hdr (&sp->segs[i])->size;
+}
+
+static uint64_t edgex_spool_remaining (const edgex_spool_t *sp, uint32_t i, uint32_t *end)
+{
+  const uint8_t *map = sp->segs[i].map;
+  uint32_t limit = (i == sp->nsegs - 1 && sp->wpos) ? sp->wpos : edgex_spool_hdr (&sp->segs[i])->size;
+  uint32_t off = edgex_spool_hdr (&sp->segs[i])->readpos;
+  const edgex_spool_rec *rec;
+  uint64_t n = 0;
+  while ((rec = edgex_spool_record (map, off, limit)))
+  {
+    off += rec->len;
+    n++;
+  }
+  if (end)
+  {
+    *end = off;
+  }
+  return n;
+}
+
+static uint8_t *edgex_spool_map (edgex_spool_t *sp, uint64_t seq, bool create)
+{
+  char *path = edgex_spool_segpath (sp, seq);
+  uint8_t *map = NULL;
+  size_t size = sp->segsize;
+  struct stat st;
+  int fd = open (path, create ? (O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC) : (O_RDWR | O_CLOEXEC), 0640);
+  if (fd < 0)
+  {
+    iot_log_error (sp->lc, "spool: unable to open %s: %s", path, strerror (errno));
+    free (path);
+    return NULL;
+  }
+  if (create)
+  {
+    // Reserve the space now, so that a full disk is not met as a fault on
+    // writing through the mapping
+#ifdef __linux__
+    int rc = posix_fallocate (fd, 0, size);
+#else
+    int rc = ftruncate (fd, size) ? errno : 0;
+#endif
+    if (rc != 0)
+    {
+      iot_log_error (sp->lc, "spool: unable to allocate %s: %s", path, strerror (rc));
+      close (fd);
+      unlink (path);
+      free (path);
+      return NULL;
+    }
+  }
+  else
+  {
+    if (fstat (fd, &st) != 0 || st.st_size < (off_t)sizeof (edgex_spool_seghdr) || st.st_size > UINT32_MAX)
+    {
+      iot_log_error (sp->lc, "spool: ignoring %s, which is not a segment", path);
+      close (fd);
+      free (path);
+      return NULL;
+    }
+    size = st.st_size;
+  }
+  void *m = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (m == MAP_FAILED)
+  {
+    iot_log_error (sp->lc, "spool: unable to map %s: %s", path, strerror (errno));
+    if (create)
+    {
+      unlink (path);
+    }
+    free (path);
+    return NULL;
+  }
+  map = (uint8_t *)m;
+  edgex_spool_seghdr *hdr = (edgex_spool_seghdr *)map;
+  if (create)
+  {
+    hdr->version = EDGEX_SPOOL_VERSION;
+    hdr->size = size;
+    hdr->readpos = sizeof (edgex_spool_seghdr);
+    hdr->magic = EDGEX_SPOOL_MAGIC;
+  }
+  else if (hdr->magic != EDGEX_SPOOL_MAGIC || hdr->version != EDGEX_SPOOL_VERSION || hdr->size != size ||
+           hdr->readpos < sizeof (edgex_spool_seghdr) || hdr->readpos > size)
+  {
+    iot_log_error (sp->lc, "spool: ignoring %s, which is not a valid segment", path);
+    munmap (map, size);
+    map = NULL;
+  }
+  free (path);
+  return map;
+}
+
+static void edgex_spool_unmap (edgex_spool_seg *seg)
+{
+  if (seg->map)
+  {
+    munmap (seg->map, edgex_spool_hdr (seg)->size);
+    seg->map = NULL;
+  }
+}
+
+static void edgex_spool_delete_oldest (edgex_spool_t *sp)
+{
+  char *path = edgex_spool_segpath (sp, sp->segs[0].seq);
+  edgex_spool_unmap (&sp->segs[0]);
+  if (unlink (path) != 0)
+  {
+    iot_log_warn (sp->lc, "spool: unable to remove %s: %s", path, strerror (errno));
+  }
+  free (path);
+  sp->nsegs--;
+  memmove (sp->segs, sp->segs + 1, sp->nsegs * sizeof (edgex_spool_seg));
+  if (sp->nsegs && sp->segs[0].map == NULL)
+  {
+    sp->segs[0].map = edgex_spool_map (sp, sp->segs[0].seq, false);
+    if (sp->segs[0].map == NULL)
+    {
+      // Unreadable; skip over it
+      edgex_spool_delete_oldest (sp);
+    }
+  }
+}
+
+/* Removes consumed segments other than the newest */
+
+static void edgex_spool_trim (edgex_spool_t *sp)
+{
+  while (sp->nsegs > 1)
+  {
+    const edgex_spool_seghdr *hdr = edgex_spool_hdr (&sp->segs[0]);
+    if (edgex_spool_record (sp->segs[0].map, hdr->readpos, hdr->size))
+    {
+      break;
+    }
+    edgex_spool_delete_oldest (sp);
+  }
+}
+
+static bool edgex_spool_add_segment (edgex_spool_t *sp)
+{
+  if (sp->nsegs >= sp->maxsegs)
+  {
+    if (sp->policy == EDGEX_SPOOL_DROP_NEWEST)
+    {
+      return false;
+    }
+    uint64_t lost = edgex_spool_remaining (sp, 0, NULL);
+    iot_log_warn (sp->lc, "spool: full, discarding %" PRIu64 " oldest messages", lost);
+    sp->count -= lost;
+    edgex_spool_delete_oldest (sp);
+  }
+  uint64_t seq = sp->nextseq++;
+  uint8_t *map = edgex_spool_map (sp, seq, true);
+  if (map == NULL)
+  {
+    return false;
+  }
+  if (sp->nsegs > 1)
+  {
+    edgex_spool_unmap (&sp->segs[sp->nsegs - 1]);
+  }
+  if (sp->nsegs == sp->capacity)
+  {
+    sp->capacity = sp->capacity ? sp->capacity * 2 : 8;
+    sp->segs = realloc (sp->segs, sp->capacity * sizeof (edgex_spool_seg));
+  }
+  sp->segs[sp->nsegs].seq = seq;
+  sp->segs[sp->nsegs].map = map;
+  sp->nsegs++;
+  sp->wpos = sizeof (edgex_spool_seghdr);
+  edgex_spool_trim (sp);
+  return true;
+}
+
+bool edgex_spool_append (edgex_spool_t *sp, const char *topic, const void *data, size_t len, uint32_t flags)
+{
+  size_t topiclen = strlen (topic) + 1;
+  size_t reclen = EDGEX_SPOOL_ALIGNED (sizeof (edgex_spool_rec) + topiclen + len);
+  bool ok = true;
+
+  if (reclen > sp->segsize - sizeof (edgex_spool_seghdr))
+  {
+    iot_log_error (sp->lc, "spool: message of %zu bytes for %s exceeds the segment size", len, topic);
+    return false;
+  }
+  pthread_mutex_lock (&sp->mtx);
+  if (sp->nsegs == 0 || sp->wpos + reclen > edgex_spool_hdr (&sp->segs[sp->nsegs - 1])->size)
+  {
+    ok = edgex_spool_add_segment (sp);
+  }
+  if (ok)
+  {
+    edgex_spool_rec *rec = (edgex_spool_rec *)(sp->segs[sp->nsegs - 1].map + sp->wpos);
+    uint8_t *body = (uint8_t *)(rec + 1);
+    memcpy (body, topic, topiclen);
+    memcpy (body + topiclen, data, len);
+    rec->topiclen = topiclen;
+    rec->datalen = len;
+    rec->flags = flags;
+    rec->check = edgex_spool_hash (body, topiclen + len);
+    rec->len = reclen;
+    sp->wpos += reclen;
+    sp->count++;
+  }
+  pthread_mutex_unlock (&sp->mtx);
+  return ok;
+}
+
+/* Messages are taken for sending from the oldest segment only, so that
+   the send position never refers to an unmapped segment. Sending resumes
+   in the next segment once this one has been consumed. */
+
+void *edgex_spool_next (edgex_spool_t *sp, const char **topic, const void **data, size_t *len, uint32_t *flags, uint64_t *id)
+{
+  void *result = NULL;
+  pthread_mutex_lock (&sp->mtx);
+  if (sp->nsegs)
+  {
+    const edgex_spool_seghdr *hdr = edgex_spool_hdr (&sp->segs[0]);
+    if (sp->sendseq != sp->segs[0].seq || sp->sendpos < hdr->readpos)
+    {
+      sp->sendseq = sp->segs[0].seq;
+      sp->sendpos = hdr->readpos;
+    }
+    const edgex_spool_rec *rec = edgex_spool_record (sp->segs[0].map, sp->sendpos, edgex_spool_limit (sp, 0));
+    if (rec)
+    {
+      size_t n = rec->topiclen + rec->datalen;
+      result = malloc (n);
+      memcpy (result, rec + 1, n);
+      *topic = (const char *)result;
+      *data = (const uint8_t *)result + rec->topiclen;
+      *len = rec->datalen;
+      *flags = rec->flags;
+      *id = (sp->sendseq << 32) | sp->sendpos;
+      sp->sendpos += rec->len;
+    }
+  }
+  pthread_mutex_unlock (&sp->mtx);
+  return result;
+}
+
+void edgex_spool_rewind (edgex_spool_t *sp)
+{
+  pthread_mutex_lock (&sp->mtx);
+  sp->sendseq = 0;
+  pthread_mutex_unlock (&sp->mtx);
+}
+
+void edgex_spool_consume (edgex_spool_t *sp, uint64_t id)
+{
+  pthread_mutex_lock (&sp->mtx);
+  if (sp->nsegs && sp->segs[0].seq == (id >> 32))
+  {
+    edgex_spool_seghdr *hdr = edgex_spool_hdr (&sp->segs[0]);
+    uint32_t limit = edgex_spool_limit (sp, 0);
+    const edgex_spool_rec *rec;
+    while (hdr->readpos <= (uint32_t)id && (rec = edgex_spool_record (sp->segs[0].map, hdr->readpos, limit)))
+    {
+      hdr->readpos += rec->len;
+      sp->count--;
+    }
+    edgex_spool_trim (sp);
+  }
+  pthread_mutex_unlock (&sp->mtx);
+}
+
+uint64_t edgex_spool_count (edgex_spool_t *sp)
+{
+  pthread_mutex_lock (&sp->mtx);
+  uint64_t result = sp->count;
+  pthread_mutex_unlock (&sp->mtx);
+  return result;
+}
+
+static int edgex_spool_segcmp (const void *a, const void *b)
+{
+  uint64_t x = ((const edgex_spool_seg *)a)->seq;
+  uint64_t y = ((const edgex_spool_seg *)b)->seq;
+  return (x > y) - (x < y);
+}
+
+edgex_spool_t *edgex_spool_open (iot_logger_t *lc, const char *dir, uint32_t segsize, uint64_t maxsize, edgex_spool_policy policy)
+{
+  if (mkdir (dir, 0750) != 0 && errno != EEXIST)
+  {
+    iot_log_error (lc, "spool: unable to create directory %s: %s", dir, strerror (errno));
+    return NULL;
+  }
+  DIR *d = opendir (dir);
+  if (d == NULL)
+  {
+    iot_log_error (lc, "spool: unable to read directory %s: %s", dir, strerror (errno));
+    return NULL;
+  }
+
+  edgex_spool_t *sp = calloc (1, sizeof (edgex_spool_t));
+  sp->lc = lc;
+  sp->dir = strdup (dir);
+  sp->segsize = EDGEX_SPOOL_ALIGNED (segsize < 4096 ? 4096 : segsize);
+  sp->maxsegs = maxsize / sp->segsize;
+  if (sp->maxsegs < 2)
+  {
+    sp->maxsegs = 2;
+  }
+  sp->policy = policy;
+  sp->nextseq = 1;
+  pthread_mutex_init (&sp->mtx, NULL);
+
+  struct dirent *ent;
+  while ((ent = readdir (d)))
+  {
+    char *end;
+    if (strlen (ent->d_name) != EDGEX_SPOOL_NAMELEN || strcmp (ent->d_name + 16, EDGEX_SPOOL_SUFFIX) != 0)
+    {
+      continue;
+    }
+    uint64_t seq = strtoull (ent->d_name, &end, 16);
+    if (end != ent->d_name + 16)
+    {
+      continue;
+    }
+    if (seq >= sp->nextseq)
+    {
+      // Names of unreadable segments are not reused, in case they persist
+      sp->nextseq = seq + 1;
+    }
+    if (sp->nsegs == sp->capacity)
+    {
+      sp->capacity = sp->capacity ? sp->capacity * 2 : 8;
+      sp->segs = realloc (sp->segs, sp->capacity * sizeof (edgex_spool_seg));
+    }
+    sp->segs[sp->nsegs].seq = seq;
+    sp->segs[sp->nsegs].map = NULL;
+    sp->nsegs++;
+  }
+  closedir (d);
+  if (sp->nsegs)
+  {
+    qsort (sp->segs, sp->nsegs, sizeof (edgex_spool_seg), edgex_spool_segcmp);
+  }
+
+  // Count the messages left from a previous run, removing segments which
+  // can't be read, such as one left empty by a crash while it was created
+  uint32_t i = 0;
+  uint32_t end = 0;
+  while (i < sp->nsegs)
+  {
+    edgex_spool_seg *seg = &sp->segs[i];
+    seg->map = edgex_spool_map (sp, seg->seq, false);
+    if (seg->map == NULL)
+    {
+      char *path = edgex_spool_segpath (sp, seg->seq);
+      if (unlink (path) != 0)
+      {
+        iot_log_warn (lc, "spool: unable to remove %s: %s", path, strerror (errno));
+      }
+      free (path);
+      sp->nsegs--;
+      memmove (seg, seg + 1, (sp->nsegs - i) * sizeof (edgex_spool_seg));
+      continue;
+    }
+    sp->count += edgex_spool_remaining (sp, i, &end);
+    i++;
+  }
+
+  // Writing resumes after the last complete record of the newest segment.
+  // Clear anything following it, then keep only the oldest and newest
+  // segments mapped
+  if (sp->nsegs)
+  {
+    edgex_spool_seg *seg = &sp->segs[sp->nsegs - 1];
+    memset (seg->map + end, 0, edgex_spool_hdr (seg)->size - end);
+    sp->wpos = end;
+  }
+  for (i = 1; i + 1 < sp->nsegs; i++)
+  {
+    edgex_spool_unmap (&sp->segs[i]);
+  }
+  edgex_spool_trim (sp);
+  if (sp->count)
+  {
+    iot_log_info (lc, "spool: %" PRIu64 " messages held in %s", sp->count, dir);
+  }
+  return sp;
+}
+
+void edgex_spool_close (edgex_spool_t *sp)
+{
+  if (sp)
+  {
+    for (uint32_t i = 0; i < sp->nsegs; i++)
+    {
+      edgex_spool_unmap (&sp->segs[i]);
+    }
+    free (sp->segs);
+    free (sp->dir);
+    pthread_mutex_destroy (&sp->mtx);
+    free (sp);
+  }
+}
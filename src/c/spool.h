@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_SPOOL_H_
+#define _EDGEX_SPOOL_H_ 1
+
+#include <iot/logger.h>
+
+/* Persistent FIFO of messages, each a topic and an encoded envelope, held in
+ * a directory of fixed-size, memory-mapped segment files. Messages are
+ * appended to the newest segment and consumed from the oldest; a segment is
+ * deleted once it has been consumed. Sending and consuming are separate, so
+ * that a message stays in the spool until its delivery is confirmed. The
+ * read position is kept in each segment's header, so a spool reopened after
+ * a restart continues from the first unconsumed message.
+ *
+ * Disk usage is bounded by the maximum size, rounded down to a whole number
+ * of segments. When a new segment would exceed it, the overflow policy
+ * determines whether the oldest segment is discarded or the new message is
+ * refused. All operations are thread-safe.
+ */
+
+typedef struct edgex_spool_t edgex_spool_t;
+
+typedef enum
+{
+  EDGEX_SPOOL_DROP_OLDEST,
+  EDGEX_SPOOL_DROP_NEWEST
+} edgex_spool_policy;
+
+edgex_spool_policy edgex_spool_policy_fromstring (const char *str);
+
+/* Opens or creates a spool in dir, creating the directory if need be.
+   Returns NULL on error. */
+edgex_spool_t *edgex_spool_open (iot_logger_t *lc, const char *dir, uint32_t segsize, uint64_t maxsize, edgex_spool_policy policy);
+
+/* Returns false if the message could not be stored. The flags are stored
+   with the message, for the caller's use. */
+bool edgex_spool_append (edgex_spool_t *sp, const char *topic, const void *data, size_t len, uint32_t flags);
+
+/* Copies out the next message to send, and moves the send position past
+   it. The topic and data point into the returned buffer, which the caller
+   frees. Returns NULL if there is no message to send; that may be because
+   all those available have been sent but are not yet consumed. */
+void *edgex_spool_next (edgex_spool_t *sp, const char **topic, const void **data, size_t *len, uint32_t *flags, uint64_t *id);
+
+/* Moves the send position back to the oldest message, so that messages sent
+   but not consumed are sent again */
+void edgex_spool_rewind (edgex_spool_t *sp);
+
+/* Removes the message with the given id, and any older ones, once their
+   delivery is confirmed. Unknown ids are ignored. */
+void edgex_spool_consume (edgex_spool_t *sp, uint64_t id);
+
+/* The number of messages held */
+uint64_t edgex_spool_count (edgex_spool_t *sp);
+
+void edgex_spool_close (edgex_spool_t *sp);
+
+#endif
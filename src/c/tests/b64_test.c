@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "test.h"
+#include "b64.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+unsigned edgex_test_failures = 0;
+
+/* Test vectors from RFC 4648 section 10 */
+
+static const struct { const char *dec; const char *enc; } rfc4648[] =
+{
+  { "", "" }, { "f", "Zg==" }, { "fo", "Zm8=" }, { "foo", "Zm9v" },
+  { "foob", "Zm9vYg==" }, { "fooba", "Zm9vYmE=" }, { "foobar", "Zm9vYmFy" }
+};
+
+/* Encodings of the first len bytes of 0, 1, ... 255. The SSSE3 encoder
+   handles 12 bytes per step given at least 16 bytes of input, and the
+   decoder 16 characters per step given at least 24, so these lengths
+   cover the vector paths with each possible scalar tail. */
+
+static const struct { size_t len; const char *enc; } prefixes[] =
+{
+  { 15,
+    "AAECAwQFBgcICQoLDA0O" },
+  { 16,
+    "AAECAwQFBgcICQoLDA0ODw==" },
+  { 17,
+    "AAECAwQFBgcICQoLDA0ODxA=" },
+  { 18,
+    "AAECAwQFBgcICQoLDA0ODxAR" },
+  { 19,
+    "AAECAwQFBgcICQoLDA0ODxAREg==" },
+  { 27,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBka" },
+  { 28,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGw==" },
+  { 29,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxw=" },
+  { 30,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwd" },
+  { 47,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4=" },
+  { 48,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4v" },
+  { 49,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4vMA==" },
+  { 50,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4vMDE=" },
+  { 100,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4vMDEyMzQ1Njc4OTo7PD0+P0BB"
+    "QkNERUZHSElKS0xNTk9QUVJTVFVWV1hZWltcXV5fYGFiYw==" },
+  { 255,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4vMDEyMzQ1Njc4OTo7PD0+P0BB"
+    "QkNERUZHSElKS0xNTk9QUVJTVFVWV1hZWltcXV5fYGFiY2RlZmdoaWprbG1ub3BxcnN0dXZ3eHl6e3x9fn+AgYKD"
+    "hIWGh4iJiouMjY6PkJGSk5SVlpeYmZqbnJ2en6ChoqOkpaanqKmqq6ytrq+wsbKztLW2t7i5uru8vb6/wMHCw8TF"
+    "xsfIycrLzM3Oz9DR0tPU1dbX2Nna29zd3t/g4eLj5OXm5+jp6uvs7e7v8PHy8/T19vf4+fr7/P3+" },
+  { 256,
+    "AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8gISIjJCUmJygpKissLS4vMDEyMzQ1Njc4OTo7PD0+P0BB"
+    "QkNERUZHSElKS0xNTk9QUVJTVFVWV1hZWltcXV5fYGFiY2RlZmdoaWprbG1ub3BxcnN0dXZ3eHl6e3x9fn+AgYKD"
+    "hIWGh4iJiouMjY6PkJGSk5SVlpeYmZqbnJ2en6ChoqOkpaanqKmqq6ytrq+wsbKztLW2t7i5uru8vb6/wMHCw8TF"
+    "xsfIycrLzM3Oz9DR0tPU1dbX2Nna29zd3t/g4eLj5OXm5+jp6uvs7e7v8PHy8/T19vf4+fr7/P3+/w==" },
+};
+
+static uint8_t bytes[256];
+
+static bool encodes_to (const void *in, size_t len, const char *expected)
+{
+  char *out = malloc (EDGEX_B64_ENCLEN (len) + 1);
+  edgex_b64_encode (in, len, out);
+  out[EDGEX_B64_ENCLEN (len)] = '\0';
+  bool result = (strcmp (out, expected) == 0);
+  if (!result)
+  {
+    fprintf (stderr, "b64: %zu bytes: expected %s, got %s\n", len, expected, out);
+  }
+  free (out);
+  return result;
+}
+
+static bool decodes_to (const char *in, const void *expected, size_t len)
+{
+  size_t inlen = strlen (in);
+  size_t outlen = 0;
+  uint8_t *out = malloc (EDGEX_B64_MAXDECLEN (inlen) + 1);
+  bool result = edgex_b64_decode (in, inlen, out, &outlen) && outlen == len && memcmp (out, expected, len) == 0;
+  if (!result)
+  {
+    fprintf (stderr, "b64: %s does not decode to %zu bytes\n", in, len);
+  }
+  free (out);
+  return result;
+}
+
+static bool rejects (const char *in)
+{
+  size_t inlen = strlen (in);
+  size_t outlen;
+  uint8_t *out = malloc (EDGEX_B64_MAXDECLEN (inlen) + 1);
+  bool result = !edgex_b64_decode (in, inlen, out, &outlen);
+  free (out);
+  return result;
+}
+
+static void test_rfc4648 (void)
+{
+  for (unsigned i = 0; i < sizeof (rfc4648) / sizeof (rfc4648[0]); i++)
+  {
+    size_t len = strlen (rfc4648[i].dec);
+    EDGEX_CHECK (encodes_to (rfc4648[i].dec, len, rfc4648[i].enc));
+    EDGEX_CHECK (decodes_to (rfc4648[i].enc, rfc4648[i].dec, len));
+  }
+  char *str = edgex_b64_encode_str ("foobar", 6);
+  EDGEX_CHECK (strcmp (str, "Zm9vYmFy") == 0);
+  free (str);
+}
+
+static void test_prefixes (void)
+{
+  for (unsigned i = 0; i < sizeof (prefixes) / sizeof (prefixes[0]); i++)
+  {
+    EDGEX_CHECK (encodes_to (bytes, prefixes[i].len, prefixes[i].enc));
+    EDGEX_CHECK (decodes_to (prefixes[i].enc, bytes, prefixes[i].len));
+  }
+}
+
+static void test_decode_slow (void)
+{
+  const char *all = prefixes[sizeof (prefixes) / sizeof (prefixes[0]) - 1].enc;
+  size_t len = strlen (all);
+  char *str = malloc (len + 2);
+
+  // Whitespace or an invalid character ends a vector block early
+  memcpy (str, all, 40);
+  str[40] = '\n';
+  strcpy (str + 41, all + 40);
+  EDGEX_CHECK (decodes_to (str, bytes, 256));
+  memcpy (str, all, 5);
+  str[5] = ' ';
+  strcpy (str + 6, all + 5);
+  EDGEX_CHECK (decodes_to (str, bytes, 256));
+
+  strcpy (str, all);
+  str[5] = '*';
+  EDGEX_CHECK (rejects (str));
+  strcpy (str, all);
+  str[37] = '-';
+  EDGEX_CHECK (rejects (str));
+  strcpy (str, all);
+  str[len - 3] = '_';
+  EDGEX_CHECK (rejects (str));
+  EDGEX_CHECK (rejects ("Z"));
+  EDGEX_CHECK (rejects ("AAAAAAAAAAAAAAAAAAAAAAAAZ"));
+
+  // The URL-safe alphabet swaps + and / for - and _
+  strcpy (str, all);
+  for (size_t i = 0; i < len; i++)
+  {
+    switch (str[i])
+    {
+      case '+': str[i] = '-'; break;
+      case '/': str[i] = '_'; break;
+      default: break;
+    }
+  }
+  uint8_t *out = malloc (EDGEX_B64_MAXDECLEN (len));
+  size_t outlen = 0;
+  EDGEX_CHECK (edgex_b64url_decode (str, len, out, &outlen) && outlen == 256 && memcmp (out, bytes, 256) == 0);
+  EDGEX_CHECK (!edgex_b64url_decode (all, len, out, &outlen));
+  free (out);
+  free (str);
+}
+
+int main (void)
+{
+  for (unsigned i = 0; i < sizeof (bytes); i++)
+  {
+    bytes[i] = (uint8_t)i;
+  }
+  test_rfc4648 ();
+  test_prefixes ();
+  test_decode_slow ();
+  return EDGEX_TEST_RESULT ();
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "test.h"
+#include "encoder.h"
+#include "b64.h"
+#include "parson.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+unsigned edgex_test_failures = 0;
+
+/* Takes the encoder's output and compares it with the expected bytes, given
+   as a hex string. */
+
+static bool cbor_is (edgex_encoder *enc, const char *hex)
+{
+  size_t len;
+  uint8_t *data = edgex_enc_take (enc, &len);
+  bool result = (len == strlen (hex) / 2);
+  for (size_t i = 0; result && i < len; i++)
+  {
+    unsigned b;
+    sscanf (hex + 2 * i, "%2x", &b);
+    result = (data[i] == b);
+  }
+  if (!result)
+  {
+    fprintf (stderr, "cbor: expected %s, got ", hex);
+    for (size_t i = 0; i < len; i++)
+    {
+      fprintf (stderr, "%02x", data[i]);
+    }
+    fprintf (stderr, "\n");
+  }
+  free (data);
+  return result;
+}
+
+static bool json_is (edgex_encoder *enc, const char *expected)
+{
+  size_t len;
+  char *data = edgex_enc_take (enc, &len);
+  bool result = (len == strlen (expected) && strcmp (data, expected) == 0);
+  if (!result)
+  {
+    fprintf (stderr, "json: expected %s, got %s\n", expected, data);
+  }
+  free (data);
+  return result;
+}
+
+static JSON_Value *json_parse_taken (edgex_encoder *enc)
+{
+  size_t len;
+  char *data = edgex_enc_take (enc, &len);
+  JSON_Value *val = json_parse_string (data);
+  if (val == NULL)
+  {
+    fprintf (stderr, "json: does not parse: %s\n", data);
+  }
+  free (data);
+  return val;
+}
+
+/* Encodings from RFC 8949 Appendix A */
+
+static void test_cbor_ints (void)
+{
+  static const struct { int64_t val; const char *hex; } ints[] =
+  {
+    { 0, "00" }, { 1, "01" }, { 10, "0a" }, { 23, "17" }, { 24, "1818" }, { 25, "1819" }, { 100, "1864" },
+    { 1000, "1903e8" }, { 1000000, "1a000f4240" }, { 1000000000000, "1b000000e8d4a51000" },
+    { -1, "20" }, { -10, "29" }, { -100, "3863" }, { -1000, "3903e7" },
+    { INT64_MIN, "3b7fffffffffffffff" }, { INT64_MAX, "1b7fffffffffffffff" }
+  };
+  edgex_encoder enc;
+  for (unsigned i = 0; i < sizeof (ints) / sizeof (ints[0]); i++)
+  {
+    edgex_enc_init (&enc, true, 0);
+    edgex_enc_int (&enc, ints[i].val);
+    EDGEX_CHECK (cbor_is (&enc, ints[i].hex));
+  }
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_uint (&enc, UINT64_MAX);
+  EDGEX_CHECK (cbor_is (&enc, "1bffffffffffffffff"));
+}
+
+static void test_cbor_scalars (void)
+{
+  edgex_encoder enc;
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_bool (&enc, false);
+  edgex_enc_bool (&enc, true);
+  edgex_enc_null (&enc);
+  EDGEX_CHECK (cbor_is (&enc, "f4f5f6"));
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_f64 (&enc, 1.1);
+  EDGEX_CHECK (cbor_is (&enc, "fb3ff199999999999a"));
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_f32 (&enc, 100000.0f);
+  EDGEX_CHECK (cbor_is (&enc, "fa47c35000"));
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_f32 (&enc, 3.4028234663852886e+38f);
+  EDGEX_CHECK (cbor_is (&enc, "fa7f7fffff"));
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_string (&enc, "");
+  edgex_enc_string (&enc, "a");
+  edgex_enc_string (&enc, "IETF");
+  edgex_enc_string (&enc, "\"\\");
+  edgex_enc_string (&enc, "\xc3\xbc");
+  EDGEX_CHECK (cbor_is (&enc, "6061616449455446" "62225c" "62c3bc"));
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_bytes (&enc, "", 0);
+  edgex_enc_bytes (&enc, "\x01\x02\x03\x04", 4);
+  EDGEX_CHECK (cbor_is (&enc, "40" "4401020304"));
+}
+
+static void test_cbor_containers (void)
+{
+  edgex_encoder enc;
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_array_start (&enc, 0);
+  edgex_enc_array_end (&enc);
+  edgex_enc_map_start (&enc, 0);
+  edgex_enc_map_end (&enc);
+  EDGEX_CHECK (cbor_is (&enc, "80a0"));
+
+  // [1, [2, 3], [4, 5]]
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_array_start (&enc, 3);
+  edgex_enc_int (&enc, 1);
+  edgex_enc_array_start (&enc, 2);
+  edgex_enc_int (&enc, 2);
+  edgex_enc_int (&enc, 3);
+  edgex_enc_array_end (&enc);
+  edgex_enc_array_start (&enc, 2);
+  edgex_enc_int (&enc, 4);
+  edgex_enc_int (&enc, 5);
+  edgex_enc_array_end (&enc);
+  edgex_enc_array_end (&enc);
+  EDGEX_CHECK (cbor_is (&enc, "8301820203820405"));
+
+  // {"a": 1, "b": [2, 3]}
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_map_start (&enc, 2);
+  edgex_enc_key (&enc, "a");
+  edgex_enc_int (&enc, 1);
+  edgex_enc_key (&enc, "b");
+  edgex_enc_array_start (&enc, 2);
+  edgex_enc_int (&enc, 2);
+  edgex_enc_int (&enc, 3);
+  edgex_enc_array_end (&enc);
+  edgex_enc_map_end (&enc);
+  EDGEX_CHECK (cbor_is (&enc, "a26161016162820203"));
+
+  // 24 members needs a one-byte length
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_array_start (&enc, 24);
+  for (int i = 0; i < 24; i++)
+  {
+    edgex_enc_int (&enc, 0);
+  }
+  edgex_enc_array_end (&enc);
+  EDGEX_CHECK (cbor_is (&enc, "9818" "000000000000000000000000000000000000000000000000"));
+}
+
+static void test_json_layout (void)
+{
+  edgex_encoder enc;
+
+  edgex_enc_init (&enc, false, 0);
+  edgex_enc_map_start (&enc, 4);
+  edgex_enc_key (&enc, "a");
+  edgex_enc_int (&enc, 1);
+  edgex_enc_key (&enc, "b");
+  edgex_enc_array_start (&enc, 3);
+  edgex_enc_bool (&enc, true);
+  edgex_enc_null (&enc);
+  edgex_enc_string (&enc, "x");
+  edgex_enc_array_end (&enc);
+  edgex_enc_key (&enc, "c");
+  edgex_enc_map_start (&enc, 0);
+  edgex_enc_map_end (&enc);
+  edgex_enc_key (&enc, "d");
+  edgex_enc_array_start (&enc, 0);
+  edgex_enc_array_end (&enc);
+  edgex_enc_map_end (&enc);
+  EDGEX_CHECK (json_is (&enc, "{\"a\":1,\"b\":[true,null,\"x\"],\"c\":{},\"d\":[]}"));
+
+  edgex_enc_init (&enc, false, 0);
+  edgex_enc_array_start (&enc, 5);
+  edgex_enc_int (&enc, -1000);
+  edgex_enc_int (&enc, INT64_MIN);
+  edgex_enc_uint (&enc, UINT64_MAX);
+  edgex_enc_encoded (&enc, "{\"k\":1}", 7);
+  edgex_enc_bytes (&enc, "\x01\x02\x03\x04", 4);
+  edgex_enc_array_end (&enc);
+  EDGEX_CHECK (json_is (&enc, "[-1000,-9223372036854775808,18446744073709551615,{\"k\":1},\"AQIDBA==\"]"));
+
+  edgex_enc_init (&enc, false, 0);
+  edgex_enc_string (&enc, "\x01\x1f");
+  EDGEX_CHECK (json_is (&enc, "\"\\u0001\\u001f\""));
+}
+
+static void test_json_roundtrip (void)
+{
+  static const char *str = "quote\" backslash\\ nl\n cr\r tab\t bs\b ff\f ctl\x7 \xc3\xa9\xe2\x82\xac";
+  uint8_t bin[256];
+  edgex_encoder enc;
+
+  for (unsigned i = 0; i < sizeof (bin); i++)
+  {
+    bin[i] = (uint8_t)i;
+  }
+
+  edgex_enc_init (&enc, false, 0);
+  edgex_enc_map_start (&enc, 8);
+  edgex_enc_key (&enc, "str");
+  edgex_enc_string (&enc, str);
+  edgex_enc_key (&enc, "int\"\n");
+  edgex_enc_int (&enc, 42);
+  edgex_enc_key (&enc, "u");
+  edgex_enc_uint (&enc, 4000000000u);
+  edgex_enc_key (&enc, "f32");
+  edgex_enc_f32 (&enc, 0.1f);
+  edgex_enc_key (&enc, "f64");
+  edgex_enc_f64 (&enc, -1234.5678e-9);
+  edgex_enc_key (&enc, "bool");
+  edgex_enc_bool (&enc, false);
+  edgex_enc_key (&enc, "nested");
+  edgex_enc_map_start (&enc, 1);
+  edgex_enc_key (&enc, "arr");
+  edgex_enc_array_start (&enc, 2);
+  edgex_enc_null (&enc);
+  edgex_enc_string_len (&enc, "abcdef", 3);
+  edgex_enc_array_end (&enc);
+  edgex_enc_map_end (&enc);
+  edgex_enc_key (&enc, "bin");
+  edgex_enc_bytes (&enc, bin, sizeof (bin));
+  edgex_enc_map_end (&enc);
+
+  JSON_Value *val = json_parse_taken (&enc);
+  EDGEX_CHECK (val != NULL);
+  if (val == NULL)
+  {
+    return;
+  }
+  JSON_Object *obj = json_value_get_object (val);
+  EDGEX_CHECK (json_object_get_count (obj) == 8);
+  const char *s = json_object_get_string (obj, "str");
+  EDGEX_CHECK (s && strcmp (s, str) == 0);
+  s = json_object_get_name (obj, 1);
+  EDGEX_CHECK (s && strcmp (s, "int\"\n") == 0);
+  EDGEX_CHECK (json_value_get_number (json_object_get_value (obj, s)) == 42);
+  EDGEX_CHECK (json_object_get_number (obj, "u") == 4000000000u);
+  EDGEX_CHECK ((float)json_object_get_number (obj, "f32") == 0.1f);
+  EDGEX_CHECK (json_object_get_number (obj, "f64") == -1234.5678e-9);
+  EDGEX_CHECK (json_object_get_boolean (obj, "bool") == 0);
+  JSON_Array *arr = json_object_dotget_array (obj, "nested.arr");
+  EDGEX_CHECK (arr && json_array_get_count (arr) == 2);
+  EDGEX_CHECK (arr && json_value_get_type (json_array_get_value (arr, 0)) == JSONNull);
+  s = arr ? json_array_get_string (arr, 1) : NULL;
+  EDGEX_CHECK (s && strcmp (s, "abc") == 0);
+
+  // The codec itself is covered by b64_test
+  char *b64 = edgex_b64_encode_str (bin, sizeof (bin));
+  s = json_object_get_string (obj, "bin");
+  EDGEX_CHECK (s && strcmp (s, b64) == 0);
+  free (b64);
+  json_value_free (val);
+}
+
+/* Starting from the minimum buffer size, a large document exercises
+   buffer growth, including the spare byte kept for the terminator. */
+
+static void test_json_growth (void)
+{
+  edgex_encoder enc;
+  const unsigned n = 10000;
+
+  edgex_enc_init (&enc, false, 0);
+  edgex_enc_array_start (&enc, n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_enc_uint (&enc, i);
+  }
+  edgex_enc_array_end (&enc);
+
+  JSON_Value *val = json_parse_taken (&enc);
+  JSON_Array *arr = json_value_get_array (val);
+  EDGEX_CHECK (arr && json_array_get_count (arr) == n);
+  for (unsigned i = 0; arr && i < n; i++)
+  {
+    if (json_array_get_number (arr, i) != i)
+    {
+      EDGEX_CHECK (json_array_get_number (arr, i) == i);
+      break;
+    }
+  }
+  json_value_free (val);
+
+  edgex_enc_init (&enc, true, 0);
+  edgex_enc_array_start (&enc, n);
+  for (unsigned i = 0; i < n; i++)
+  {
+    edgex_enc_uint (&enc, 1000);
+  }
+  size_t len;
+  uint8_t *data = edgex_enc_take (&enc, &len);
+  EDGEX_CHECK (len == 3 + 3 * n);
+  EDGEX_CHECK (data[0] == 0x99 && data[1] == (n >> 8) && data[2] == (n & 0xff));
+  EDGEX_CHECK (data[len - 3] == 0x19 && data[len - 2] == 0x03 && data[len - 1] == 0xe8);
+  free (data);
+}
+
+int main (void)
+{
+  test_cbor_ints ();
+  test_cbor_scalars ();
+  test_cbor_containers ();
+  test_json_layout ();
+  test_json_roundtrip ();
+  test_json_growth ();
+  return EDGEX_TEST_RESULT ();
+}
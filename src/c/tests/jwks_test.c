@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "test.h"
+#include "jwks.h"
+
+unsigned edgex_test_failures = 0;
+
+/* Fixtures. The key set holds an RSA key (rsa1), a P-256 key (ec1) and an
+ * Ed25519 key (ed1); ec2jwk holds a second P-256 key (ec9). Unless stated
+ * otherwise the tokens carry aud "edgex", nbf 1600000000 and exp 2000000000:
+ *
+ *   rs256, es256, eddsa  signed with rsa1, ec1 and ed1
+ *   tampered             rs256 with its payload replaced
+ *   expired, notyet      exp 1650000000, nbf 1800000000
+ *   noexp                no exp claim
+ *   wrongaud, audlist    aud "other", aud ["other", "edgex"]
+ *   wrongkey             kid ec1, but signed with ec9
+ *   unknownkid           kid ec9, signed with ec9
+ *   none, hs256          unsigned, and HMAC-signed
+ */
+
+static const char *jwks =
+  "{\"keys\":[{\"kty\":\"RSA\",\"kid\":\"rsa1\",\"use\":\"sig\",\"alg\":\"RS256\",\"n\":\"rIVv3oOMy"
+  "Rk99XdAdtWHtY7q5uVB7OFJy0sEESVlFTvjYzXbXuTbn--dB921jS53BNvOR7RJaDfJEbbq2-RAs9cFSRYsu9NdG1kX6bqXv"
+  "45RL89GxY9krtkSIP3d4oJzU6Z0ihf8_o3F5IQjpp3noCq2jp9LnvTxPdpnDH5Mnlri1IOdwb39C-AcaLPl2cXnNG-caCYgh"
+  "Mt6WP7I-bc3j_G8Wi99PxTUYM2jRsmGKK1wAxlVuU31pM7_MN4jRbau3kI26Uij1hQhc6UcWzlUSaiGC5hw60jdkrMVCO2-T"
+  "Ct-9WV1X4iimwGKE33W3X8ZJTiT9m65-B3LhKVeC6hjzQ\",\"e\":\"AQAB\"},{\"kty\":\"EC\",\"kid\":\"ec1\","
+  "\"crv\":\"P-256\",\"x\":\"whB1hXjRlxfUwP8n9FoIpGLP_f8BbVJ5fOS1hb3B3PE\",\"y\":\"DGuYAPDCs5X0YTfH"
+  "GwYufgqqpDz_riHHAmjR8GYsv5Y\"},{\"kty\":\"OKP\",\"kid\":\"ed1\",\"crv\":\"Ed25519\",\"x\":\"vKkP"
+  "fv_c7TsBasWtpIjSlv6qlMIw-j5nqCpoBrwdqGs\"}]}";
+
+static const char *ec2jwk =
+  "{\"keys\":[{\"kty\":\"EC\",\"kid\":\"ec9\",\"crv\":\"P-256\",\"x\":\"uaAgAx-5YVuzAY8PzM5t2zT_pd-"
+  "vzAAgi7HkX0ehAIM\",\"y\":\"o1T9gaYcXWWGJPGtRId0YD38UnJ55Lu0N6fa6hXhAmA\"}]}";
+
+static const char *rs256 =
+  "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6InJzYTEifQ.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4c"
+  "CI6MjAwMDAwMDAwMCwibmJmIjoxNjAwMDAwMDAwfQ.bneZsOH9krYjy5KRxRt4qVla0rKye0dwQiuEZGho8RB7XTS6jTvxJp"
+  "AcV8fSykW3DSFXYHo_fi49XRoOoHs4cbidxT5fAawCMr57effo0WnrmpotwhFUmfbbIHTrqqSXWfBIV5pVYCLimWuZ9cg5_u"
+  "X2J6NMNPJO0JpC_HUlOiss7D3DfDbxmpyCg8gGDhANB1ToudPa31hO5ZcLWa4bg4Jgh0DlxT012zz5A2KPE9MHFtTpItSkW5"
+  "oH_SpKYvH-7h4QF_rC4SaWZzsEGCd3XcGwBmDGahNGLY3wgXL0oMYvzUp81f3AMbUsV8OjM09SaLYkA1xrYOXp_BzMFadyzg";
+
+static const char *es256 =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI"
+  "6MjAwMDAwMDAwMCwibmJmIjoxNjAwMDAwMDAwfQ.dm03-jF6eshctIvSRddI-rG1HKzO14paOP4UNAUcsBawKs3ll3OfGnyK"
+  "pIOPPwTu7IbsR9d7GGuufyUF6g8zhg";
+
+static const char *eddsa =
+  "eyJhbGciOiJFZERTQSIsInR5cCI6IkpXVCIsImtpZCI6ImVkMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI"
+  "6MjAwMDAwMDAwMCwibmJmIjoxNjAwMDAwMDAwfQ.pjFpvsgwvdHH3NA8KDFAc8A_rDn1IkflRiz9ZNADaJ0a-zPeOYWpwst5"
+  "Aq80m_-JBsbjc_ac_60a_ZD3gnF-CQ";
+
+static const char *tampered =
+  "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6InJzYTEifQ.eyJzdWIiOiJyb290IiwiYXVkIjoiZWRnZXgiLCJle"
+  "HAiOjIwMDAwMDAwMDAsIm5iZiI6MTYwMDAwMDAwMH0.bneZsOH9krYjy5KRxRt4qVla0rKye0dwQiuEZGho8RB7XTS6jTvxJ"
+  "pAcV8fSykW3DSFXYHo_fi49XRoOoHs4cbidxT5fAawCMr57effo0WnrmpotwhFUmfbbIHTrqqSXWfBIV5pVYCLimWuZ9cg5_"
+  "uX2J6NMNPJO0JpC_HUlOiss7D3DfDbxmpyCg8gGDhANB1ToudPa31hO5ZcLWa4bg4Jgh0DlxT012zz5A2KPE9MHFtTpItSkW"
+  "5oH_SpKYvH-7h4QF_rC4SaWZzsEGCd3XcGwBmDGahNGLY3wgXL0oMYvzUp81f3AMbUsV8OjM09SaLYkA1xrYOXp_BzMFadyz"
+  "g";
+
+static const char *expired =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI"
+  "6MTY1MDAwMDAwMCwibmJmIjoxNjAwMDAwMDAwfQ.flqIyTatyFiKh24WacjcON3u3616OIn8x8SgTB11DXN60xv9d5ySJnns"
+  "bkHvtmERnzeQqM2-9Abis2RxtESh-A";
+
+static const char *notyet =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI"
+  "6MjAwMDAwMDAwMCwibmJmIjoxODAwMDAwMDAwfQ.8b_SW15w30ATFKA42A5V6eVRlOdKgvANr6wIiXo3nqhYVdBX2eq-Y2O3"
+  "vYSYxZZbXUXF1FNxgVQRaoMiH24D0g";
+
+static const char *noexp =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsIm5iZiI"
+  "6MTYwMDAwMDAwMH0.XHvAeKe4lJDjKhVkBbiZCnLof2etsaa5pEkAgC76pNtUMUSPVok0JoMS1SOkgxdkU-uDbFCCU8Gj7Dl"
+  "zX27BUw";
+
+static const char *wrongaud =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJvdGhlciIsImV4cCI"
+  "6MjAwMDAwMDAwMCwibmJmIjoxNjAwMDAwMDAwfQ.mRq6gzmk6btqgQlFF9rySdK_BlwjrvYubB-l5dP2kOh11YQbEZkZ9aZr"
+  "409hpaRjPzdpYnVHPfsUOVOPsj_m4w";
+
+static const char *audlist =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOlsib3RoZXIiLCJlZGd"
+  "leCJdLCJleHAiOjIwMDAwMDAwMDAsIm5iZiI6MTYwMDAwMDAwMH0.10fAs08hKPcExHiUxfJ5ds2uPL5MMOuOYDJnQm9TrWw"
+  "c1ZNpiEIWgse1JqFRqrUz3cMvbel2fLmp69YJM2XZSA";
+
+static const char *wrongkey =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjMSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI"
+  "6MjAwMDAwMDAwMCwibmJmIjoxNjAwMDAwMDAwfQ.ipyFRcuksjSPVEggwXsOhixYioXyz9b8f46LzKcw_H45OXp6JaL7r8qB"
+  "PHrSN5F0ml8FafmtH42pvMAlrNuidw";
+
+static const char *unknownkid =
+  "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsImtpZCI6ImVjOSJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI"
+  "6MjAwMDAwMDAwMCwibmJmIjoxNjAwMDAwMDAwfQ.e2uuEwob5HmUJOeOt1ctDaDm-C2xZoWXWuoXy8zfV5rR8hEFTtQEv4dt"
+  "gj6uUQ4oRism-rr47WXgeNKwKnkDrQ";
+
+static const char *none =
+  "eyJhbGciOiJub25lIiwidHlwIjoiSldUIn0.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI6MjAwMDAwMDAwMCwi"
+  "bmJmIjoxNjAwMDAwMDAwfQ.";
+
+static const char *hs256 =
+  "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJzdWIiOiJzdmMiLCJhdWQiOiJlZGdleCIsImV4cCI6MjAwMDAwMDAwMCw"
+  "ibmJmIjoxNjAwMDAwMDAwfQ.c2ln";
+
+#define NOW 1700000000000ULL
+
+static void test_verify (void)
+{
+  bool refresh;
+  edgex_jwks_t *ks = edgex_jwks_alloc (NULL);
+  EDGEX_CHECK (edgex_jwks_update (ks, jwks));
+
+  EDGEX_CHECK (edgex_jwks_verify (ks, rs256, "edgex", NOW, &refresh) == EDGEX_JWT_VALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, es256, "edgex", NOW, &refresh) == EDGEX_JWT_VALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, eddsa, "edgex", NOW, &refresh) == EDGEX_JWT_VALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, audlist, "edgex", NOW, &refresh) == EDGEX_JWT_VALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, wrongaud, NULL, NOW, &refresh) == EDGEX_JWT_VALID);
+
+  EDGEX_CHECK (edgex_jwks_verify (ks, tampered, "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, expired, "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, notyet, "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, noexp, "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, wrongaud, "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, wrongkey, "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, none, "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, "", "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, "a.b", "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, "!!.!!.!!", "edgex", NOW, &refresh) == EDGEX_JWT_INVALID);
+
+  // Tokens that are past exp now were valid earlier
+  EDGEX_CHECK (edgex_jwks_verify (ks, expired, "edgex", 1640000000000ULL, &refresh) == EDGEX_JWT_VALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, es256, "edgex", 2100000000000ULL, &refresh) == EDGEX_JWT_INVALID);
+
+  // Symmetric algorithms cannot be checked locally; fetching keys won't help
+  refresh = true;
+  EDGEX_CHECK (edgex_jwks_verify (ks, hs256, "edgex", NOW, &refresh) == EDGEX_JWT_UNKNOWN);
+  EDGEX_CHECK (!refresh);
+
+  // An unknown key may be found by refreshing the key set
+  refresh = false;
+  EDGEX_CHECK (edgex_jwks_verify (ks, unknownkid, "edgex", NOW, &refresh) == EDGEX_JWT_UNKNOWN);
+  EDGEX_CHECK (refresh);
+
+  // A document that doesn't parse leaves the keys alone
+  EDGEX_CHECK (!edgex_jwks_update (ks, "{\"keys\":["));
+  EDGEX_CHECK (edgex_jwks_verify (ks, es256, "edgex", NOW, &refresh) == EDGEX_JWT_VALID);
+
+  // Replacing the key set drops the old keys
+  EDGEX_CHECK (edgex_jwks_update (ks, ec2jwk));
+  EDGEX_CHECK (edgex_jwks_verify (ks, unknownkid, "edgex", NOW, &refresh) == EDGEX_JWT_VALID);
+  EDGEX_CHECK (edgex_jwks_verify (ks, es256, "edgex", NOW, &refresh) == EDGEX_JWT_UNKNOWN);
+
+  edgex_jwks_free (ks);
+}
+
+int main (void)
+{
+  EDGEX_CHECK (edgex_jwks_available ());
+  test_verify ();
+  return EDGEX_TEST_RESULT ();
+}
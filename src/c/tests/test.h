@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2025
+ * IoTech Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _EDGEX_TEST_H_
+#define _EDGEX_TEST_H_ 1
+
+#include <stdio.h>
+
+/* Minimal assertion support for the unit tests. Each test program counts
+ * failed checks and exits non-zero if there were any, which is all ctest
+ * needs to report a failure.
+ */
+
+extern unsigned edgex_test_failures;
+
+#define EDGEX_CHECK(cond) \
+  do \
+  { \
+    if (!(cond)) \
+    { \
+      fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      edgex_test_failures++; \
+    } \
+  } while (0)
+
+#define EDGEX_TEST_RESULT() (edgex_test_failures ? 1 : 0)
+
+#endif
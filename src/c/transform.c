@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2019-2023
+ * Copyright (c) 2019-2025
  * IoTech Ltd
  *
  * SPDX-License-Identifier: Apache-2.0
@@ -12,26 +12,22 @@
 #include <limits.h>
 #include <float.h>
 #include <assert.h>
-
-static bool transformsOn (const edgex_propertyvalue *pv)
-{
-  return (pv->offset.enabled || pv->scale.enabled || pv->base.enabled || pv->shift.enabled || pv->mask.enabled);
-}
+#include <stdlib.h>
 
 static long double getLongDouble (const iot_data_t *value, iot_data_type_t t)
 {
   return (t == IOT_DATA_FLOAT64) ? iot_data_f64 (value) : iot_data_f32 (value);
 }
 
-static iot_data_t *setLongDouble (long double ldval, iot_data_type_t t)
+static iot_data_t *setDouble (double dval, iot_data_type_t t)
 {
   if (t == IOT_DATA_FLOAT64)
   {
-    return (ldval <= DBL_MAX && ldval >= -DBL_MAX) ? iot_data_alloc_f64 (ldval) : NULL;
+    return isfinite (dval) ? iot_data_alloc_f64 (dval) : NULL;
   }
   else
   {
-    return (ldval <= FLT_MAX && ldval >= -FLT_MAX) ? iot_data_alloc_f32 (ldval) : NULL;
+    return (dval <= FLT_MAX && dval >= -FLT_MAX) ? iot_data_alloc_f32 (dval) : NULL;
   }
 }
 
@@ -85,24 +81,221 @@ static iot_data_t *setLLInt (long long int llival, iot_data_type_t t)
   }
 }
 
-void edgex_transform_outgoing (devsdk_commandresult *cres, edgex_propertyvalue *props, const iot_data_t *mappings)
+void edgex_transform_compile (edgex_transform *xf, const edgex_propertyvalue *props)
+{
+  bool isarray = (props->type.type == IOT_DATA_ARRAY);
+  xf->type = isarray ? props->type.element_type : props->type.type;
+  xf->isarray = isarray;
+  xf->isfloat = (xf->type == IOT_DATA_FLOAT32 || xf->type == IOT_DATA_FLOAT64);
+  xf->active = props->offset.enabled || props->scale.enabled || props->base.enabled || props->shift.enabled || props->mask.enabled;
+  xf->base = props->base;
+  if (xf->isfloat)
+  {
+    xf->fscale = props->scale.enabled ? props->scale.value.dval : 1.0;
+    xf->foffset = props->offset.enabled ? props->offset.value.dval : 0.0;
+  }
+  else
+  {
+    xf->iscale = props->scale.enabled ? props->scale.value.ival : 1;
+    xf->ioffset = props->offset.enabled ? props->offset.value.ival : 0;
+    xf->mask = props->mask.enabled ? props->mask.value.ival : -1;
+    xf->lshift = (props->shift.enabled && props->shift.value.ival < 0) ? -props->shift.value.ival : 0;
+    xf->rshift = (props->shift.enabled && props->shift.value.ival > 0) ? props->shift.value.ival : 0;
+  }
+}
+
+/* Per-value arithmetic. The plan holds identity values for disabled steps
+   so that, with no base set, each direction is a straight-line expression
+   which the compiler can vectorize across an array. */
+
+static inline double xfOutFloat (const edgex_transform *xf, double v)
+{
+  if (xf->base.enabled) v = pow (xf->base.value.dval, v);
+  return v * xf->fscale + xf->foffset;
+}
+
+static inline double xfInFloat (const edgex_transform *xf, double v)
+{
+  v = (v - xf->foffset) / xf->fscale;
+  if (xf->base.enabled) v = log (v) / log (xf->base.value.dval);
+  return v;
+}
+
+static inline long long int xfOutInt (const edgex_transform *xf, long long int v)
+{
+  v = (long long int)((unsigned long long int)(v & xf->mask) << xf->lshift) >> xf->rshift;
+  if (xf->base.enabled) v = powl (xf->base.value.ival, v);
+  return v * xf->iscale + xf->ioffset;
+}
+
+static inline long long int xfInInt (const edgex_transform *xf, long long int v)
+{
+  v -= xf->ioffset;
+  if (xf->iscale != 1) v /= xf->iscale;
+  if (xf->base.enabled) v = llroundl (logl (v) / logl (xf->base.value.ival));
+  v = (long long int)((unsigned long long int)(v >> xf->lshift) << xf->rshift);
+  return v & xf->mask;
+}
+
+/* Array kernels: transform n elements from src to dst, returning false if
+   any result is out of range for the element type. For floats, out of range
+   results are infinite once narrowed to the element type, so a second pass
+   checks for those and restores any non-finite inputs, which as for single
+   values are passed through unchanged. The float kernels have a separate
+   form for the common case of scale and offset only, which vectorizes. */
+
+#define XF_FLOAT_KERNEL(NAME, T, FN) \
+static bool NAME (const edgex_transform *xf, const T *restrict src, T *restrict dst, uint32_t n) \
+{ \
+  const edgex_transform p = *xf; \
+  bool ok = true; \
+  int nonfinite = 0; \
+  for (uint32_t i = 0; i < n; i++) \
+  { \
+    dst[i] = FN (&p, src[i]); \
+  } \
+  for (uint32_t i = 0; i < n; i++) \
+  { \
+    nonfinite |= ((dst[i] - dst[i]) != 0) | ((src[i] - src[i]) != 0); \
+  } \
+  if (nonfinite) \
+  { \
+    for (uint32_t i = 0; i < n; i++) \
+    { \
+      if (isfinite (src[i])) \
+      { \
+        ok &= isfinite (dst[i]); \
+      } \
+      else \
+      { \
+        dst[i] = src[i]; \
+      } \
+    } \
+  } \
+  return ok; \
+}
+
+static inline double xfOutLinear (const edgex_transform *xf, double v)
+{
+  return v * xf->fscale + xf->foffset;
+}
+
+static inline double xfInLinear (const edgex_transform *xf, double v)
+{
+  return (v - xf->foffset) / xf->fscale;
+}
+
+XF_FLOAT_KERNEL (xfOutLinF32, float, xfOutLinear)
+XF_FLOAT_KERNEL (xfOutLinF64, double, xfOutLinear)
+XF_FLOAT_KERNEL (xfInLinF32, float, xfInLinear)
+XF_FLOAT_KERNEL (xfInLinF64, double, xfInLinear)
+XF_FLOAT_KERNEL (xfOutExpF32, float, xfOutFloat)
+XF_FLOAT_KERNEL (xfOutExpF64, double, xfOutFloat)
+XF_FLOAT_KERNEL (xfInExpF32, float, xfInFloat)
+XF_FLOAT_KERNEL (xfInExpF64, double, xfInFloat)
+
+#define XF_FLOAT_KERNELS(SFX) \
+static bool xfOut##SFX (const edgex_transform *xf, const void *src, void *dst, uint32_t n) \
+{ \
+  return xf->base.enabled ? xfOutExp##SFX (xf, src, dst, n) : xfOutLin##SFX (xf, src, dst, n); \
+} \
+static bool xfIn##SFX (const edgex_transform *xf, const void *src, void *dst, uint32_t n) \
+{ \
+  return xf->base.enabled ? xfInExp##SFX (xf, src, dst, n) : xfInLin##SFX (xf, src, dst, n); \
+}
+
+XF_FLOAT_KERNELS (F32)
+XF_FLOAT_KERNELS (F64)
+
+#define XF_INT_KERNEL(NAME, T, FN, LO, HI) \
+static bool NAME (const edgex_transform *xf, const T *restrict src, T *restrict dst, uint32_t n) \
+{ \
+  const edgex_transform p = *xf; \
+  bool ok = true; \
+  for (uint32_t i = 0; i < n; i++) \
+  { \
+    long long int r = FN (&p, src[i]); \
+    ok &= (r >= LO && r <= HI); \
+    dst[i] = r; \
+  } \
+  return ok; \
+}
+
+#define XF_INT_KERNELS(SFX, T, LO, HI) \
+  XF_INT_KERNEL (xfOut##SFX, T, xfOutInt, LO, HI) \
+  XF_INT_KERNEL (xfIn##SFX, T, xfInInt, LO, HI)
+
+XF_INT_KERNELS (I8, int8_t, SCHAR_MIN, SCHAR_MAX)
+XF_INT_KERNELS (U8, uint8_t, 0, UCHAR_MAX)
+XF_INT_KERNELS (I16, int16_t, SHRT_MIN, SHRT_MAX)
+XF_INT_KERNELS (U16, uint16_t, 0, USHRT_MAX)
+XF_INT_KERNELS (I32, int32_t, INT_MIN, INT_MAX)
+XF_INT_KERNELS (U32, uint32_t, 0, UINT_MAX)
+XF_INT_KERNELS (I64, int64_t, LLONG_MIN, LLONG_MAX)
+XF_INT_KERNELS (U64, uint64_t, 0, LLONG_MAX)
+
+/* Transforms an array into a new buffer, as the original may be shared or
+   owned by the driver. Returns NULL on overflow. */
+
+static iot_data_t *transformArray (const iot_data_t *array, const edgex_transform *xf, bool out)
+{
+  iot_data_type_t et = iot_data_array_type (array);
+  uint32_t n = iot_data_array_length (array);
+  const void *src = iot_data_address (array);
+  void *dst = malloc (iot_data_array_size (array));
+  bool ok;
+
+  switch (et)
+  {
+#define XF_ARRAY_CASE(TC, SFX) \
+    case TC: ok = out ? xfOut##SFX (xf, src, dst, n) : xfIn##SFX (xf, src, dst, n); break;
+    XF_ARRAY_CASE (IOT_DATA_INT8, I8)
+    XF_ARRAY_CASE (IOT_DATA_UINT8, U8)
+    XF_ARRAY_CASE (IOT_DATA_INT16, I16)
+    XF_ARRAY_CASE (IOT_DATA_UINT16, U16)
+    XF_ARRAY_CASE (IOT_DATA_INT32, I32)
+    XF_ARRAY_CASE (IOT_DATA_UINT32, U32)
+    XF_ARRAY_CASE (IOT_DATA_INT64, I64)
+    XF_ARRAY_CASE (IOT_DATA_UINT64, U64)
+    XF_ARRAY_CASE (IOT_DATA_FLOAT32, F32)
+    XF_ARRAY_CASE (IOT_DATA_FLOAT64, F64)
+#undef XF_ARRAY_CASE
+    default: assert (0); ok = false; break;
+  }
+  if (!ok)
+  {
+    free (dst);
+    return NULL;
+  }
+  return iot_data_alloc_array (dst, n, et, IOT_DATA_TAKE);
+}
+
+/* The plan's arguments are typed for the resource's (element) type, so a
+   value can only be transformed if it is of the same kind */
+
+static bool transformApplies (const edgex_transform *xf, iot_data_type_t t)
+{
+  if (t == IOT_DATA_FLOAT32 || t == IOT_DATA_FLOAT64)
+  {
+    return xf->isfloat;
+  }
+  return (t >= IOT_DATA_INT8 && t <= IOT_DATA_UINT64) && !xf->isfloat && xf->type <= IOT_DATA_UINT64;
+}
+
+void edgex_transform_outgoing (devsdk_commandresult *cres, const edgex_transform *xf, const iot_data_t *mappings)
 {
   iot_data_type_t t = iot_data_type (cres->value);
   switch (t)
   {
     case IOT_DATA_FLOAT32:
     case IOT_DATA_FLOAT64:
-    if (transformsOn (props))
+    if (xf->active && !xf->isarray && transformApplies (xf, t))
     {
-      long double result = getLongDouble (cres->value, t);
+      double result = getLongDouble (cres->value, t);
       if (isfinite (result))
       {
-        if (props->base.enabled) result = powl (props->base.value.dval, result);
-        if (props->scale.enabled) result *= props->scale.value.dval;
-        if (props->offset.enabled) result += props->offset.value.dval;
-
         iot_data_free (cres->value);
-        cres->value = setLongDouble (result, t);
+        cres->value = setDouble (xfOutFloat (xf, result), t);
         if (cres->value == NULL)
         {
           cres->value = iot_data_alloc_string ("overflow", IOT_DATA_REF);
@@ -118,25 +311,9 @@ void edgex_transform_outgoing (devsdk_commandresult *cres, edgex_propertyvalue *
     case IOT_DATA_UINT32:
     case IOT_DATA_INT64:
     case IOT_DATA_UINT64:
-    if (transformsOn (props))
+    if (xf->active && !xf->isarray && transformApplies (xf, t))
     {
-      long long int result = getLLInt (cres->value, t);
-      if (props->mask.enabled) result &= props->mask.value.ival;
-      if (props->shift.enabled)
-      {
-        if (props->shift.value.ival < 0)
-        {
-          result <<= -props->shift.value.ival;
-        }
-        else
-        {
-          result >>= props->shift.value.ival;
-        }
-      }
-      if (props->base.enabled) result = powl (props->base.value.ival, result);
-      if (props->scale.enabled) result *= props->scale.value.ival;
-      if (props->offset.enabled) result += props->offset.value.ival;
-
+      long long int result = xfOutInt (xf, getLLInt (cres->value, t));
       iot_data_free (cres->value);
       cres->value = setLLInt (result, t);
       if (cres->value == NULL)
@@ -145,6 +322,14 @@ void edgex_transform_outgoing (devsdk_commandresult *cres, edgex_propertyvalue *
       }
     }
     break;
+    case IOT_DATA_ARRAY:
+    if (xf->active && xf->isarray && transformApplies (xf, iot_data_array_type (cres->value)))
+    {
+      iot_data_t *result = transformArray (cres->value, xf, true);
+      iot_data_free (cres->value);
+      cres->value = result ? result : iot_data_alloc_string ("overflow", IOT_DATA_REF);
+    }
+    break;
     case IOT_DATA_STRING:
     {
       if (mappings && (iot_data_type(mappings) == IOT_DATA_MAP))
@@ -162,22 +347,19 @@ void edgex_transform_outgoing (devsdk_commandresult *cres, edgex_propertyvalue *
   }
 }
 
-void edgex_transform_incoming (iot_data_t **cres, edgex_propertyvalue *props, const iot_data_t *mappings)
+void edgex_transform_incoming (iot_data_t **cres, const edgex_transform *xf, const iot_data_t *mappings)
 {
-  switch (props->type.type)
+  switch (xf->isarray ? IOT_DATA_ARRAY : xf->type)
   {
     case IOT_DATA_FLOAT32:
     case IOT_DATA_FLOAT64:
-    if (transformsOn (props))
+    if (xf->active)
     {
-      long double result = getLongDouble (*cres, props->type.type);
+      double result = getLongDouble (*cres, xf->type);
       if (isfinite (result))
       {
-        if (props->offset.enabled) result -= props->offset.value.dval;
-        if (props->scale.enabled) result /= props->scale.value.dval;
-        if (props->base.enabled) result = logl (result) / logl (props->base.value.dval);
         iot_data_free (*cres);
-        *cres = setLongDouble (result, props->type.type);
+        *cres = setDouble (xfInFloat (xf, result), xf->type);
       }
     }
     break;
@@ -189,26 +371,19 @@ void edgex_transform_incoming (iot_data_t **cres, edgex_propertyvalue *props, co
     case IOT_DATA_UINT32:
     case IOT_DATA_INT64:
     case IOT_DATA_UINT64:
-    if (transformsOn (props))
+    if (xf->active)
     {
-      long long int result = getLLInt (*cres, props->type.type);
-      if (props->offset.enabled) result -= props->offset.value.ival;
-      if (props->scale.enabled) result /= props->scale.value.ival;
-      if (props->base.enabled) result = llroundl (logl (result) / logl (props->base.value.ival));
-      if (props->shift.enabled)
-      {
-        if (props->shift.value.ival < 0)
-        {
-          result >>= -props->shift.value.ival;
-        }
-        else
-        {
-          result <<= props->shift.value.ival;
-        }
-      }
-      if (props->mask.enabled) result &= props->mask.value.ival;
+      long long int result = xfInInt (xf, getLLInt (*cres, xf->type));
+      iot_data_free (*cres);
+      *cres = setLLInt (result, xf->type);
+    }
+    break;
+    case IOT_DATA_ARRAY:
+    if (xf->active && transformApplies (xf, iot_data_array_type (*cres)))
+    {
+      iot_data_t *result = transformArray (*cres, xf, false);
       iot_data_free (*cres);
-      *cres = setLLInt (result, props->type.type);
+      *cres = result;
     }
     break;
     case IOT_DATA_STRING:
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2019-2023
+ * Copyright (c) 2019-2025
  * IoTech Ltd
  *
  * SPDX-License-Identifier: Apache-2.0
@@ -12,9 +12,31 @@
 #include "devsdk/devsdk.h"
 #include "edgex/edgex.h"
 
-void edgex_transform_outgoing (devsdk_commandresult *cres, edgex_propertyvalue *props, const iot_data_t *mappings);
+/* A resource's transforms, compiled once from its properties. Disabled
+   steps are held as identity values. For array resources the plan applies
+   to each element. */
 
-void edgex_transform_incoming (iot_data_t **cres, edgex_propertyvalue *props, const iot_data_t *mappings);
+typedef struct edgex_transform
+{
+  iot_data_type_t type;
+  bool isarray;
+  bool isfloat;
+  bool active;
+  edgex_transformArg base;
+  double fscale;
+  double foffset;
+  int64_t iscale;
+  int64_t ioffset;
+  int64_t mask;
+  unsigned lshift;
+  unsigned rshift;
+} edgex_transform;
+
+void edgex_transform_compile (edgex_transform *xf, const edgex_propertyvalue *props);
+
+void edgex_transform_outgoing (devsdk_commandresult *cres, const edgex_transform *xf, const iot_data_t *mappings);
+
+void edgex_transform_incoming (iot_data_t **cres, const edgex_transform *xf, const iot_data_t *mappings);
 
 bool edgex_transform_validate (const iot_data_t *val, const edgex_propertyvalue *props);
 